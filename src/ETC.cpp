@@ -0,0 +1,518 @@
+#include "ETC.h"
+#include "Parallel.h"
+
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------------
+// Tables from the OES_compressed_ETC1_RGB8_texture and ETC2 (GLES 3.0 annex C) specs
+// ------------------------------------------------------------------------------------------------
+
+// Selector 0..3 maps to +small, +large, -small, -large
+static const int s_etcModifiers[8][2] =
+{
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+static const int s_eacModifiers[16][8] =
+{
+	{ -3, -6,  -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5,  -8, -13, 1, 4, 7, 12 },
+	{ -2, -4,  -6, -13, 1, 3, 5, 12 },
+	{ -3, -6,  -8, -12, 2, 5, 7, 11 },
+	{ -3, -7,  -9, -11, 2, 6, 8, 10 },
+	{ -4, -7,  -8, -11, 3, 6, 7, 10 },
+	{ -3, -5,  -8, -11, 2, 4, 7, 10 },
+	{ -2, -6,  -8, -10, 1, 5, 7,  9 },
+	{ -2, -5,  -8, -10, 1, 4, 7,  9 },
+	{ -2, -4,  -8, -10, 1, 3, 7,  9 },
+	{ -2, -5,  -7, -10, 1, 4, 6,  9 },
+	{ -3, -4,  -7, -10, 2, 3, 6,  9 },
+	{ -1, -2,  -3, -10, 0, 1, 2,  9 },
+	{ -4, -6,  -8,  -9, 3, 5, 7,  8 },
+	{ -3, -5,  -7,  -9, 2, 4, 6,  8 },
+};
+
+// Pixels are numbered down the columns (i = x * 4 + y), as in the selector bits
+static const int s_subblockPixels[2][2][8] =
+{
+	{ { 0, 1, 2, 3, 4, 5, 6, 7 }, { 8, 9, 10, 11, 12, 13, 14, 15 } },		// flip 0: two 2x4 halves side by side
+	{ { 0, 1, 4, 5, 8, 9, 12, 13 }, { 2, 3, 6, 7, 10, 11, 14, 15 } },		// flip 1: two 4x2 halves stacked
+};
+
+const float ETC_PSNR_EXACT = 100.0f;
+
+static inline int Clamp255(int v)		{ return v < 0 ? 0 : (v > 255 ? 255 : v); }
+static inline int Expand4(int c)		{ return (c << 4) | c; }
+static inline int Expand5(int c)		{ return (c << 3) | (c >> 2); }
+static inline int EtcModifier(int table, int selector)
+{
+	int m = s_etcModifiers[table][selector & 1];
+	return selector & 2 ? -m : m;
+}
+
+struct ETCBlock
+{
+	int		rgb[16][3];
+	int		alpha[16];
+};
+
+// ------------------------------------------------------------------------------------------------
+// ETC1 color blocks
+// ------------------------------------------------------------------------------------------------
+
+struct SubblockFit
+{
+	int				color[3];		// quantized to 4 (individual) or 5 (differential) bits
+	int				table;
+	int				error;
+	unsigned char	selectors[8];
+};
+
+// Picks the table and selectors with the lowest squared error for one quantized base color
+static void FitSubblock(const ETCBlock& block, const int* pPixels, const int* color, int bits, SubblockFit* pFit)
+{
+	int base[3];
+	for (int c = 0; c < 3; c++)
+		base[c] = bits == 4 ? Expand4(color[c]) : Expand5(color[c]);
+
+	pFit->error = INT_MAX;
+	for (int t = 0; t < 8; t++)
+	{
+		int error = 0;
+		unsigned char selectors[8];
+		for (int k = 0; k < 8 && error < pFit->error; k++)
+		{
+			const int* p = block.rgb[pPixels[k]];
+			int bestError = INT_MAX;
+			for (int s = 0; s < 4; s++)
+			{
+				int m = EtcModifier(t, s);
+				int dr = Clamp255(base[0] + m) - p[0];
+				int dg = Clamp255(base[1] + m) - p[1];
+				int db = Clamp255(base[2] + m) - p[2];
+				int e = dr * dr + dg * dg + db * db;
+				if (e < bestError)
+				{
+					bestError = e;
+					selectors[k] = (unsigned char)s;
+				}
+			}
+			error += bestError;
+		}
+		if (error < pFit->error)
+		{
+			pFit->error = error;
+			pFit->table = t;
+			memcpy(pFit->selectors, selectors, sizeof(selectors));
+		}
+	}
+	for (int c = 0; c < 3; c++)
+		pFit->color[c] = color[c];
+}
+
+// Base colors worth trying for a subblock: its quantized average, plus the neighbours in high quality
+static int GetCandidateColors(const ETCBlock& block, const int* pPixels, int bits, ETCQuality quality, int (*pColors)[3])
+{
+	int maxValue = (1 << bits) - 1;
+	int average[3];
+	for (int c = 0; c < 3; c++)
+	{
+		int sum = 0;
+		for (int k = 0; k < 8; k++)
+			sum += block.rgb[pPixels[k]][c];
+		average[c] = (sum * maxValue + 255 * 4) / (255 * 8);
+	}
+
+	if (quality == ETC_QUALITY_FAST)
+	{
+		memcpy(pColors[0], average, sizeof(average));
+		return 1;
+	}
+
+	int count = 0;
+	for (int dr = -1; dr <= 1; dr++)
+		for (int dg = -1; dg <= 1; dg++)
+			for (int db = -1; db <= 1; db++)
+			{
+				int r = average[0] + dr, g = average[1] + dg, b = average[2] + db;
+				if (r < 0 || g < 0 || b < 0 || r > maxValue || g > maxValue || b > maxValue)
+					continue;
+				pColors[count][0] = r;
+				pColors[count][1] = g;
+				pColors[count][2] = b;
+				count++;
+			}
+	return count;
+}
+
+static void PackETC1Block(unsigned char* pOut, bool diff, int flip, const SubblockFit& s0, const SubblockFit& s1)
+{
+	for (int c = 0; c < 3; c++)
+	{
+		if (diff)
+			pOut[c] = (unsigned char)((s0.color[c] << 3) | ((s1.color[c] - s0.color[c]) & 7));
+		else
+			pOut[c] = (unsigned char)((s0.color[c] << 4) | s1.color[c]);
+	}
+	pOut[3] = (unsigned char)((s0.table << 5) | (s1.table << 2) | (diff ? 2 : 0) | flip);
+
+	unsigned int msb = 0, lsb = 0;
+	for (int k = 0; k < 8; k++)
+	{
+		int i0 = s_subblockPixels[flip][0][k];
+		int i1 = s_subblockPixels[flip][1][k];
+		msb |= (unsigned int)(s0.selectors[k] >> 1) << i0 | (unsigned int)(s1.selectors[k] >> 1) << i1;
+		lsb |= (unsigned int)(s0.selectors[k] & 1) << i0 | (unsigned int)(s1.selectors[k] & 1) << i1;
+	}
+	pOut[4] = (unsigned char)(msb >> 8);
+	pOut[5] = (unsigned char)msb;
+	pOut[6] = (unsigned char)(lsb >> 8);
+	pOut[7] = (unsigned char)lsb;
+}
+
+static void CompressETC1Block(const ETCBlock& block, ETCQuality quality, unsigned char* pOut)
+{
+	const int MAX_CANDIDATES = 28;
+	int bestError = INT_MAX;
+
+	for (int flip = 0; flip < 2; flip++)
+	{
+		const int* pSub0 = s_subblockPixels[flip][0];
+		const int* pSub1 = s_subblockPixels[flip][1];
+		int colors[MAX_CANDIDATES][3];
+
+		// Individual mode: 4-bit colors, the halves are independent
+		SubblockFit best[2];
+		for (int sub = 0; sub < 2; sub++)
+		{
+			const int* pPixels = s_subblockPixels[flip][sub];
+			int count = GetCandidateColors(block, pPixels, 4, quality, colors);
+			best[sub].error = INT_MAX;
+			for (int i = 0; i < count; i++)
+			{
+				SubblockFit fit;
+				FitSubblock(block, pPixels, colors[i], 4, &fit);
+				if (fit.error < best[sub].error)
+					best[sub] = fit;
+			}
+		}
+		if (best[0].error + best[1].error < bestError)
+		{
+			bestError = best[0].error + best[1].error;
+			PackETC1Block(pOut, false, flip, best[0], best[1]);
+		}
+
+		// Differential mode: 5-bit colors, the second within [-4, 3] of the first
+		SubblockFit fits0[MAX_CANDIDATES], fits1[MAX_CANDIDATES];
+		int count0 = GetCandidateColors(block, pSub0, 5, quality, colors);
+		for (int i = 0; i < count0; i++)
+			FitSubblock(block, pSub0, colors[i], 5, &fits0[i]);
+
+		int count1 = GetCandidateColors(block, pSub1, 5, quality, colors);
+		// When the averages are too far apart, also try the second average pulled into range of the first
+		int average0[1][3], clamped[1][3];
+		GetCandidateColors(block, pSub0, 5, ETC_QUALITY_FAST, average0);
+		GetCandidateColors(block, pSub1, 5, ETC_QUALITY_FAST, clamped);
+		for (int c = 0; c < 3; c++)
+		{
+			int lo = average0[0][c] - 4 < 0 ? 0 : average0[0][c] - 4;
+			int hi = average0[0][c] + 3 > 31 ? 31 : average0[0][c] + 3;
+			clamped[0][c] = clamped[0][c] < lo ? lo : (clamped[0][c] > hi ? hi : clamped[0][c]);
+		}
+		memcpy(colors[count1++], clamped[0], sizeof(clamped[0]));
+		for (int i = 0; i < count1; i++)
+			FitSubblock(block, pSub1, colors[i], 5, &fits1[i]);
+
+		for (int i = 0; i < count0; i++)
+		{
+			for (int j = 0; j < count1; j++)
+			{
+				if (fits0[i].error + fits1[j].error >= bestError)
+					continue;
+				bool inRange = true;
+				for (int c = 0; c < 3 && inRange; c++)
+				{
+					int d = fits1[j].color[c] - fits0[i].color[c];
+					inRange = d >= -4 && d <= 3;
+				}
+				if (!inRange)
+					continue;
+				bestError = fits0[i].error + fits1[j].error;
+				PackETC1Block(pOut, true, flip, fits0[i], fits1[j]);
+			}
+		}
+	}
+}
+
+static void DecodeETC1Block(const unsigned char* pIn, int (*pRGB)[3])
+{
+	bool diff = (pIn[3] & 2) != 0;
+	int flip = pIn[3] & 1;
+	int base[2][3];
+	for (int c = 0; c < 3; c++)
+	{
+		if (diff)
+		{
+			int c0 = pIn[c] >> 3;
+			int d = pIn[c] & 7;
+			if (d >= 4)
+				d -= 8;
+			base[0][c] = Expand5(c0);
+			base[1][c] = Expand5(c0 + d);
+		}
+		else
+		{
+			base[0][c] = Expand4(pIn[c] >> 4);
+			base[1][c] = Expand4(pIn[c] & 15);
+		}
+	}
+	int tables[2] = { pIn[3] >> 5, (pIn[3] >> 2) & 7 };
+	unsigned int msb = (pIn[4] << 8) | pIn[5];
+	unsigned int lsb = (pIn[6] << 8) | pIn[7];
+
+	for (int i = 0; i < 16; i++)
+	{
+		int x = i / 4, y = i % 4;
+		int sub = flip ? (y >= 2) : (x >= 2);
+		int s = (((msb >> i) & 1) << 1) | ((lsb >> i) & 1);
+		int m = EtcModifier(tables[sub], s);
+		for (int c = 0; c < 3; c++)
+			pRGB[i][c] = Clamp255(base[sub][c] + m);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// EAC alpha blocks
+// ------------------------------------------------------------------------------------------------
+
+static int FitEAC(const int* alpha, int base, int multiplier, int table, unsigned char* pSelectors, int bestError)
+{
+	const int* mods = s_eacModifiers[table];
+	int error = 0;
+	for (int i = 0; i < 16 && error < bestError; i++)
+	{
+		int best = INT_MAX;
+		for (int s = 0; s < 8; s++)
+		{
+			int d = Clamp255(base + mods[s] * multiplier) - alpha[i];
+			if (d * d < best)
+			{
+				best = d * d;
+				pSelectors[i] = (unsigned char)s;
+			}
+		}
+		error += best;
+	}
+	return error;
+}
+
+static void CompressEACBlock(const int* alpha, ETCQuality quality, unsigned char* pOut)
+{
+	int minA = 255, maxA = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		minA = alpha[i] < minA ? alpha[i] : minA;
+		maxA = alpha[i] > maxA ? alpha[i] : maxA;
+	}
+
+	int multRadius = quality == ETC_QUALITY_HIGH ? 2 : 0;
+	int baseRadius = quality == ETC_QUALITY_HIGH ? 4 : 0;
+	int bestError = INT_MAX, bestBase = minA, bestMult = 1, bestTable = 13;
+	unsigned char bestSelectors[16], selectors[16];
+	memset(bestSelectors, 4, sizeof(bestSelectors));
+
+	for (int t = 0; t < 16 && bestError > 0; t++)
+	{
+		const int* mods = s_eacModifiers[t];
+		int span = mods[7] - mods[3];
+		int mult0 = ((maxA - minA) + span / 2) / span;
+		for (int mult = mult0 - multRadius; mult <= mult0 + multRadius + 1; mult++)
+		{
+			if (mult < 1 || mult > 15)
+				continue;
+			// Line the most negative modifier up with the darkest pixel
+			int base0 = Clamp255(minA - mods[3] * mult);
+			for (int base = base0 - baseRadius; base <= base0 + baseRadius; base++)
+			{
+				if (base < 0 || base > 255)
+					continue;
+				int error = FitEAC(alpha, base, mult, t, selectors, bestError);
+				if (error < bestError)
+				{
+					bestError = error;
+					bestBase = base;
+					bestMult = mult;
+					bestTable = t;
+					memcpy(bestSelectors, selectors, sizeof(selectors));
+				}
+			}
+		}
+	}
+
+	pOut[0] = (unsigned char)bestBase;
+	pOut[1] = (unsigned char)((bestMult << 4) | bestTable);
+	unsigned long long bits = 0;
+	for (int i = 0; i < 16; i++)
+		bits |= (unsigned long long)bestSelectors[i] << (45 - 3 * i);
+	for (int i = 0; i < 6; i++)
+		pOut[2 + i] = (unsigned char)(bits >> (40 - 8 * i));
+}
+
+static void DecodeEACBlock(const unsigned char* pIn, int* pAlpha)
+{
+	int base = pIn[0];
+	int mult = pIn[1] >> 4;
+	const int* mods = s_eacModifiers[pIn[1] & 15];
+	unsigned long long bits = 0;
+	for (int i = 0; i < 6; i++)
+		bits = (bits << 8) | pIn[2 + i];
+	for (int i = 0; i < 16; i++)
+		pAlpha[i] = Clamp255(base + mods[(bits >> (45 - 3 * i)) & 7] * mult);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Images, split into block rows for ParallelFor
+// ------------------------------------------------------------------------------------------------
+
+struct ETCPass
+{
+	const unsigned char*	pSrc;
+	unsigned char*			pDst;
+	int						width, height;
+	int						pixelSize;
+	int						blocksX;
+	int						blockSize;
+	bool					hasAlpha;		// EAC block in front of each color block
+	ETCQuality				quality;
+	double*					pRowErrors;		// squared error per block row
+};
+
+static void CompressBlockRows(void* pUserData, int rowBegin, int rowEnd)
+{
+	const ETCPass* pPass = (const ETCPass*)pUserData;
+	ETCBlock block;
+	int decodedRGB[16][3];
+	int decodedAlpha[16];
+
+	for (int by = rowBegin; by < rowEnd; by++)
+	{
+		double rowError = 0.0;
+		for (int bx = 0; bx < pPass->blocksX; bx++)
+		{
+			// Gather the block, repeating the edge pixels of partial blocks
+			for (int i = 0; i < 16; i++)
+			{
+				int x = bx * 4 + i / 4, y = by * 4 + i % 4;
+				x = x < pPass->width ? x : pPass->width - 1;
+				y = y < pPass->height ? y : pPass->height - 1;
+				const unsigned char* p = pPass->pSrc + ((size_t)y * pPass->width + x) * pPass->pixelSize;
+				block.rgb[i][0] = p[0];
+				block.rgb[i][1] = p[1];
+				block.rgb[i][2] = p[2];
+				block.alpha[i] = pPass->pixelSize == 4 ? p[3] : 255;
+			}
+
+			unsigned char* pOut = pPass->pDst + ((size_t)by * pPass->blocksX + bx) * pPass->blockSize;
+			if (pPass->hasAlpha)
+			{
+				CompressEACBlock(block.alpha, pPass->quality, pOut);
+				DecodeEACBlock(pOut, decodedAlpha);
+				pOut += 8;
+			}
+			CompressETC1Block(block, pPass->quality, pOut);
+			DecodeETC1Block(pOut, decodedRGB);
+
+			for (int i = 0; i < 16; i++)
+			{
+				if (bx * 4 + i / 4 >= pPass->width || by * 4 + i % 4 >= pPass->height)
+					continue;
+				for (int c = 0; c < 3; c++)
+				{
+					int d = decodedRGB[i][c] - block.rgb[i][c];
+					rowError += d * d;
+				}
+				if (pPass->hasAlpha)
+				{
+					int d = decodedAlpha[i] - block.alpha[i];
+					rowError += d * d;
+				}
+			}
+		}
+		pPass->pRowErrors[by] = rowError;
+	}
+}
+
+void GetDefaultETCOptions(ETCOptions* options)
+{
+	options->format = ETC_FORMAT_ETC1;
+	options->quality = ETC_QUALITY_HIGH;
+	options->numThreads = 0;
+}
+
+size_t GetETCDataSize(ETCFormat format, int width, int height)
+{
+	size_t blocks = (size_t)((width + 3) / 4) * ((height + 3) / 4);
+	return blocks * (format == ETC_FORMAT_ETC2_RGBA ? 16 : 8);
+}
+
+bool CompressETC(const char* pixels, int width, int height, int bpp, const ETCOptions* options, ETCImage* image)
+{
+	memset(image, 0, sizeof(ETCImage));
+	if (pixels == NULL || width <= 0 || height <= 0 || (bpp != 24 && bpp != 32))
+		return false;
+
+	ETCOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultETCOptions(&defaults);
+		options = &defaults;
+	}
+
+	static const GLenum glFormats[] = { GL_ETC1_RGB8_OES, GL_COMPRESSED_RGB8_ETC2, GL_COMPRESSED_RGBA8_ETC2_EAC };
+
+	image->width = width;
+	image->height = height;
+	image->glFormat = glFormats[options->format];
+	image->size = GetETCDataSize(options->format, width, height);
+	image->data = new char[image->size];
+
+	int blocksY = (height + 3) / 4;
+	std::vector<double> rowErrors(blocksY);
+
+	ETCPass pass;
+	pass.pSrc = (const unsigned char*)pixels;
+	pass.pDst = (unsigned char*)image->data;
+	pass.width = width;
+	pass.height = height;
+	pass.pixelSize = bpp / 8;
+	pass.blocksX = (width + 3) / 4;
+	pass.blockSize = options->format == ETC_FORMAT_ETC2_RGBA ? 16 : 8;
+	pass.hasAlpha = options->format == ETC_FORMAT_ETC2_RGBA;
+	pass.quality = options->quality;
+	pass.pRowErrors = &rowErrors[0];
+
+	ParallelFor(blocksY, options->numThreads, CompressBlockRows, &pass);
+
+	double error = 0.0;
+	for (int i = 0; i < blocksY; i++)
+		error += rowErrors[i];
+	double mse = error / ((double)width * height * (pass.hasAlpha ? 4 : 3));
+	image->psnr = mse > 0.0 ? (float)(10.0 * log10(255.0 * 255.0 / mse)) : ETC_PSNR_EXACT;
+
+	return true;
+}
+
+void FreeETCImage(ETCImage* image)
+{
+	delete[] image->data;
+	memset(image, 0, sizeof(ETCImage));
+}
+
+void UploadETCImage(const ETCImage* image, int level)
+{
+	glCompressedTexImage2D(GL_TEXTURE_2D, level, image->glFormat, image->width, image->height, 0, (GLsizei)image->size, image->data);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include <stddef.h>
+
+#ifndef GL_ETC1_RGB8_OES
+#define GL_ETC1_RGB8_OES					0x8D64
+#endif
+#ifndef GL_COMPRESSED_RGB8_ETC2
+#define GL_COMPRESSED_RGB8_ETC2				0x9274
+#endif
+#ifndef GL_COMPRESSED_RGBA8_ETC2_EAC
+#define GL_COMPRESSED_RGBA8_ETC2_EAC		0x9278
+#endif
+
+enum ETCFormat
+{
+	ETC_FORMAT_ETC1,			// OES_compressed_ETC1_RGB8_texture, 4bpp, alpha is dropped
+	ETC_FORMAT_ETC2_RGB,		// GLES3 ETC2 RGB8, 4bpp (every ETC1 block is a valid ETC2 block)
+	ETC_FORMAT_ETC2_RGBA,		// GLES3 ETC2 RGB8 + EAC alpha, 8bpp
+};
+
+enum ETCQuality
+{
+	ETC_QUALITY_FAST,			// subblock averages only
+	ETC_QUALITY_HIGH,			// also searches the base colors around the averages
+};
+
+struct ETCOptions
+{
+	ETCFormat	format;
+	ETCQuality	quality;
+	int			numThreads;		// block rows are split over this many threads, 0 = one per hardware thread
+};
+
+struct ETCImage
+{
+	int			width;
+	int			height;
+	GLenum		glFormat;		// internalformat for glCompressedTexImage2D
+	char*		data;			// 4x4 blocks, left to right, top to bottom
+	size_t		size;
+	float		psnr;			// dB against the source over the channels kept, 100 for an exact match
+};
+
+void GetDefaultETCOptions(ETCOptions* options);
+
+// Bytes of compressed data for a width x height image; partial blocks at the edges are padded
+size_t GetETCDataSize(ETCFormat format, int width, int height);
+
+// Compresses an RGB/RGBA image as returned by LoadTGA (tightly packed rows). options may be NULL
+// for the defaults (ETC1, high quality, all cores). The PSNR is measured by decoding the result.
+bool CompressETC(const char* pixels, int width, int height, int bpp, const ETCOptions* options, ETCImage* image);
+
+void FreeETCImage(ETCImage* image);
+
+// Uploads to the given level of the texture bound to GL_TEXTURE_2D
+void UploadETCImage(const ETCImage* image, int level);
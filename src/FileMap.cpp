@@ -0,0 +1,140 @@
+#include "FileMap.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(_WIN32)
+
+bool MapFile(const char* szFileName, FileMap* map)
+{
+	memset(map, 0, sizeof(FileMap));
+
+	HANDLE hFile = CreateFileA(szFileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(hFile, &fileSize) || fileSize.QuadPart == 0 || (unsigned long long)fileSize.QuadPart > (size_t)-1)
+	{
+		CloseHandle(hFile);
+		return false;
+	}
+
+	map->size = (size_t)fileSize.QuadPart;
+	map->fileHandle = hFile;
+
+	HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (hMapping != NULL)
+	{
+		map->data = (const char*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+		if (map->data != NULL)
+		{
+			map->mappingHandle = hMapping;
+			return true;
+		}
+		CloseHandle(hMapping);
+	}
+
+	// Mapping is not possible (e.g. some network shares), fall back to a plain read
+	char* buffer = new char[map->size];
+	DWORD bytesRead = 0;
+	if (!ReadFile(hFile, buffer, (DWORD)map->size, &bytesRead, NULL) || bytesRead != map->size)
+	{
+		delete[] buffer;
+		CloseHandle(hFile);
+		memset(map, 0, sizeof(FileMap));
+		return false;
+	}
+
+	map->data = buffer;
+	map->heapCopy = true;
+	return true;
+}
+
+void UnmapFile(FileMap* map)
+{
+	if (map->heapCopy)
+		delete[] map->data;
+	else if (map->data)
+		UnmapViewOfFile(map->data);
+
+	if (map->mappingHandle)
+		CloseHandle((HANDLE)map->mappingHandle);
+	if (map->fileHandle)
+		CloseHandle((HANDLE)map->fileHandle);
+
+	memset(map, 0, sizeof(FileMap));
+}
+
+#else
+
+bool MapFile(const char* szFileName, FileMap* map)
+{
+	memset(map, 0, sizeof(FileMap));
+
+	int fd = open(szFileName, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	map->size = (size_t)st.st_size;
+
+	void* data = mmap(NULL, map->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data != MAP_FAILED)
+	{
+		madvise(data, map->size, MADV_SEQUENTIAL);
+		close(fd);
+		map->data = (const char*)data;
+		return true;
+	}
+
+	// Mapping is not possible, fall back to a plain read
+	char* buffer = new char[map->size];
+	size_t bytesRead = 0;
+	while (bytesRead < map->size)
+	{
+		ssize_t n = read(fd, buffer + bytesRead, map->size - bytesRead);
+		if (n <= 0)
+			break;
+		bytesRead += (size_t)n;
+	}
+	close(fd);
+
+	if (bytesRead != map->size)
+	{
+		delete[] buffer;
+		memset(map, 0, sizeof(FileMap));
+		return false;
+	}
+
+	map->data = buffer;
+	map->heapCopy = true;
+	return true;
+}
+
+void UnmapFile(FileMap* map)
+{
+	if (map->heapCopy)
+		delete[] map->data;
+	else if (map->data)
+		munmap((void*)map->data, map->size);
+
+	memset(map, 0, sizeof(FileMap));
+}
+
+#endif
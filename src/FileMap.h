@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+// Read-only view of a whole file. The contents are memory-mapped when the OS allows it, otherwise
+// they are read into a heap buffer so callers can treat both cases the same way.
+struct FileMap
+{
+	const char*		data;
+	size_t			size;
+
+	// Platform handles, owned by the map
+	void*			fileHandle;
+	void*			mappingHandle;
+	bool			heapCopy;
+};
+
+// Maps szFileName for reading. Returns false (and leaves map zeroed) on failure or for empty files.
+bool MapFile(const char* szFileName, FileMap* map);
+
+void UnmapFile(FileMap* map);
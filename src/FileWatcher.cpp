@@ -0,0 +1,150 @@
+#include "FileWatcher.h"
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <string>
+#endif
+
+#if defined(_WIN32)
+
+bool StartFileWatcher(const char* szDirectory, FileWatcher* watcher)
+{
+	memset(watcher, 0, sizeof(FileWatcher));
+
+	HANDLE hChange = FindFirstChangeNotificationA(szDirectory, TRUE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME);
+	if (hChange == INVALID_HANDLE_VALUE)
+		return false;
+
+	watcher->handle = hChange;
+	return true;
+}
+
+void StopFileWatcher(FileWatcher* watcher)
+{
+	if (watcher->handle)
+		FindCloseChangeNotification((HANDLE)watcher->handle);
+
+	memset(watcher, 0, sizeof(FileWatcher));
+}
+
+bool PollFileWatcher(FileWatcher* watcher)
+{
+	if (watcher->handle == NULL)
+		return false;
+
+	bool changed = false;
+	while (WaitForSingleObject((HANDLE)watcher->handle, 0) == WAIT_OBJECT_0)
+	{
+		changed = true;
+		if (!FindNextChangeNotification((HANDLE)watcher->handle))
+			break;
+	}
+	return changed;
+}
+
+unsigned long long GetFileModifyTime(const char* szFileName)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(szFileName, GetFileExInfoStandard, &data))
+		return 0;
+
+	return ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+
+#else
+
+const unsigned int WATCH_EVENTS = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_TO | IN_MOVED_FROM;
+
+// inotify is not recursive, every directory of the tree needs its own watch
+static void AddWatches(int fd, const std::string& directory)
+{
+	if (inotify_add_watch(fd, directory.c_str(), WATCH_EVENTS) < 0)
+		return;
+
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL)
+		return;
+
+	while (struct dirent* entry = readdir(dir))
+	{
+		if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			continue;
+
+		std::string path = directory + "/" + entry->d_name;
+		struct stat st;
+		if (stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode))
+			AddWatches(fd, path);
+	}
+	closedir(dir);
+}
+
+bool StartFileWatcher(const char* szDirectory, FileWatcher* watcher)
+{
+	memset(watcher, 0, sizeof(FileWatcher));
+
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (stat(szDirectory, &st) != 0 || !S_ISDIR(st.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+
+	AddWatches(fd, szDirectory);
+	watcher->fd = fd + 1;	// 0 stays "not watching" for zeroed watchers
+	return true;
+}
+
+void StopFileWatcher(FileWatcher* watcher)
+{
+	if (watcher->fd)
+		close(watcher->fd - 1);
+
+	memset(watcher, 0, sizeof(FileWatcher));
+}
+
+bool PollFileWatcher(FileWatcher* watcher)
+{
+	if (watcher->fd == 0)
+		return false;
+
+	// Only the fact that something happened matters, the events themselves are dropped.
+	// Directories created after StartFileWatcher are not watched.
+	char buffer[4096];
+	bool changed = false;
+	for (;;)
+	{
+		ssize_t n = read(watcher->fd - 1, buffer, sizeof(buffer));
+		if (n > 0)
+			changed = true;
+		else if (n < 0 && errno == EINTR)
+			continue;
+		else
+			break;
+	}
+	return changed;
+}
+
+unsigned long long GetFileModifyTime(const char* szFileName)
+{
+	struct stat st;
+	if (stat(szFileName, &st) != 0)
+		return 0;
+
+	return (unsigned long long)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+}
+
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+// Change notification for a directory tree: inotify on Linux, a change notification handle on
+// Windows. It only tells that something below the directory was written, created, renamed or
+// deleted; callers compare GetFileModifyTime of the files they care about to see what changed.
+struct FileWatcher
+{
+	// Platform handle, owned by the watcher
+	void*			handle;
+	int				fd;
+};
+
+// Starts watching szDirectory and its subdirectories. Returns false (and leaves watcher zeroed)
+// when the directory cannot be watched.
+bool StartFileWatcher(const char* szDirectory, FileWatcher* watcher);
+
+void StopFileWatcher(FileWatcher* watcher);
+
+// True if anything changed since the last call. Never blocks.
+bool PollFileWatcher(FileWatcher* watcher);
+
+// Last write time of the file in the platform's native units, 0 if it does not exist
+unsigned long long GetFileModifyTime(const char* szFileName);
@@ -0,0 +1,377 @@
+#include "JobSystem.h"
+#include "WorkStealingDeque.h"
+
+#include <algorithm>
+#include <new>
+#include <stdlib.h>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+// Jobs a thread can have queued at once, more run right where they are started
+const int JOB_QUEUE_SIZE = 4096;
+
+// Times an idle worker looks for work again before it goes to sleep
+const int JOB_IDLE_SPINS = 64;
+
+// Ranges ParallelFor makes per thread when it picks the grain size, so that stealing can even out
+// ranges that take longer than others
+const int JOB_RANGES_PER_THREAD = 4;
+
+// Enough for the alignas(64) members of WorkStealingDeque and LockFreeQueue
+const size_t JOB_CACHE_LINE = 64;
+
+static void* AllocCacheAligned(size_t size)
+{
+#if defined(_WIN32)
+	void* p = _aligned_malloc(size, JOB_CACHE_LINE);
+#else
+	void* p = NULL;
+	if (posix_memalign(&p, JOB_CACHE_LINE, size) != 0)
+		p = NULL;
+#endif
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+static void FreeCacheAligned(void* p)
+{
+#if defined(_WIN32)
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+// A job queued on a worker's deque. Only the owning worker hands slots out; whoever takes the job
+// frees the slot again.
+struct JobSlot
+{
+	Job					job;
+	std::atomic<bool>	busy;
+};
+
+struct JobWorker
+{
+	WorkStealingDeque<JobSlot*, JOB_QUEUE_SIZE>	deque;
+	JobSlot										slots[JOB_QUEUE_SIZE];
+	unsigned int								nextSlot;
+	std::thread									thread;		// not joinable for worker 0
+
+	JobWorker() : nextSlot(0)
+	{
+		for (int i = 0; i < JOB_QUEUE_SIZE; i++)
+			slots[i].busy.store(false, std::memory_order_relaxed);
+	}
+
+	static void* operator new(size_t size) { return AllocCacheAligned(size); }
+	static void operator delete(void* p) { FreeCacheAligned(p); }
+};
+
+// Which worker of which job system the current thread is
+static thread_local const JobSystem* s_jobSystem = NULL;
+static thread_local int s_jobWorker = -1;
+
+JobSystem::JobSystem()
+	: queuedJobs(0)
+	, numSleeping(0)
+	, stopping(false)
+{
+}
+
+JobSystem::~JobSystem()
+{
+	Shutdown();
+}
+
+void* JobSystem::operator new(size_t size)
+{
+	return AllocCacheAligned(size);
+}
+
+void JobSystem::operator delete(void* p)
+{
+	FreeCacheAligned(p);
+}
+
+void JobSystem::Init(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = GetHardwareThreadCount();
+
+	stopping = false;
+	workers.push_back(new JobWorker);
+	s_jobSystem = this;
+	s_jobWorker = 0;
+
+	for (int i = 1; i < numThreads; i++)
+		workers.push_back(new JobWorker);
+	for (int i = 1; i < numThreads; i++)
+		workers[i]->thread = std::thread(&JobSystem::WorkerMain, this, i);
+}
+
+void JobSystem::Shutdown()
+{
+	if (workers.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	sleepCond.notify_all();
+
+	for (size_t i = 1; i < workers.size(); i++)
+		workers[i]->thread.join();
+
+	// Jobs may still queue more jobs, so take from everyone until nothing is left
+	Job job;
+	while (TakeJob(0, job))
+		Execute(job);
+
+	for (size_t i = 0; i < workers.size(); i++)
+		delete workers[i];
+	workers.clear();
+
+	if (s_jobSystem == this)
+	{
+		s_jobSystem = NULL;
+		s_jobWorker = -1;
+	}
+}
+
+int JobSystem::CurrentWorker() const
+{
+	return s_jobSystem == this ? s_jobWorker : -1;
+}
+
+void JobSystem::Run(JobFunc func, void* userData, JobCounter* counter)
+{
+	Job job;
+	job.func = func;
+	job.userData = userData;
+	job.counter = counter;
+
+	if (counter)
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+	Push(job);
+}
+
+void JobSystem::RunAfter(JobCounter* dependency, JobFunc func, void* userData, JobCounter* counter)
+{
+	Job job;
+	job.func = func;
+	job.userData = userData;
+	job.counter = counter;
+
+	if (counter)
+		counter->count.fetch_add(1, std::memory_order_relaxed);
+
+	{
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (dependency->count.load(std::memory_order_acquire) > 0)
+		{
+			dependency->waiting.push_back(job);
+			return;
+		}
+	}
+	Push(job);
+}
+
+void JobSystem::Push(const Job& job)
+{
+	// Without other threads there is nobody to hand the job to
+	if (workers.size() <= 1)
+	{
+		Execute(job);
+		return;
+	}
+
+	// Counted first, so that a worker never sees the job without the count
+	queuedJobs.fetch_add(1);
+
+	bool queued = false;
+	int worker = CurrentWorker();
+	if (worker >= 0)
+	{
+		JobWorker* self = workers[worker];
+		JobSlot* slot = &self->slots[self->nextSlot & (JOB_QUEUE_SIZE - 1)];
+		if (!slot->busy.load(std::memory_order_acquire))
+		{
+			self->nextSlot++;
+			slot->job = job;
+			slot->busy.store(true, std::memory_order_relaxed);
+			queued = self->deque.Push(slot);
+			if (!queued)
+				slot->busy.store(false, std::memory_order_relaxed);
+		}
+	}
+	else
+		queued = injected.Push(job);
+
+	if (!queued)
+	{
+		queuedJobs.fetch_sub(1);
+		Execute(job);
+		return;
+	}
+
+	if (numSleeping.load() > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		sleepCond.notify_one();
+	}
+}
+
+// Own jobs first, then the shared queue, then the other workers' oldest jobs
+bool JobSystem::TakeJob(int worker, Job& job)
+{
+	JobSlot* slot;
+	if (worker >= 0 && workers[worker]->deque.Pop(slot))
+	{
+		job = slot->job;
+		slot->busy.store(false, std::memory_order_release);
+		queuedJobs.fetch_sub(1);
+		return true;
+	}
+
+	if (injected.Pop(job))
+	{
+		queuedJobs.fetch_sub(1);
+		return true;
+	}
+
+	// Starting right after ourselves spreads the thieves over the victims
+	int numWorkers = (int)workers.size();
+	for (int i = 1; i <= numWorkers; i++)
+	{
+		int victim = (worker + i) % numWorkers;
+		if (victim == worker)
+			continue;
+		if (workers[victim]->deque.Steal(slot))
+		{
+			job = slot->job;
+			slot->busy.store(false, std::memory_order_release);
+			queuedJobs.fetch_sub(1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::Execute(const Job& job)
+{
+	job.func(job.userData);
+	if (job.counter)
+		Finish(job.counter);
+}
+
+void JobSystem::Finish(JobCounter* counter)
+{
+	// The step down to zero and taking the waiting jobs happen together, so RunAfter never parks
+	// a job on a counter that is already done
+	std::vector<Job> released;
+	{
+		std::lock_guard<std::mutex> lock(counter->mutex);
+		if (counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			released.swap(counter->waiting);
+	}
+
+	for (size_t i = 0; i < released.size(); i++)
+		Push(released[i]);
+}
+
+void JobSystem::Wait(JobCounter* counter)
+{
+	int worker = CurrentWorker();
+	Job job;
+	while (counter->count.load(std::memory_order_acquire) > 0)
+	{
+		if (TakeJob(worker, job))
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+
+	// The last job may still hold the lock, let it finish with the counter before it goes away
+	std::lock_guard<std::mutex> lock(counter->mutex);
+}
+
+void JobSystem::WorkerMain(int worker)
+{
+	s_jobSystem = this;
+	s_jobWorker = worker;
+
+	Job job;
+	int idleSpins = 0;
+	while (!stopping.load(std::memory_order_acquire))
+	{
+		if (TakeJob(worker, job))
+		{
+			Execute(job);
+			idleSpins = 0;
+			continue;
+		}
+
+		if (++idleSpins < JOB_IDLE_SPINS)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// Push checks numSleeping after counting its job, and this checks the count after
+		// numSleeping went up, so one of the two always sees the other
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		numSleeping.fetch_add(1);
+		while (queuedJobs.load() <= 0 && !stopping)
+			sleepCond.wait(lock);
+		numSleeping.fetch_sub(1);
+		idleSpins = 0;
+	}
+}
+
+struct ParallelRange
+{
+	ParallelRangeFunc	func;
+	void*				userData;
+	int					begin;
+	int					end;
+};
+
+static void RunParallelRange(void* userData)
+{
+	ParallelRange* range = (ParallelRange*)userData;
+	range->func(range->userData, range->begin, range->end);
+}
+
+void JobSystem::ParallelFor(int count, int grainSize, ParallelRangeFunc func, void* userData)
+{
+	if (count <= 0)
+		return;
+
+	if (grainSize <= 0)
+		grainSize = std::max(count / (std::max(GetThreadCount(), 1) * JOB_RANGES_PER_THREAD), 1);
+
+	int numRanges = (int)(((long long)count + grainSize - 1) / grainSize);
+	if (numRanges <= 1)
+	{
+		func(userData, 0, count);
+		return;
+	}
+
+	std::vector<ParallelRange> ranges(numRanges);
+	JobCounter counter;
+	for (int i = 1; i < numRanges; i++)
+	{
+		ranges[i].func = func;
+		ranges[i].userData = userData;
+		ranges[i].begin = (int)((long long)grainSize * i);
+		ranges[i].end = (int)std::min((long long)grainSize * (i + 1), (long long)count);
+		Run(RunParallelRange, &ranges[i], &counter);
+	}
+
+	func(userData, 0, grainSize);
+	Wait(&counter);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "LockFreeQueue.h"
+#include "Parallel.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*JobFunc)(void* userData);
+
+class JobCounter;
+
+struct Job
+{
+	JobFunc		func;
+	void*		userData;
+	JobCounter*	counter;
+};
+
+// Counts the unfinished jobs started with it. Waiting on a counter, or starting jobs after it,
+// covers every job started with it so far. It must outlive those jobs and may be reused once done.
+class JobCounter
+{
+public:
+	JobCounter() : count(0) {}
+
+	bool IsDone() const { return count.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<int>	count;
+	std::mutex			mutex;		// guards waiting and the step down to zero
+	std::vector<Job>	waiting;	// started with JobSystem::RunAfter, queued once count is back at zero
+};
+
+struct JobWorker;
+
+// Runs small jobs on a pool of threads. Each thread keeps its own deque of the jobs it started and
+// works through it newest first; a thread that runs dry steals the oldest job of another one. The
+// thread calling Init is part of the pool: it runs jobs whenever it waits, so it should be the
+// thread that starts most of them.
+// Threads outside the pool may start and wait on jobs too, theirs go through a shared queue.
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// The queues keep their ends on separate cache lines, which plain new does not honour before C++17
+	static void* operator new(size_t size);
+	static void operator delete(void* p);
+
+	// numThreads counts the calling thread. <= 0 uses one per hardware thread, 1 runs every job
+	// right where it is started.
+	void Init(int numThreads);
+
+	// Runs whatever is still queued on the calling thread, which must be the one that called Init
+	void Shutdown();
+
+	int GetThreadCount() const { return (int)workers.size(); }
+
+	// Queues func(userData). counter (may be NULL) counts the job until it has finished. A job that
+	// does not fit into the queue any more runs right away instead.
+	void Run(JobFunc func, void* userData, JobCounter* counter);
+
+	// Like Run, but the job is only queued once dependency is done
+	void RunAfter(JobCounter* dependency, JobFunc func, void* userData, JobCounter* counter);
+
+	// Runs queued jobs, stealing them when the calling thread has none, until counter is done
+	void Wait(JobCounter* counter);
+
+	// Splits [0, count) into ranges of grainSize indices (<= 0 picks a few ranges per thread) and
+	// processes them as jobs. The calling thread takes the first range, then helps with the rest;
+	// the call returns once every range is done. May be nested inside jobs.
+	void ParallelFor(int count, int grainSize, ParallelRangeFunc func, void* userData);
+
+private:
+	int CurrentWorker() const;
+	void Push(const Job& job);
+	bool TakeJob(int worker, Job& job);
+	void Execute(const Job& job);
+	void Finish(JobCounter* counter);
+	void WorkerMain(int worker);
+
+	std::vector<JobWorker*>		workers;		// workers[0] is the thread that called Init
+	LockFreeQueue<Job, 1024>	injected;		// jobs from threads outside the pool
+	std::atomic<int>			queuedJobs;
+	std::atomic<int>			numSleeping;
+	std::atomic<bool>			stopping;
+	std::mutex					sleepMutex;
+	std::condition_variable		sleepCond;
+};
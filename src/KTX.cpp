@@ -0,0 +1,310 @@
+#include "KTX.h"
+#include "PVRTC.h"
+#include "TGA.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+struct KTX_HEADER
+{
+	unsigned char	identifier[12];
+	unsigned int	endianness;				// KTX_ENDIAN_REF as written by the producer
+	unsigned int	glType;
+	unsigned int	glTypeSize;
+	unsigned int	glFormat;
+	unsigned int	glInternalFormat;
+	unsigned int	glBaseInternalFormat;
+	unsigned int	pixelWidth;
+	unsigned int	pixelHeight;
+	unsigned int	pixelDepth;
+	unsigned int	numberOfArrayElements;
+	unsigned int	numberOfFaces;
+	unsigned int	numberOfMipmapLevels;	// 0 = generate at load time
+	unsigned int	bytesOfKeyValueData;
+};
+
+static const unsigned char KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+const unsigned int KTX_ENDIAN_REF = 0x04030201;
+
+// Image sizes and every row of uncompressed data are padded to this many bytes
+const int KTX_ALIGNMENT = 4;
+
+static size_t AlignKTX(size_t size)
+{
+	return (size + KTX_ALIGNMENT - 1) / KTX_ALIGNMENT * KTX_ALIGNMENT;
+}
+
+// GLES2 only mipmaps power-of-two textures unless GL_OES_texture_npot is there
+static bool IsPowerOfTwo(int width, int height)
+{
+	return (width & (width - 1)) == 0 && (height & (height - 1)) == 0;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Cooking
+// ------------------------------------------------------------------------------------------------
+
+void GetDefaultKTXCookOptions(KTXCookOptions* options)
+{
+	options->format = KTX_COOK_UNCOMPRESSED;
+	options->generateMips = true;
+	options->mipFilter = MIP_FILTER_BOX;
+	options->etcQuality = ETC_QUALITY_HIGH;
+	options->numThreads = 0;
+}
+
+// Encodes one level in the cooked format; the result is exactly what goes into the file
+static bool CookLevel(const MipLevel& level, int bpp, const KTXCookOptions* options, std::vector<char>* pOut)
+{
+	switch (options->format)
+	{
+	case KTX_COOK_ETC1:
+	case KTX_COOK_ETC2:
+	{
+		ETCOptions etcOptions;
+		etcOptions.format = options->format == KTX_COOK_ETC1 ? ETC_FORMAT_ETC1 : (bpp == 32 ? ETC_FORMAT_ETC2_RGBA : ETC_FORMAT_ETC2_RGB);
+		etcOptions.quality = options->etcQuality;
+		etcOptions.numThreads = options->numThreads;
+		ETCImage image;
+		if (!CompressETC(level.pixels, level.width, level.height, bpp, &etcOptions, &image))
+			return false;
+		pOut->assign(image.data, image.data + image.size);
+		FreeETCImage(&image);
+		return true;
+	}
+	case KTX_COOK_PVRTC_4BPP:
+	case KTX_COOK_PVRTC_2BPP:
+	{
+		PVRTCOptions pvrtcOptions;
+		GetDefaultPVRTCOptions(&pvrtcOptions);
+		pvrtcOptions.bitsPerPixel = options->format == KTX_COOK_PVRTC_2BPP ? 2 : 4;
+		pvrtcOptions.numThreads = options->numThreads;
+		PVRTCImage image;
+		if (!CompressPVRTC(level.pixels, level.width, level.height, bpp, &pvrtcOptions, &image))
+			return false;
+		pOut->assign(image.data, image.data + image.size);
+		FreePVRTCImage(&image);
+		return true;
+	}
+	default:
+	{
+		size_t rowSize = (size_t)level.width * bpp / 8;
+		size_t rowPitch = AlignKTX(rowSize);
+		pOut->assign(rowPitch * level.height, 0);
+		for (int y = 0; y < level.height; y++)
+			memcpy(&(*pOut)[y * rowPitch], level.pixels + y * rowSize, rowSize);
+		return true;
+	}
+	}
+}
+
+// glInternalFormat of the first level decides the whole file
+static GLenum GetCookedInternalFormat(const KTXCookOptions* options, int bpp)
+{
+	switch (options->format)
+	{
+	case KTX_COOK_ETC1:			return GL_ETC1_RGB8_OES;
+	case KTX_COOK_ETC2:			return bpp == 32 ? GL_COMPRESSED_RGBA8_ETC2_EAC : GL_COMPRESSED_RGB8_ETC2;
+	case KTX_COOK_PVRTC_4BPP:	return bpp == 32 ? GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG : GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG;
+	case KTX_COOK_PVRTC_2BPP:	return bpp == 32 ? GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG : GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG;
+	default:					return bpp == 32 ? GL_RGBA : GL_RGB;
+	}
+}
+
+bool CookKTX(const char* szTGAFile, const char* szKTXFile, const KTXCookOptions* options)
+{
+	KTXCookOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultKTXCookOptions(&defaults);
+		options = &defaults;
+	}
+
+	int width, height, bpp;
+	char* pixels = LoadTGA(szTGAFile, &width, &height, &bpp);
+	if (pixels == NULL)
+		return false;
+
+	MipChain chain;
+	if (options->generateMips && IsPowerOfTwo(width, height))
+	{
+		MipOptions mipOptions;
+		GetDefaultMipOptions(&mipOptions);
+		mipOptions.filter = options->mipFilter;
+		mipOptions.numThreads = options->numThreads;
+		bool built = BuildMipChain(pixels, width, height, bpp, &mipOptions, &chain);
+		delete[] pixels;
+		if (!built)
+			return false;
+	}
+	else
+	{
+		memset(&chain, 0, sizeof(MipChain));
+		chain.bpp = bpp;
+		chain.numLevels = 1;
+		chain.levels[0].width = width;
+		chain.levels[0].height = height;
+		chain.levels[0].pixels = pixels;
+		chain.levels[0].size = (size_t)width * height * bpp / 8;
+		chain.storage = pixels;
+	}
+
+	bool compressed = options->format != KTX_COOK_UNCOMPRESSED;
+	GLenum baseFormat = bpp == 32 && options->format != KTX_COOK_ETC1 ? GL_RGBA : GL_RGB;
+
+	KTX_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+	header.endianness = KTX_ENDIAN_REF;
+	header.glType = compressed ? 0 : GL_UNSIGNED_BYTE;
+	header.glTypeSize = 1;
+	header.glFormat = compressed ? 0 : baseFormat;
+	header.glInternalFormat = GetCookedInternalFormat(options, bpp);
+	header.glBaseInternalFormat = baseFormat;
+	header.pixelWidth = width;
+	header.pixelHeight = height;
+	header.numberOfFaces = 1;
+	header.numberOfMipmapLevels = chain.numLevels;
+
+	FILE* pf;
+	if (fopen_s(&pf, szKTXFile, "wb") != 0)
+	{
+		FreeMipChain(&chain);
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, pf) == 1;
+	std::vector<char> levelData;
+	for (int i = 0; i < chain.numLevels && ok; i++)
+	{
+		ok = CookLevel(chain.levels[i], bpp, options, &levelData);
+		if (!ok)
+			break;
+
+		// Compressed sizes are whole 8 byte blocks and uncompressed rows are already aligned,
+		// so no mip padding is ever needed
+		unsigned int imageSize = (unsigned int)levelData.size();
+		ok = fwrite(&imageSize, sizeof(imageSize), 1, pf) == 1
+			&& fwrite(&levelData[0], 1, levelData.size(), pf) == levelData.size();
+	}
+
+	fclose(pf);
+	FreeMipChain(&chain);
+	if (!ok)
+		remove(szKTXFile);
+	return ok;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Loading
+// ------------------------------------------------------------------------------------------------
+
+bool OpenKTX(const char* szFileName, KTXFile* file)
+{
+	memset(file, 0, sizeof(KTXFile));
+	if (!MapFile(szFileName, &file->map))
+		return false;
+
+	KTX_HEADER header;
+	if (file->map.size < sizeof(header))
+	{
+		CloseKTX(file);
+		return false;
+	}
+	memcpy(&header, file->map.data, sizeof(header));
+
+	// Files from a big-endian producer would need every field swapped; the cook step never writes them
+	if (memcmp(header.identifier, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0 || header.endianness != KTX_ENDIAN_REF ||
+		header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth > 1 ||
+		header.numberOfArrayElements > 0 || header.numberOfFaces != 1 || header.numberOfMipmapLevels > MAX_MIP_LEVELS)
+	{
+		Debug("OpenKTX: %s is not a 2D KTX 1.1 texture\n", szFileName);
+		CloseKTX(file);
+		return false;
+	}
+
+	file->width = header.pixelWidth;
+	file->height = header.pixelHeight;
+	file->glType = header.glType;
+	file->glFormat = header.glFormat;
+	file->glInternalFormat = header.glInternalFormat;
+	file->compressed = header.glType == 0;
+	file->generateMips = header.numberOfMipmapLevels == 0;
+
+	int numLevels = file->generateMips ? 1 : header.numberOfMipmapLevels;
+	size_t offset = sizeof(header) + (size_t)header.bytesOfKeyValueData;
+	for (int i = 0; i < numLevels; i++)
+	{
+		unsigned int imageSize;
+		if (offset > file->map.size || file->map.size - offset < sizeof(imageSize))
+			break;
+		memcpy(&imageSize, file->map.data + offset, sizeof(imageSize));
+		offset += sizeof(imageSize);
+		if (file->map.size - offset < imageSize)
+			break;
+
+		file->levels[i] = file->map.data + offset;
+		file->levelSizes[i] = imageSize;
+		file->numLevels++;
+		offset += AlignKTX(imageSize);
+	}
+
+	if (file->numLevels != numLevels)
+	{
+		Debug("OpenKTX: %s is truncated\n", szFileName);
+		CloseKTX(file);
+		return false;
+	}
+	return true;
+}
+
+void UploadKTX(const KTXFile* file)
+{
+	glPixelStorei(GL_UNPACK_ALIGNMENT, KTX_ALIGNMENT);
+	for (int i = 0; i < file->numLevels; i++)
+	{
+		int w = file->width >> i > 0 ? file->width >> i : 1;
+		int h = file->height >> i > 0 ? file->height >> i : 1;
+		if (file->compressed)
+			glCompressedTexImage2D(GL_TEXTURE_2D, i, file->glInternalFormat, w, h, 0, (GLsizei)file->levelSizes[i], file->levels[i]);
+		else
+			glTexImage2D(GL_TEXTURE_2D, i, file->glInternalFormat, w, h, 0, file->glFormat, file->glType, file->levels[i]);
+	}
+
+	// An NPOT file from another cooker may still carry a chain, only level 0 of it is sampled
+	bool isPowerOfTwo = IsPowerOfTwo(file->width, file->height);
+	bool hasMips = file->numLevels > 1 && isPowerOfTwo;
+	if (file->generateMips && !file->compressed && isPowerOfTwo)
+	{
+		glGenerateMipmap(GL_TEXTURE_2D);
+		hasMips = true;
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, hasMips ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (!isPowerOfTwo)
+	{
+		// GLES2 only samples NPOT textures with clamped addressing
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+}
+
+void CloseKTX(KTXFile* file)
+{
+	UnmapFile(&file->map);
+	memset(file, 0, sizeof(KTXFile));
+}
+
+bool LoadKTX(const char* szFileName, int* width, int* height)
+{
+	KTXFile file;
+	if (!OpenKTX(szFileName, &file))
+		return false;
+
+	UploadKTX(&file);
+	*width = file.width;
+	*height = file.height;
+	CloseKTX(&file);
+	return true;
+}
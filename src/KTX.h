@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include "ETC.h"
+#include "FileMap.h"
+#include "Mipmap.h"
+#include <stddef.h>
+
+enum KTXCookFormat
+{
+	KTX_COOK_UNCOMPRESSED,		// RGB8/RGBA8 like the source, rows padded to 4 bytes
+	KTX_COOK_ETC1,				// alpha is dropped
+	KTX_COOK_ETC2,				// ETC2 RGB8, or RGBA8 with EAC alpha when the source has alpha
+	KTX_COOK_PVRTC_4BPP,		// power-of-two sources only
+	KTX_COOK_PVRTC_2BPP,
+};
+
+struct KTXCookOptions
+{
+	KTXCookFormat	format;
+	bool			generateMips;	// write every level down to 1x1, power-of-two sources only
+	MipFilter		mipFilter;
+	ETCQuality		etcQuality;
+	int				numThreads;		// 0 = one per hardware thread
+};
+
+// A KTX 1.1 file mapped for upload. The level pointers point straight into the mapping and are
+// already in the layout glTexImage2D/glCompressedTexImage2D expect (GL_UNPACK_ALIGNMENT 4).
+struct KTXFile
+{
+	FileMap			map;
+	int				width;
+	int				height;
+	GLenum			glType;				// 0 for compressed data
+	GLenum			glFormat;			// 0 for compressed data
+	GLenum			glInternalFormat;
+	bool			compressed;
+	bool			generateMips;		// the file asks for mipmaps to be generated at load time
+	int				numLevels;
+	const char*		levels[MAX_MIP_LEVELS];
+	size_t			levelSizes[MAX_MIP_LEVELS];
+};
+
+void GetDefaultKTXCookOptions(KTXCookOptions* options);
+
+// Offline step: decodes a TGA once and writes a KTX with every level ready for upload.
+// options may be NULL for the defaults (uncompressed, mipmapped, box filter, all cores).
+bool CookKTX(const char* szTGAFile, const char* szKTXFile, const KTXCookOptions* options);
+
+// Maps and validates a 2D KTX file; nothing is copied or converted
+bool OpenKTX(const char* szFileName, KTXFile* file);
+
+// Uploads every level to the texture bound to GL_TEXTURE_2D and sets its filtering
+void UploadKTX(const KTXFile* file);
+
+void CloseKTX(KTXFile* file);
+
+// OpenKTX + UploadKTX + CloseKTX
+bool LoadKTX(const char* szFileName, int* width, int* height);
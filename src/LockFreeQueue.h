@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+// Bounded multi-producer / multi-consumer queue (Vyukov's sequence-numbered ring). Push and Pop
+// never block or take a lock; they return false when the queue is full or empty.
+// Capacity must be a power of two.
+template <typename T, int Capacity>
+class LockFreeQueue
+{
+public:
+	LockFreeQueue()
+	{
+		static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+		for (int i = 0; i < Capacity; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		enqueuePos.store(0, std::memory_order_relaxed);
+		dequeuePos.store(0, std::memory_order_relaxed);
+	}
+
+	bool Push(const T& value)
+	{
+		Cell* cell;
+		size_t pos = enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells[pos & (Capacity - 1)];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+			if (diff == 0)
+			{
+				if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;	// full
+			else
+				pos = enqueuePos.load(std::memory_order_relaxed);
+		}
+
+		cell->data = value;
+		cell->sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool Pop(T& value)
+	{
+		Cell* cell;
+		size_t pos = dequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell = &cells[pos & (Capacity - 1)];
+			size_t seq = cell->sequence.load(std::memory_order_acquire);
+			ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+			if (diff == 0)
+			{
+				if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+				return false;	// empty
+			else
+				pos = dequeuePos.load(std::memory_order_relaxed);
+		}
+
+		value = cell->data;
+		cell->sequence.store(pos + Capacity, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t>	sequence;
+		T					data;
+	};
+
+	Cell								cells[Capacity];
+	alignas(64) std::atomic<size_t>		enqueuePos;
+	alignas(64) std::atomic<size_t>		dequeuePos;
+};
@@ -0,0 +1,365 @@
+#include "Mipmap.h"
+#include "Parallel.h"
+#include "ogles_sys.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define MIP_SSE 1
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// One RGBA float pixel, four lanes of an SSE register where available
+// ------------------------------------------------------------------------------------------------
+
+#if MIP_SSE
+
+typedef __m128 Vec4;
+
+static inline Vec4 Vec4Zero()								{ return _mm_setzero_ps(); }
+static inline Vec4 Vec4Load(const float* p)					{ return _mm_loadu_ps(p); }
+static inline void Vec4Store(float* p, Vec4 v)				{ _mm_storeu_ps(p, v); }
+static inline Vec4 Vec4MulAdd(Vec4 acc, Vec4 v, float w)	{ return _mm_add_ps(acc, _mm_mul_ps(v, _mm_set1_ps(w))); }
+static inline Vec4 Vec4Saturate(Vec4 v)						{ return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f)); }
+
+#else
+
+struct Vec4 { float v[4]; };
+
+static inline Vec4 Vec4Zero()								{ Vec4 r = { { 0.0f, 0.0f, 0.0f, 0.0f } }; return r; }
+static inline Vec4 Vec4Load(const float* p)					{ Vec4 r = { { p[0], p[1], p[2], p[3] } }; return r; }
+static inline void Vec4Store(float* p, Vec4 v)				{ p[0] = v.v[0]; p[1] = v.v[1]; p[2] = v.v[2]; p[3] = v.v[3]; }
+static inline Vec4 Vec4MulAdd(Vec4 acc, Vec4 v, float w)	{ for (int i = 0; i < 4; i++) acc.v[i] += v.v[i] * w; return acc; }
+static inline Vec4 Vec4Saturate(Vec4 v)						{ for (int i = 0; i < 4; i++) v.v[i] = v.v[i] < 0.0f ? 0.0f : (v.v[i] > 1.0f ? 1.0f : v.v[i]); return v; }
+
+#endif
+
+// ------------------------------------------------------------------------------------------------
+// Gamma tables
+// ------------------------------------------------------------------------------------------------
+
+const int LINEAR_TO_SRGB_SIZE = 16384;
+
+struct GammaTables
+{
+	float			srgbToLinear[256];
+	unsigned char	linearToSrgb[LINEAR_TO_SRGB_SIZE + 1];
+
+	GammaTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i <= LINEAR_TO_SRGB_SIZE; i++)
+		{
+			float c = (float)i / LINEAR_TO_SRGB_SIZE;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+			linearToSrgb[i] = (unsigned char)(s * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const GammaTables& GetGammaTables()
+{
+	static const GammaTables s_tables;
+	return s_tables;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Filter kernels
+// ------------------------------------------------------------------------------------------------
+
+const float PI = 3.14159265358979f;
+
+static float Sinc(float x)
+{
+	if (fabsf(x) < 1e-5f)
+		return 1.0f;
+	x *= PI;
+	return sinf(x) / x;
+}
+
+static float BesselI0(float x)
+{
+	float sum = 1.0f, term = 1.0f;
+	for (int k = 1; k < 20; k++)
+	{
+		term *= (x * 0.5f / k) * (x * 0.5f / k);
+		sum += term;
+	}
+	return sum;
+}
+
+static float FilterSupport(MipFilter filter)
+{
+	return filter == MIP_FILTER_BOX ? 0.5f : 3.0f;
+}
+
+// x is the distance from the destination pixel center, in destination pixels
+static float FilterWeight(MipFilter filter, float x)
+{
+	x = fabsf(x);
+	switch (filter)
+	{
+	case MIP_FILTER_KAISER:
+	{
+		const float alpha = 4.0f, width = 3.0f;
+		if (x >= width)
+			return 0.0f;
+		float t = x / width;
+		return Sinc(x) * BesselI0(alpha * sqrtf(1.0f - t * t)) / BesselI0(alpha);
+	}
+	case MIP_FILTER_LANCZOS:
+		return x < 3.0f ? Sinc(x) * Sinc(x / 3.0f) : 0.0f;
+	default:
+		return x < 0.5f ? 1.0f : (x == 0.5f ? 0.5f : 0.0f);
+	}
+}
+
+// Source indices (clamped to the edge) and normalized weights, taps per destination pixel
+struct FilterKernel
+{
+	int					taps;
+	std::vector<int>	indices;
+	std::vector<float>	weights;
+};
+
+static void BuildKernel(FilterKernel* kernel, MipFilter filter, int srcSize, int dstSize)
+{
+	float scale = (float)srcSize / dstSize;
+	float support = FilterSupport(filter) * scale;
+
+	kernel->taps = (int)ceilf(support * 2.0f) + 1;
+	kernel->indices.resize(dstSize * kernel->taps);
+	kernel->weights.resize(dstSize * kernel->taps);
+
+	for (int i = 0; i < dstSize; i++)
+	{
+		float center = (i + 0.5f) * scale - 0.5f;
+		int left = (int)ceilf(center - support);
+		int* pIndices = &kernel->indices[i * kernel->taps];
+		float* pWeights = &kernel->weights[i * kernel->taps];
+
+		float sum = 0.0f;
+		for (int t = 0; t < kernel->taps; t++)
+		{
+			int j = left + t;
+			pWeights[t] = FilterWeight(filter, (j - center) / scale);
+			pIndices[t] = j < 0 ? 0 : (j >= srcSize ? srcSize - 1 : j);
+			sum += pWeights[t];
+		}
+		for (int t = 0; t < kernel->taps; t++)
+			pWeights[t] = sum != 0.0f ? pWeights[t] / sum : 1.0f / kernel->taps;
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// Level filtering, split into row ranges for ParallelFor
+// ------------------------------------------------------------------------------------------------
+
+struct MipPass
+{
+	const float*		pSrc;		// RGBA float, srcWidth x srcHeight
+	float*				pTemp;		// RGBA float, dstWidth x srcHeight
+	float*				pDst;		// RGBA float, dstWidth x dstHeight
+	char*				pOut;		// quantized RGB(A) destination level
+	int					srcWidth, srcHeight;
+	int					dstWidth, dstHeight;
+	int					pixelSize;
+	bool				gammaCorrect;
+	const FilterKernel*	pKernelX;
+	const FilterKernel*	pKernelY;
+};
+
+static void FilterRowsX(void* pUserData, int rowBegin, int rowEnd)
+{
+	const MipPass* pPass = (const MipPass*)pUserData;
+	const FilterKernel* k = pPass->pKernelX;
+
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		const float* pSrcRow = pPass->pSrc + (size_t)y * pPass->srcWidth * 4;
+		float* pTempRow = pPass->pTemp + (size_t)y * pPass->dstWidth * 4;
+		for (int x = 0; x < pPass->dstWidth; x++)
+		{
+			const int* pIndices = &k->indices[x * k->taps];
+			const float* pWeights = &k->weights[x * k->taps];
+			Vec4 acc = Vec4Zero();
+			for (int t = 0; t < k->taps; t++)
+				acc = Vec4MulAdd(acc, Vec4Load(pSrcRow + pIndices[t] * 4), pWeights[t]);
+			Vec4Store(pTempRow + x * 4, acc);
+		}
+	}
+}
+
+static void FilterRowsY(void* pUserData, int rowBegin, int rowEnd)
+{
+	const MipPass* pPass = (const MipPass*)pUserData;
+	const FilterKernel* k = pPass->pKernelY;
+	const GammaTables& gamma = GetGammaTables();
+	int rowFloats = pPass->dstWidth * 4;
+
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		float* pDstRow = pPass->pDst + (size_t)y * rowFloats;
+		const int* pIndices = &k->indices[y * k->taps];
+		const float* pWeights = &k->weights[y * k->taps];
+
+		// Accumulate whole rows so the temporary image is read sequentially
+		for (int x = 0; x < pPass->dstWidth; x++)
+			Vec4Store(pDstRow + x * 4, Vec4Zero());
+		for (int t = 0; t < k->taps; t++)
+		{
+			const float* pTempRow = pPass->pTemp + (size_t)pIndices[t] * rowFloats;
+			for (int x = 0; x < pPass->dstWidth; x++)
+				Vec4Store(pDstRow + x * 4, Vec4MulAdd(Vec4Load(pDstRow + x * 4), Vec4Load(pTempRow + x * 4), pWeights[t]));
+		}
+
+		// Clamp so ringing does not build up over the chain, then quantize
+		unsigned char* pOut = (unsigned char*)pPass->pOut + (size_t)y * pPass->dstWidth * pPass->pixelSize;
+		for (int x = 0; x < pPass->dstWidth; x++)
+		{
+			float* p = pDstRow + x * 4;
+			Vec4Store(p, Vec4Saturate(Vec4Load(p)));
+			for (int c = 0; c < 3; c++)
+			{
+				*pOut++ = pPass->gammaCorrect
+					? gamma.linearToSrgb[(int)(p[c] * LINEAR_TO_SRGB_SIZE + 0.5f)]
+					: (unsigned char)(p[c] * 255.0f + 0.5f);
+			}
+			if (pPass->pixelSize == 4)
+				*pOut++ = (unsigned char)(p[3] * 255.0f + 0.5f);
+		}
+	}
+}
+
+// Below this many pixels a level is filtered on the calling thread
+const int MIN_PARALLEL_MIP_PIXELS = 128 * 128;
+
+// ------------------------------------------------------------------------------------------------
+
+void GetDefaultMipOptions(MipOptions* options)
+{
+	options->filter = MIP_FILTER_BOX;
+	options->gammaCorrect = true;
+	options->numThreads = 0;
+}
+
+bool BuildMipChain(const char* pixels, int width, int height, int bpp, const MipOptions* options, MipChain* chain)
+{
+	memset(chain, 0, sizeof(MipChain));
+	if (pixels == NULL || width <= 0 || height <= 0 || (bpp != 24 && bpp != 32))
+		return false;
+
+	MipOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultMipOptions(&defaults);
+		options = &defaults;
+	}
+
+	int pixelSize = bpp / 8;
+	chain->bpp = bpp;
+
+	// Lay out every level in one allocation
+	size_t totalSize = 0;
+	int w = width, h = height;
+	for (;;)
+	{
+		MipLevel& level = chain->levels[chain->numLevels++];
+		level.width = w;
+		level.height = h;
+		level.size = (size_t)w * h * pixelSize;
+		totalSize += level.size;
+		if ((w == 1 && h == 1) || chain->numLevels == MAX_MIP_LEVELS)
+			break;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+
+	chain->storage = new char[totalSize];
+	char* p = chain->storage;
+	for (int i = 0; i < chain->numLevels; i++)
+	{
+		chain->levels[i].pixels = p;
+		p += chain->levels[i].size;
+	}
+	memcpy(chain->levels[0].pixels, pixels, chain->levels[0].size);
+
+	if (chain->numLevels == 1)
+		return true;
+
+	// Level 0 in linear float RGBA
+	const GammaTables& gamma = GetGammaTables();
+	std::vector<float> src((size_t)width * height * 4);
+	const unsigned char* pIn = (const unsigned char*)pixels;
+	for (size_t i = 0; i < (size_t)width * height; i++)
+	{
+		for (int c = 0; c < 3; c++)
+			src[i * 4 + c] = options->gammaCorrect ? gamma.srgbToLinear[pIn[c]] : pIn[c] / 255.0f;
+		src[i * 4 + 3] = pixelSize == 4 ? pIn[3] / 255.0f : 1.0f;
+		pIn += pixelSize;
+	}
+
+	std::vector<float> temp, dst;
+	for (int i = 1; i < chain->numLevels; i++)
+	{
+		const MipLevel& srcLevel = chain->levels[i - 1];
+		const MipLevel& dstLevel = chain->levels[i];
+
+		FilterKernel kernelX, kernelY;
+		BuildKernel(&kernelX, options->filter, srcLevel.width, dstLevel.width);
+		BuildKernel(&kernelY, options->filter, srcLevel.height, dstLevel.height);
+
+		temp.resize((size_t)dstLevel.width * srcLevel.height * 4);
+		dst.resize((size_t)dstLevel.width * dstLevel.height * 4);
+
+		MipPass pass;
+		pass.pSrc = &src[0];
+		pass.pTemp = &temp[0];
+		pass.pDst = &dst[0];
+		pass.pOut = dstLevel.pixels;
+		pass.srcWidth = srcLevel.width;
+		pass.srcHeight = srcLevel.height;
+		pass.dstWidth = dstLevel.width;
+		pass.dstHeight = dstLevel.height;
+		pass.pixelSize = pixelSize;
+		pass.gammaCorrect = options->gammaCorrect;
+		pass.pKernelX = &kernelX;
+		pass.pKernelY = &kernelY;
+
+		int numThreads = srcLevel.width * srcLevel.height < MIN_PARALLEL_MIP_PIXELS ? 1 : options->numThreads;
+		ParallelFor(srcLevel.height, numThreads, FilterRowsX, &pass);
+		ParallelFor(dstLevel.height, numThreads, FilterRowsY, &pass);
+
+		// The next level is filtered from the unquantized result
+		src.swap(dst);
+	}
+
+	return true;
+}
+
+void FreeMipChain(MipChain* chain)
+{
+	delete[] chain->storage;
+	memset(chain, 0, sizeof(MipChain));
+}
+
+void UploadMipChain(const MipChain* chain)
+{
+	GLenum format = chain->bpp == 32 ? GL_RGBA : GL_RGB;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int i = 0; i < chain->numLevels; i++)
+	{
+		const MipLevel& level = chain->levels[i];
+		glTexImage2D(GL_TEXTURE_2D, i, format, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, level.pixels);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, chain->numLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+
+const int MAX_MIP_LEVELS = 16;
+
+enum MipFilter
+{
+	MIP_FILTER_BOX,			// 2x2 average, fastest
+	MIP_FILTER_KAISER,		// Kaiser windowed sinc, sharp with little ringing
+	MIP_FILTER_LANCZOS,		// Lanczos-3, sharpest
+};
+
+struct MipOptions
+{
+	MipFilter	filter;
+	bool		gammaCorrect;	// filter RGB in linear space, treating the input as sRGB (alpha stays linear)
+	int			numThreads;		// rows of a level are split over this many threads, 0 = one per hardware thread
+};
+
+struct MipLevel
+{
+	int			width;
+	int			height;
+	char*		pixels;			// tightly packed RGB(A) rows, points into MipChain::storage
+	size_t		size;
+};
+
+struct MipChain
+{
+	int			bpp;			// 24 or 32, same as the source
+	int			numLevels;
+	MipLevel	levels[MAX_MIP_LEVELS];
+	char*		storage;		// all levels, back to back, level 0 first
+};
+
+void GetDefaultMipOptions(MipOptions* options);
+
+// Builds the full chain down to 1x1 from an RGB/RGBA image as returned by LoadTGA. Level 0 is a copy
+// of the source; every further level is filtered from the previous one at float precision.
+// options may be NULL for the defaults (box filter, gamma correct, all cores).
+bool BuildMipChain(const char* pixels, int width, int height, int bpp, const MipOptions* options, MipChain* chain);
+
+void FreeMipChain(MipChain* chain);
+
+// Uploads every level to the texture bound to GL_TEXTURE_2D and selects trilinear filtering.
+// GLES2 only allows mipmaps on power-of-two textures unless GL_OES_texture_npot is present.
+void UploadMipChain(const MipChain* chain);
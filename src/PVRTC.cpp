@@ -0,0 +1,679 @@
+#include "PVRTC.h"
+#include "FileMap.h"
+#include "Mipmap.h"
+#include "Parallel.h"
+#include "TGA.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// ------------------------------------------------------------------------------------------------
+// PVR v3 container
+// ------------------------------------------------------------------------------------------------
+
+#pragma pack(push, 1)
+
+struct PVR_HEADER
+{
+	unsigned int		version;			// PVR_VERSION, 'P' 'V' 'R' 3 in file order
+	unsigned int		flags;
+	unsigned long long	pixelFormat;		// PVR_FORMAT_*, upper 32 bits 0 for compressed formats
+	unsigned int		colourSpace;		// 0 = linear, 1 = sRGB
+	unsigned int		channelType;
+	unsigned int		height;
+	unsigned int		width;
+	unsigned int		depth;
+	unsigned int		numSurfaces;
+	unsigned int		numFaces;
+	unsigned int		mipMapCount;
+	unsigned int		metaDataSize;		// bytes of meta data between the header and the levels
+};
+
+#pragma pack(pop)
+
+const unsigned int PVR_VERSION = 0x03525650;
+
+enum
+{
+	PVR_FORMAT_PVRTC_2BPP_RGB	= 0,
+	PVR_FORMAT_PVRTC_2BPP_RGBA	= 1,
+	PVR_FORMAT_PVRTC_4BPP_RGB	= 2,
+	PVR_FORMAT_PVRTC_4BPP_RGBA	= 3,
+};
+
+// ------------------------------------------------------------------------------------------------
+// Block colors
+//
+// Each 64-bit word holds 32 bits of modulation and a 32-bit color word: bit 0 the modulation mode,
+// bits 1-15 color A and bits 16-31 color B. A color is opaque RGB (555, or 554 for A) when its top
+// bit is set, otherwise ARGB 3444 (3443 for A). The decoder upscales A and B bilinearly between
+// block centers and blends them per pixel by the modulation weight.
+// ------------------------------------------------------------------------------------------------
+
+// Alpha above this is closer to opaque (255) than to the largest translucent alpha (238)
+const float PVRTC_OPAQUE_ALPHA = 246.5f;
+
+static inline int Quantize(float v, int maxValue)
+{
+	int q = (int)(v * maxValue / 255.0f + 0.5f);
+	return q < 0 ? 0 : (q > maxValue ? maxValue : q);
+}
+
+static inline float Expand5(int c)		{ return (float)((c << 3) | (c >> 2)); }
+static inline int Extend4To5(int c)		{ return (c << 1) | (c >> 3); }
+
+// Quantizes an RGBA color to the 16-bit A (isColorA) or B field and returns its decoded value
+static unsigned int EncodeColor(const float* rgba, bool isColorA, float* pDecoded)
+{
+	unsigned int bits;
+	int r, g, b, a;
+	if (rgba[3] >= PVRTC_OPAQUE_ALPHA)
+	{
+		r = Quantize(rgba[0], 31);
+		g = Quantize(rgba[1], 31);
+		if (isColorA)
+		{
+			int b4 = Quantize(rgba[2], 15);
+			bits = 0x8000 | (r << 10) | (g << 5) | (b4 << 1);
+			b = Extend4To5(b4);
+		}
+		else
+		{
+			b = Quantize(rgba[2], 31);
+			bits = 0x8000 | (r << 10) | (g << 5) | b;
+		}
+		a = 255;
+	}
+	else
+	{
+		int a3 = Quantize(rgba[3] * 255.0f / 238.0f, 7);
+		int r4 = Quantize(rgba[0], 15);
+		int g4 = Quantize(rgba[1], 15);
+		r = Extend4To5(r4);
+		g = Extend4To5(g4);
+		if (isColorA)
+		{
+			int b3 = Quantize(rgba[2], 7);
+			bits = (a3 << 12) | (r4 << 8) | (g4 << 4) | (b3 << 1);
+			b = (b3 << 2) | (b3 >> 1);
+		}
+		else
+		{
+			int b4 = Quantize(rgba[2], 15);
+			bits = (a3 << 12) | (r4 << 8) | (g4 << 4) | b4;
+			b = Extend4To5(b4);
+		}
+		a = a3 * 2 * 17;
+	}
+
+	pDecoded[0] = Expand5(r);
+	pDecoded[1] = Expand5(g);
+	pDecoded[2] = Expand5(b);
+	pDecoded[3] = (float)a;
+	return bits;
+}
+
+// Word index of block (x, y): the bits of the smaller dimension interleaved (y lowest), the
+// remaining bits of the larger one on top
+static unsigned int TwiddleBlock(int blocksX, int blocksY, int x, int y)
+{
+	int minDimension = blocksX < blocksY ? blocksX : blocksY;
+	unsigned int twiddled = 0;
+	int shift = 0;
+	for (int bit = 1; bit < minDimension; bit <<= 1, shift++)
+	{
+		if (y & bit)
+			twiddled |= 1u << (2 * shift);
+		if (x & bit)
+			twiddled |= 2u << (2 * shift);
+	}
+	unsigned int rest = (unsigned int)(blocksX < blocksY ? y : x) >> shift;
+	return twiddled | (rest << (2 * shift));
+}
+
+// ------------------------------------------------------------------------------------------------
+// Encoder passes, each split into block rows for ParallelFor
+// ------------------------------------------------------------------------------------------------
+
+// Rounds of per-block least squares fitting after the initial min/max endpoints
+const int PVRTC_REFINE_PASSES = 3;
+const float PVRTC_REFINE_DAMPING = 0.05f;
+
+struct PVRTCPass
+{
+	const unsigned char*	pSrc;
+	int						width, height, pixelSize;
+	bool					hasAlpha;
+	int						blockW, blockH;		// 4x4 at 4bpp, 8x4 at 2bpp
+	int						blocksX, blocksY;
+	int						numWeights;			// modulation levels, 4 at 4bpp, 2 at 2bpp
+	const float*			pWeights;
+
+	int						refinePhase;		// RefineEndpointRows only updates blocks with this (x & 1) | (y & 1) << 1
+
+	float*					pEndpoints;			// per block, low then high RGBA, unquantized
+	float*					pDecoded;			// per block, colors A then B RGBA as the GPU sees them
+	unsigned int*			pColorWords;		// per block
+	unsigned char*			pModulation;		// per pixel of the block grid, index into pWeights
+
+	unsigned int*			pOut;				// two 32-bit words per block, Morton order
+};
+
+static const float s_weights4bpp[4] = { 0.0f, 3.0f / 8.0f, 5.0f / 8.0f, 1.0f };
+static const float s_weights2bpp[2] = { 0.0f, 1.0f };
+
+// Source texel for a block grid position; grids larger than the image (tiny levels) wrap around
+static inline void FetchPixel(const PVRTCPass* p, int x, int y, float* rgba)
+{
+	const unsigned char* pPixel = p->pSrc + ((size_t)(y % p->height) * p->width + x % p->width) * p->pixelSize;
+	rgba[0] = pPixel[0];
+	rgba[1] = pPixel[1];
+	rgba[2] = pPixel[2];
+	rgba[3] = p->hasAlpha ? pPixel[3] : 255.0f;
+}
+
+// The four blocks whose colors are blended at a pixel, and their bilinear weights
+static void GetBlockWeights(const PVRTCPass* p, int x, int y, int* blocks, float* weights)
+{
+	int fx = x - p->blockW / 2, fy = y - p->blockH / 2;
+	int bx = fx >= 0 ? fx / p->blockW : -1;
+	int by = fy >= 0 ? fy / p->blockH : -1;
+	float u = (float)(fx - bx * p->blockW) / p->blockW;
+	float v = (float)(fy - by * p->blockH) / p->blockH;
+
+	int x0 = (bx + p->blocksX) % p->blocksX, x1 = (bx + 1) % p->blocksX;
+	int y0 = (by + p->blocksY) % p->blocksY, y1 = (by + 1) % p->blocksY;
+	blocks[0] = y0 * p->blocksX + x0;
+	blocks[1] = y0 * p->blocksX + x1;
+	blocks[2] = y1 * p->blocksX + x0;
+	blocks[3] = y1 * p->blocksX + x1;
+	weights[0] = (1.0f - u) * (1.0f - v);
+	weights[1] = u * (1.0f - v);
+	weights[2] = (1.0f - u) * v;
+	weights[3] = u * v;
+}
+
+static void GetInterpolatedColors(const PVRTCPass* p, int x, int y, float* colorA, float* colorB)
+{
+	int blocks[4];
+	float weights[4];
+	GetBlockWeights(p, x, y, blocks, weights);
+	for (int c = 0; c < 4; c++)
+	{
+		colorA[c] = 0.0f;
+		colorB[c] = 0.0f;
+		for (int k = 0; k < 4; k++)
+		{
+			colorA[c] += weights[k] * p->pDecoded[blocks[k] * 8 + c];
+			colorB[c] += weights[k] * p->pDecoded[blocks[k] * 8 + 4 + c];
+		}
+	}
+}
+
+static float ColorError(const PVRTCPass* p, const float* a, const float* b)
+{
+	float e = 0.0f;
+	for (int c = 0; c < (p->hasAlpha ? 4 : 3); c++)
+		e += (a[c] - b[c]) * (a[c] - b[c]);
+	return e;
+}
+
+// Initial endpoints: the extremes of the block along its principal axis
+static void ComputeEndpointRows(void* pUserData, int rowBegin, int rowEnd)
+{
+	const PVRTCPass* p = (const PVRTCPass*)pUserData;
+	int numPixels = p->blockW * p->blockH;
+	std::vector<float> pixels(numPixels * 4);
+
+	for (int by = rowBegin; by < rowEnd; by++)
+	{
+		for (int bx = 0; bx < p->blocksX; bx++)
+		{
+			float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int i = 0; i < numPixels; i++)
+			{
+				FetchPixel(p, bx * p->blockW + i % p->blockW, by * p->blockH + i / p->blockW, &pixels[i * 4]);
+				for (int c = 0; c < 4; c++)
+					mean[c] += pixels[i * 4 + c] / numPixels;
+			}
+
+			float cov[4][4] = {};
+			for (int i = 0; i < numPixels; i++)
+				for (int r = 0; r < 4; r++)
+					for (int c = 0; c < 4; c++)
+						cov[r][c] += (pixels[i * 4 + r] - mean[r]) * (pixels[i * 4 + c] - mean[c]);
+
+			// Power iteration, starting from the luminance direction
+			float axis[4] = { 0.3f, 0.6f, 0.1f, 0.1f };
+			for (int iter = 0; iter < 8; iter++)
+			{
+				float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (int r = 0; r < 4; r++)
+					for (int c = 0; c < 4; c++)
+						next[r] += cov[r][c] * axis[c];
+				float len = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+				if (len < 1e-6f)
+					break;
+				for (int c = 0; c < 4; c++)
+					axis[c] = next[c] / len;
+			}
+
+			float tMin = 0.0f, tMax = 0.0f;
+			for (int i = 0; i < numPixels; i++)
+			{
+				float t = 0.0f;
+				for (int c = 0; c < 4; c++)
+					t += (pixels[i * 4 + c] - mean[c]) * axis[c];
+				tMin = t < tMin ? t : tMin;
+				tMax = t > tMax ? t : tMax;
+			}
+
+			float* pEndpoints = p->pEndpoints + (by * p->blocksX + bx) * 8;
+			for (int c = 0; c < 4; c++)
+			{
+				float lo = mean[c] + axis[c] * tMin, hi = mean[c] + axis[c] * tMax;
+				pEndpoints[c] = lo < 0.0f ? 0.0f : (lo > 255.0f ? 255.0f : lo);
+				pEndpoints[4 + c] = hi < 0.0f ? 0.0f : (hi > 255.0f ? 255.0f : hi);
+			}
+		}
+	}
+}
+
+static void QuantizeEndpointRows(void* pUserData, int rowBegin, int rowEnd)
+{
+	const PVRTCPass* p = (const PVRTCPass*)pUserData;
+	for (int block = rowBegin * p->blocksX; block < rowEnd * p->blocksX; block++)
+	{
+		const float* pEndpoints = p->pEndpoints + block * 8;
+		float* pDecoded = p->pDecoded + block * 8;
+		unsigned int colorA = EncodeColor(pEndpoints, true, pDecoded);
+		unsigned int colorB = EncodeColor(pEndpoints + 4, false, pDecoded + 4);
+		p->pColorWords[block] = (colorB << 16) | colorA;	// modulation mode 0
+	}
+}
+
+static void ChooseModulationRows(void* pUserData, int rowBegin, int rowEnd)
+{
+	const PVRTCPass* p = (const PVRTCPass*)pUserData;
+	int gridW = p->blocksX * p->blockW;
+
+	for (int y = rowBegin * p->blockH; y < rowEnd * p->blockH; y++)
+	{
+		for (int x = 0; x < gridW; x++)
+		{
+			float pixel[4], colorA[4], colorB[4], blended[4];
+			FetchPixel(p, x, y, pixel);
+			GetInterpolatedColors(p, x, y, colorA, colorB);
+
+			float bestError = 1e30f;
+			for (int m = 0; m < p->numWeights; m++)
+			{
+				for (int c = 0; c < 4; c++)
+					blended[c] = colorA[c] + (colorB[c] - colorA[c]) * p->pWeights[m];
+				float e = ColorError(p, blended, pixel);
+				if (e < bestError)
+				{
+					bestError = e;
+					p->pModulation[(size_t)y * gridW + x] = (unsigned char)m;
+				}
+			}
+		}
+	}
+}
+
+// Least squares fit of one block's endpoints with its neighbours and the modulation held fixed.
+// Blocks whose colors overlap never share a phase, so each fit sees settled neighbours.
+static void RefineEndpointRows(void* pUserData, int rowBegin, int rowEnd)
+{
+	const PVRTCPass* p = (const PVRTCPass*)pUserData;
+	int gridW = p->blocksX * p->blockW, gridH = p->blocksY * p->blockH;
+
+	for (int by = rowBegin; by < rowEnd; by++)
+	{
+		if ((by & 1) != p->refinePhase >> 1)
+			continue;
+		for (int bx = p->refinePhase & 1; bx < p->blocksX; bx += 2)
+		{
+			int block = by * p->blocksX + bx;
+			float saa = 0.0f, sab = 0.0f, sbb = 0.0f;
+			float sar[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, sbr[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+			// Every pixel this block's colors reach, up to one block away from its center
+			int cx = bx * p->blockW + p->blockW / 2, cy = by * p->blockH + p->blockH / 2;
+			for (int dy = -p->blockH + 1; dy < p->blockH; dy++)
+			{
+				for (int dx = -p->blockW + 1; dx < p->blockW; dx++)
+				{
+					int x = (cx + dx + gridW) % gridW, y = (cy + dy + gridH) % gridH;
+					int blocks[4];
+					float weights[4], pixel[4], rest[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					GetBlockWeights(p, x, y, blocks, weights);
+					FetchPixel(p, x, y, pixel);
+					float m = p->pWeights[p->pModulation[(size_t)y * gridW + x]];
+
+					float w = 0.0f;
+					for (int k = 0; k < 4; k++)
+					{
+						if (blocks[k] == block)
+						{
+							w += weights[k];
+							continue;
+						}
+						const float* pDecoded = p->pDecoded + blocks[k] * 8;
+						for (int c = 0; c < 4; c++)
+							rest[c] += weights[k] * (pDecoded[c] + (pDecoded[4 + c] - pDecoded[c]) * m);
+					}
+
+					float ca = w * (1.0f - m), cb = w * m;
+					saa += ca * ca;
+					sab += ca * cb;
+					sbb += cb * cb;
+					for (int c = 0; c < 4; c++)
+					{
+						sar[c] += ca * (pixel[c] - rest[c]);
+						sbr[c] += cb * (pixel[c] - rest[c]);
+					}
+				}
+			}
+
+			// Pull weakly towards the current endpoints, so a block whose pixels all sit near the
+			// middle of the modulation range cannot fly apart
+			float* pEndpoints = p->pEndpoints + block * 8;
+			float lambda = PVRTC_REFINE_DAMPING * (saa + sbb) + 1e-3f;
+			saa += lambda;
+			sbb += lambda;
+			float det = saa * sbb - sab * sab;
+			for (int c = 0; c < 4; c++)
+			{
+				float ra = sar[c] + lambda * pEndpoints[c];
+				float rb = sbr[c] + lambda * pEndpoints[4 + c];
+				float a = (sbb * ra - sab * rb) / det;
+				float b = (saa * rb - sab * ra) / det;
+				pEndpoints[c] = a < 0.0f ? 0.0f : (a > 255.0f ? 255.0f : a);
+				pEndpoints[4 + c] = b < 0.0f ? 0.0f : (b > 255.0f ? 255.0f : b);
+			}
+			if (!p->hasAlpha)
+				pEndpoints[3] = pEndpoints[7] = 255.0f;
+		}
+	}
+}
+
+static void PackBlockRows(void* pUserData, int rowBegin, int rowEnd)
+{
+	const PVRTCPass* p = (const PVRTCPass*)pUserData;
+	int gridW = p->blocksX * p->blockW;
+	int bitsPerPixel = p->numWeights == 4 ? 2 : 1;
+
+	for (int by = rowBegin; by < rowEnd; by++)
+	{
+		for (int bx = 0; bx < p->blocksX; bx++)
+		{
+			// Pixels in row-major order from the least significant bit
+			unsigned int modulation = 0;
+			for (int i = 0; i < p->blockW * p->blockH; i++)
+			{
+				int x = bx * p->blockW + i % p->blockW, y = by * p->blockH + i / p->blockW;
+				modulation |= (unsigned int)p->pModulation[(size_t)y * gridW + x] << (i * bitsPerPixel);
+			}
+
+			unsigned int* pWord = p->pOut + TwiddleBlock(p->blocksX, p->blocksY, bx, by) * 2;
+			pWord[0] = modulation;
+			pWord[1] = p->pColorWords[by * p->blocksX + bx];
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+
+static bool IsPowerOfTwo(int n)
+{
+	return n > 0 && (n & (n - 1)) == 0;
+}
+
+void GetDefaultPVRTCOptions(PVRTCOptions* options)
+{
+	options->bitsPerPixel = 4;
+	options->generateMips = false;
+	options->numThreads = 0;
+}
+
+size_t GetPVRTCDataSize(int bitsPerPixel, int width, int height)
+{
+	int blockW = bitsPerPixel == 2 ? 8 : 4;
+	size_t blocksX = width / blockW > 2 ? width / blockW : 2;
+	size_t blocksY = height / 4 > 2 ? height / 4 : 2;
+	return blocksX * blocksY * 8;
+}
+
+bool CompressPVRTC(const char* pixels, int width, int height, int bpp, const PVRTCOptions* options, PVRTCImage* image)
+{
+	memset(image, 0, sizeof(PVRTCImage));
+	if (pixels == NULL || !IsPowerOfTwo(width) || !IsPowerOfTwo(height) || (bpp != 24 && bpp != 32))
+		return false;
+
+	PVRTCOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultPVRTCOptions(&defaults);
+		options = &defaults;
+	}
+
+	bool is2bpp = options->bitsPerPixel == 2;
+	bool hasAlpha = bpp == 32;
+
+	image->width = width;
+	image->height = height;
+	image->bitsPerPixel = is2bpp ? 2 : 4;
+	if (is2bpp)
+		image->glFormat = hasAlpha ? GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG : GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG;
+	else
+		image->glFormat = hasAlpha ? GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG : GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG;
+	image->size = GetPVRTCDataSize(image->bitsPerPixel, width, height);
+	image->data = new char[image->size];
+
+	PVRTCPass pass;
+	pass.pSrc = (const unsigned char*)pixels;
+	pass.width = width;
+	pass.height = height;
+	pass.pixelSize = bpp / 8;
+	pass.hasAlpha = hasAlpha;
+	pass.blockW = is2bpp ? 8 : 4;
+	pass.blockH = 4;
+	pass.blocksX = width / pass.blockW > 2 ? width / pass.blockW : 2;
+	pass.blocksY = height / pass.blockH > 2 ? height / pass.blockH : 2;
+	pass.numWeights = is2bpp ? 2 : 4;
+	pass.pWeights = is2bpp ? s_weights2bpp : s_weights4bpp;
+	pass.refinePhase = 0;
+
+	int numBlocks = pass.blocksX * pass.blocksY;
+	std::vector<float> endpoints(numBlocks * 8), decoded(numBlocks * 8);
+	std::vector<unsigned int> colorWords(numBlocks);
+	std::vector<unsigned char> modulation((size_t)numBlocks * pass.blockW * pass.blockH);
+	pass.pEndpoints = &endpoints[0];
+	pass.pDecoded = &decoded[0];
+	pass.pColorWords = &colorWords[0];
+	pass.pModulation = &modulation[0];
+	pass.pOut = (unsigned int*)image->data;
+
+	// Every pass reads the neighbouring blocks' results from the previous one, so they run in lockstep
+	int numThreads = options->numThreads;
+	ParallelFor(pass.blocksY, numThreads, ComputeEndpointRows, &pass);
+	ParallelFor(pass.blocksY, numThreads, QuantizeEndpointRows, &pass);
+	ParallelFor(pass.blocksY, numThreads, ChooseModulationRows, &pass);
+	for (int i = 0; i < PVRTC_REFINE_PASSES; i++)
+	{
+		for (pass.refinePhase = 0; pass.refinePhase < 4; pass.refinePhase++)
+		{
+			ParallelFor(pass.blocksY, numThreads, RefineEndpointRows, &pass);
+			ParallelFor(pass.blocksY, numThreads, QuantizeEndpointRows, &pass);
+		}
+		ParallelFor(pass.blocksY, numThreads, ChooseModulationRows, &pass);
+	}
+	ParallelFor(pass.blocksY, numThreads, PackBlockRows, &pass);
+
+	return true;
+}
+
+void FreePVRTCImage(PVRTCImage* image)
+{
+	delete[] image->data;
+	memset(image, 0, sizeof(PVRTCImage));
+}
+
+void UploadPVRTCImage(const PVRTCImage* image, int level)
+{
+	glCompressedTexImage2D(GL_TEXTURE_2D, level, image->glFormat, image->width, image->height, 0, (GLsizei)image->size, image->data);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Cooking and loading
+// ------------------------------------------------------------------------------------------------
+
+bool CookPVRTC(const char* szTGAFile, const char* szPVRFile, const PVRTCOptions* options)
+{
+	PVRTCOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultPVRTCOptions(&defaults);
+		options = &defaults;
+	}
+
+	int width, height, bpp;
+	char* pixels = LoadTGA(szTGAFile, &width, &height, &bpp);
+	if (pixels == NULL)
+		return false;
+
+	MipChain chain;
+	if (options->generateMips)
+	{
+		MipOptions mipOptions;
+		GetDefaultMipOptions(&mipOptions);
+		mipOptions.numThreads = options->numThreads;
+		bool built = BuildMipChain(pixels, width, height, bpp, &mipOptions, &chain);
+		delete[] pixels;
+		if (!built)
+			return false;
+	}
+	else
+	{
+		memset(&chain, 0, sizeof(MipChain));
+		chain.bpp = bpp;
+		chain.numLevels = 1;
+		chain.levels[0].width = width;
+		chain.levels[0].height = height;
+		chain.levels[0].pixels = pixels;
+		chain.levels[0].size = (size_t)width * height * bpp / 8;
+		chain.storage = pixels;
+	}
+
+	FILE* pf;
+	if (fopen_s(&pf, szPVRFile, "wb") != 0)
+	{
+		FreeMipChain(&chain);
+		return false;
+	}
+
+	PVR_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.version = PVR_VERSION;
+	if (options->bitsPerPixel == 2)
+		header.pixelFormat = bpp == 32 ? PVR_FORMAT_PVRTC_2BPP_RGBA : PVR_FORMAT_PVRTC_2BPP_RGB;
+	else
+		header.pixelFormat = bpp == 32 ? PVR_FORMAT_PVRTC_4BPP_RGBA : PVR_FORMAT_PVRTC_4BPP_RGB;
+	header.width = width;
+	header.height = height;
+	header.depth = 1;
+	header.numSurfaces = 1;
+	header.numFaces = 1;
+	header.mipMapCount = chain.numLevels;
+	bool ok = fwrite(&header, sizeof(header), 1, pf) == 1;
+
+	for (int i = 0; i < chain.numLevels && ok; i++)
+	{
+		const MipLevel& level = chain.levels[i];
+		PVRTCImage image;
+		ok = CompressPVRTC(level.pixels, level.width, level.height, bpp, options, &image)
+			&& fwrite(image.data, 1, image.size, pf) == image.size;
+		FreePVRTCImage(&image);
+	}
+
+	fclose(pf);
+	FreeMipChain(&chain);
+	if (!ok)
+		remove(szPVRFile);
+	return ok;
+}
+
+bool LoadPVRTC(const char* szPVRFile, int* width, int* height)
+{
+	FileMap file;
+	if (!MapFile(szPVRFile, &file))
+		return false;
+
+	PVR_HEADER header;
+	if (file.size < sizeof(header))
+	{
+		UnmapFile(&file);
+		return false;
+	}
+	memcpy(&header, file.data, sizeof(header));
+
+	static const GLenum glFormats[] =
+	{
+		GL_COMPRESSED_RGB_PVRTC_2BPPV1_IMG, GL_COMPRESSED_RGBA_PVRTC_2BPPV1_IMG,
+		GL_COMPRESSED_RGB_PVRTC_4BPPV1_IMG, GL_COMPRESSED_RGBA_PVRTC_4BPPV1_IMG,
+	};
+	if (header.version != PVR_VERSION || header.pixelFormat > PVR_FORMAT_PVRTC_4BPP_RGBA ||
+		header.depth > 1 || header.numSurfaces > 1 || header.numFaces > 1 || header.mipMapCount == 0 || header.mipMapCount > 32)
+	{
+		UnmapFile(&file);
+		return false;
+	}
+
+	int bitsPerPixel = header.pixelFormat <= PVR_FORMAT_PVRTC_2BPP_RGBA ? 2 : 4;
+	GLenum glFormat = glFormats[header.pixelFormat];
+	size_t dataStart = sizeof(header) + header.metaDataSize;
+
+	// A truncated file fails as a whole, like OpenKTX: uploading only the levels that fit would
+	// leave a mipmap-incomplete texture, which GLES2 samples as black
+	size_t dataSize = 0;
+	for (unsigned int i = 0; i < header.mipMapCount; i++)
+	{
+		int w = header.width >> i > 0 ? header.width >> i : 1;
+		int h = header.height >> i > 0 ? header.height >> i : 1;
+		dataSize += GetPVRTCDataSize(bitsPerPixel, w, h);
+	}
+	if (dataStart > file.size || file.size - dataStart < dataSize)
+	{
+		Debug("LoadPVRTC: %s is truncated\n", szPVRFile);
+		UnmapFile(&file);
+		return false;
+	}
+
+	// The levels are used straight from the mapping, there is nothing to convert
+	size_t offset = dataStart;
+	for (unsigned int i = 0; i < header.mipMapCount; i++)
+	{
+		int w = header.width >> i > 0 ? header.width >> i : 1;
+		int h = header.height >> i > 0 ? header.height >> i : 1;
+		size_t size = GetPVRTCDataSize(bitsPerPixel, w, h);
+		glCompressedTexImage2D(GL_TEXTURE_2D, i, glFormat, w, h, 0, (GLsizei)size, file.data + offset);
+		offset += size;
+	}
+	UnmapFile(&file);
+
+	// Mipmapped filtering also needs the chain to go all the way down to 1x1
+	unsigned int fullChain = 1;
+	while ((header.width >> fullChain) > 0 || (header.height >> fullChain) > 0)
+		fullChain++;
+	bool hasMips = header.mipMapCount > 1 && header.mipMapCount == fullChain;
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, hasMips ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	*width = header.width;
+	*height = header.height;
+	return true;
+}
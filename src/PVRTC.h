@@ -0,0 +1,42 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include "GLES2/gl2ext.h"
+#include <stddef.h>
+
+struct PVRTCOptions
+{
+	int			bitsPerPixel;	// 4 (4x4 blocks) or 2 (8x4 blocks)
+	bool		generateMips;	// CookPVRTC also writes every mip level down to 1x1
+	int			numThreads;		// block rows are split over this many threads, 0 = one per hardware thread
+};
+
+struct PVRTCImage
+{
+	int			width;
+	int			height;
+	int			bitsPerPixel;
+	GLenum		glFormat;		// GL_COMPRESSED_RGB(A)_PVRTC_xBPPV1_IMG
+	char*		data;			// 64-bit words in Morton order
+	size_t		size;
+};
+
+void GetDefaultPVRTCOptions(PVRTCOptions* options);
+
+// Bytes of compressed data; PVRTC rounds every level up to at least 2x2 blocks
+size_t GetPVRTCDataSize(int bitsPerPixel, int width, int height);
+
+// Compresses an RGB/RGBA image as returned by LoadTGA (tightly packed rows). PVRTC1 needs power-of-two
+// sizes, other sizes fail. options may be NULL for the defaults (4bpp, no mips, all cores).
+bool CompressPVRTC(const char* pixels, int width, int height, int bpp, const PVRTCOptions* options, PVRTCImage* image);
+
+void FreePVRTCImage(PVRTCImage* image);
+
+// Uploads to the given level of the texture bound to GL_TEXTURE_2D
+void UploadPVRTCImage(const PVRTCImage* image, int level);
+
+// Asset cooking: reads a TGA and writes a PVR v3 container, the format PVRTexTool and the PowerVR SDK use
+bool CookPVRTC(const char* szTGAFile, const char* szPVRFile, const PVRTCOptions* options);
+
+// Maps a PVR v3 file holding PVRTC data and uploads every level in it to the texture bound to GL_TEXTURE_2D
+bool LoadPVRTC(const char* szPVRFile, int* width, int* height);
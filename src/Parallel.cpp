@@ -0,0 +1,41 @@
+#include "Parallel.h"
+
+#include <thread>
+#include <vector>
+
+int GetHardwareThreadCount()
+{
+	unsigned int n = std::thread::hardware_concurrency();
+	return n > 0 ? (int)n : 1;
+}
+
+void ParallelFor(int count, int numThreads, ParallelRangeFunc func, void* userData)
+{
+	if (count <= 0)
+		return;
+
+	if (numThreads <= 0)
+		numThreads = GetHardwareThreadCount();
+	if (numThreads > count)
+		numThreads = count;
+
+	if (numThreads == 1)
+	{
+		func(userData, 0, count);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	threads.reserve(numThreads - 1);
+	for (int i = 1; i < numThreads; i++)
+	{
+		int begin = (int)((long long)count * i / numThreads);
+		int end = (int)((long long)count * (i + 1) / numThreads);
+		threads.push_back(std::thread(func, userData, begin, end));
+	}
+
+	func(userData, 0, (int)((long long)count / numThreads));
+
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
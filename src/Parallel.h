@@ -0,0 +1,12 @@
+#pragma once
+
+// Processes the index range [begin, end)
+typedef void (*ParallelRangeFunc)(void* userData, int begin, int end);
+
+// Number of hardware threads, at least 1
+int GetHardwareThreadCount();
+
+// Splits [0, count) into numThreads contiguous ranges and processes them concurrently. The calling
+// thread takes the first range; the call returns once every range is done. numThreads <= 0 uses
+// GetHardwareThreadCount().
+void ParallelFor(int count, int numThreads, ParallelRangeFunc func, void* userData);
@@ -0,0 +1,319 @@
+#include "PixelPack.h"
+#include "Parallel.h"
+
+#include <string.h>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#define PACK_SSE 1
+#endif
+
+// Below this many pixels the thread start-up costs more than the conversion
+const int MIN_PARALLEL_PACK_PIXELS = 256 * 256;
+
+// 4x4 Bayer matrix, each entry is the rank of that position in the dither pattern
+static const int BAYER_4X4[4][4] =
+{
+	{  0,  8,  2, 10 },
+	{ 12,  4, 14,  6 },
+	{  3, 11,  1,  9 },
+	{ 15,  7, 13,  5 },
+};
+
+// Bias added before the truncating divide: half a step rounds to nearest
+const int ROUND_THRESHOLD = 127;
+
+// Channel layout of a packed format, red first
+struct PackLayout
+{
+	GLenum	glFormat;
+	GLenum	glType;
+	int		max[4];		// largest quantized value per channel, 0 = channel dropped
+	int		shift[4];	// bit position of each channel in the 16-bit word
+};
+
+static const PackLayout LAYOUT_RGB565	= { GL_RGB,  GL_UNSIGNED_SHORT_5_6_5,   { 31, 63, 31,  0 }, { 11, 5, 0, 0 } };
+static const PackLayout LAYOUT_RGBA4444	= { GL_RGBA, GL_UNSIGNED_SHORT_4_4_4_4, { 15, 15, 15, 15 }, { 12, 8, 4, 0 } };
+static const PackLayout LAYOUT_RGBA5551	= { GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, { 31, 31, 31,  1 }, { 11, 6, 1, 0 } };
+
+static const PackLayout* GetPackLayout(PackFormat format, int bpp)
+{
+	switch (format)
+	{
+	case PACK_FORMAT_RGB565:	return &LAYOUT_RGB565;
+	case PACK_FORMAT_RGBA4444:	return &LAYOUT_RGBA4444;
+	case PACK_FORMAT_RGBA5551:	return &LAYOUT_RGBA5551;
+	default:					return bpp == 32 ? &LAYOUT_RGBA4444 : &LAYOUT_RGB565;
+	}
+}
+
+// floor(x / 255) for 0 <= x < 65790, which covers 255 * 63 + 255
+static inline int Div255(int x)
+{
+	x += 1;
+	return (x + (x >> 8)) >> 8;
+}
+
+// Quantized value back to 8 bits the way the GPU expands it
+static inline int Expand(int q, int max)
+{
+	return (q * 255 + max / 2) / max;
+}
+
+// ------------------------------------------------------------------------------------------------
+// Rounding and ordered dithering, split into row ranges for ParallelFor
+// ------------------------------------------------------------------------------------------------
+
+struct PackJob
+{
+	const unsigned char*	pSrc;
+	unsigned short*			pDst;
+	int						width;
+	int						height;
+	int						pixelSize;
+	DitherMode				dither;
+	const PackLayout*		pLayout;
+};
+
+// Bias per pixel (x & 3) and channel for row y. Ordered dithering spreads the bias evenly over
+// (0, 255) so the fraction lost to quantization turns into a fixed pattern. A 1-bit alpha channel
+// is always rounded, since a dithered cut-out edge looks like noise.
+static void GetRowThresholds(const PackJob* pJob, int y, int thresholds[4][4])
+{
+	for (int x = 0; x < 4; x++)
+	{
+		int t = pJob->dither == DITHER_ORDERED ? (2 * BAYER_4X4[y & 3][x] + 1) * 255 / 32 : ROUND_THRESHOLD;
+		for (int c = 0; c < 4; c++)
+			thresholds[x][c] = pJob->pLayout->max[c] == 1 ? ROUND_THRESHOLD : t;
+	}
+}
+
+static void PackRowScalar(unsigned short* pDst, const unsigned char* pSrc, int begin, int end, int pixelSize,
+	const PackLayout* pLayout, const int thresholds[4][4])
+{
+	pSrc += begin * pixelSize;
+	for (int x = begin; x < end; x++)
+	{
+		int rgba[4] = { pSrc[0], pSrc[1], pSrc[2], pixelSize == 4 ? pSrc[3] : 255 };
+		unsigned int packed = 0;
+		for (int c = 0; c < 4; c++)
+			packed |= Div255(rgba[c] * pLayout->max[c] + thresholds[x & 3][c]) << pLayout->shift[c];
+		pDst[x] = (unsigned short)packed;
+		pSrc += pixelSize;
+	}
+}
+
+#if PACK_SSE
+
+// 8 RGBA pixels per iteration. Each pixel becomes four 16-bit lanes that are scaled, biased and
+// divided by 255 together; pmaddwd then shifts the channels into place and sums them in pairs.
+static int PackRowSSE2(unsigned short* pDst, const unsigned char* pSrc, int width, const PackLayout* pLayout, const int thresholds[4][4])
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi16(1);
+	const __m128i max = _mm_setr_epi16(
+		(short)pLayout->max[0], (short)pLayout->max[1], (short)pLayout->max[2], (short)pLayout->max[3],
+		(short)pLayout->max[0], (short)pLayout->max[1], (short)pLayout->max[2], (short)pLayout->max[3]);
+	const __m128i scale = _mm_setr_epi16(
+		(short)(1 << pLayout->shift[0]), (short)(1 << pLayout->shift[1]), (short)(1 << pLayout->shift[2]), (short)(1 << pLayout->shift[3]),
+		(short)(1 << pLayout->shift[0]), (short)(1 << pLayout->shift[1]), (short)(1 << pLayout->shift[2]), (short)(1 << pLayout->shift[3]));
+	const __m128i bias01 = _mm_setr_epi16(
+		(short)thresholds[0][0], (short)thresholds[0][1], (short)thresholds[0][2], (short)thresholds[0][3],
+		(short)thresholds[1][0], (short)thresholds[1][1], (short)thresholds[1][2], (short)thresholds[1][3]);
+	const __m128i bias23 = _mm_setr_epi16(
+		(short)thresholds[2][0], (short)thresholds[2][1], (short)thresholds[2][2], (short)thresholds[2][3],
+		(short)thresholds[3][0], (short)thresholds[3][1], (short)thresholds[3][2], (short)thresholds[3][3]);
+	const __m128i signFlip32 = _mm_set1_epi32(0x8000);
+	const __m128i signFlip16 = _mm_set1_epi16((short)0x8000);
+
+	int x = 0;
+	for (; x + 8 <= width; x += 8)
+	{
+		__m128i packed[2];
+		for (int half = 0; half < 2; half++)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(pSrc + (x + half * 4) * 4));
+			__m128i pairs[2] = { _mm_unpacklo_epi8(v, zero), _mm_unpackhi_epi8(v, zero) };
+			__m128i sums[2];
+			for (int i = 0; i < 2; i++)
+			{
+				__m128i q = _mm_add_epi16(_mm_mullo_epi16(pairs[i], max), i == 0 ? bias01 : bias23);
+				q = _mm_add_epi16(q, one);
+				q = _mm_srli_epi16(_mm_add_epi16(q, _mm_srli_epi16(q, 8)), 8);
+				__m128i m = _mm_madd_epi16(q, scale);
+				// Lanes 0 and 2 now hold the two packed pixels
+				m = _mm_add_epi32(m, _mm_srli_epi64(m, 32));
+				sums[i] = _mm_shuffle_epi32(m, _MM_SHUFFLE(3, 3, 2, 0));
+			}
+			packed[half] = _mm_unpacklo_epi64(sums[0], sums[1]);
+		}
+		// packs_epi32 saturates signed values, so move the 16-bit range down and back up
+		__m128i result = _mm_packs_epi32(_mm_sub_epi32(packed[0], signFlip32), _mm_sub_epi32(packed[1], signFlip32));
+		_mm_storeu_si128((__m128i*)(pDst + x), _mm_xor_si128(result, signFlip16));
+	}
+	return x;
+}
+
+#endif
+
+static void PackRows(void* pUserData, int rowBegin, int rowEnd)
+{
+	const PackJob* pJob = (const PackJob*)pUserData;
+	std::vector<unsigned char> expanded;
+
+	for (int y = rowBegin; y < rowEnd; y++)
+	{
+		const unsigned char* pSrcRow = pJob->pSrc + (size_t)y * pJob->width * pJob->pixelSize;
+		unsigned short* pDstRow = pJob->pDst + (size_t)y * pJob->width;
+		int thresholds[4][4];
+		GetRowThresholds(pJob, y, thresholds);
+
+		int done = 0;
+#if PACK_SSE
+		if (pJob->pixelSize == 3)
+		{
+			// The kernel wants 4 byte pixels; RGB rows are widened with opaque alpha first
+			expanded.resize((size_t)pJob->width * 4);
+			for (int x = 0; x < pJob->width; x++)
+			{
+				expanded[x * 4 + 0] = pSrcRow[x * 3 + 0];
+				expanded[x * 4 + 1] = pSrcRow[x * 3 + 1];
+				expanded[x * 4 + 2] = pSrcRow[x * 3 + 2];
+				expanded[x * 4 + 3] = 255;
+			}
+			done = PackRowSSE2(pDstRow, &expanded[0], pJob->width, pJob->pLayout, thresholds);
+		}
+		else
+		{
+			done = PackRowSSE2(pDstRow, pSrcRow, pJob->width, pJob->pLayout, thresholds);
+		}
+#endif
+		PackRowScalar(pDstRow, pSrcRow, done, pJob->width, pJob->pixelSize, pJob->pLayout, thresholds);
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// Floyd-Steinberg error diffusion
+// ------------------------------------------------------------------------------------------------
+
+// Every pixel depends on the error left by the previous one, so the image is processed in order on
+// the calling thread. Rows alternate direction (serpentine) to avoid diagonal worms. Errors are kept
+// in 1/16 units with one guard pixel at each end of the row.
+static void DiffuseRows(const PackJob* pJob)
+{
+	const PackLayout* pLayout = pJob->pLayout;
+	int w = pJob->width;
+	std::vector<int> errors[2];
+	errors[0].assign((size_t)(w + 2) * 4, 0);
+	errors[1].assign((size_t)(w + 2) * 4, 0);
+
+	for (int y = 0; y < pJob->height; y++)
+	{
+		int* pCur = &errors[y & 1][0];
+		int* pNext = &errors[(y + 1) & 1][0];
+		memset(pNext, 0, (size_t)(w + 2) * 4 * sizeof(int));
+
+		const unsigned char* pSrcRow = pJob->pSrc + (size_t)y * w * pJob->pixelSize;
+		unsigned short* pDstRow = pJob->pDst + (size_t)y * w;
+		int dir = (y & 1) ? -1 : 1;
+
+		for (int i = 0; i < w; i++)
+		{
+			int x = dir > 0 ? i : w - 1 - i;
+			const unsigned char* pIn = pSrcRow + x * pJob->pixelSize;
+			int rgba[4] = { pIn[0], pIn[1], pIn[2], pJob->pixelSize == 4 ? pIn[3] : 255 };
+			unsigned int packed = 0;
+
+			for (int c = 0; c < 4; c++)
+			{
+				int max = pLayout->max[c];
+				if (max == 0)
+					continue;
+				if (max == 1)
+				{
+					packed |= Div255(rgba[c] + ROUND_THRESHOLD) << pLayout->shift[c];
+					continue;
+				}
+
+				int e = pCur[(x + 1) * 4 + c];
+				int v = rgba[c] + (e >= 0 ? (e + 8) / 16 : -((8 - e) / 16));
+				v = v < 0 ? 0 : (v > 255 ? 255 : v);
+				int q = Div255(v * max + ROUND_THRESHOLD);
+				packed |= q << pLayout->shift[c];
+
+				int err = v - Expand(q, max);
+				pCur[(x + 1 + dir) * 4 + c] += err * 7;
+				pNext[(x + 1 - dir) * 4 + c] += err * 3;
+				pNext[(x + 1) * 4 + c] += err * 5;
+				pNext[(x + 1 + dir) * 4 + c] += err;
+			}
+			pDstRow[x] = (unsigned short)packed;
+		}
+	}
+}
+
+// ------------------------------------------------------------------------------------------------
+// Public interface
+// ------------------------------------------------------------------------------------------------
+
+void GetDefaultPackOptions(PackOptions* options)
+{
+	options->format = PACK_FORMAT_AUTO;
+	options->dither = DITHER_ORDERED;
+	options->numThreads = 0;
+}
+
+bool PackPixels(const char* pixels, int width, int height, int bpp, const PackOptions* options, PackedImage* image)
+{
+	memset(image, 0, sizeof(PackedImage));
+	if (pixels == NULL || width <= 0 || height <= 0 || (bpp != 24 && bpp != 32))
+		return false;
+
+	PackOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultPackOptions(&defaults);
+		options = &defaults;
+	}
+
+	const PackLayout* pLayout = GetPackLayout(options->format, bpp);
+	image->width = width;
+	image->height = height;
+	image->glFormat = pLayout->glFormat;
+	image->glType = pLayout->glType;
+	image->size = (size_t)width * height * sizeof(unsigned short);
+	image->pixels = new unsigned short[(size_t)width * height];
+
+	PackJob job;
+	job.pSrc = (const unsigned char*)pixels;
+	job.pDst = image->pixels;
+	job.width = width;
+	job.height = height;
+	job.pixelSize = bpp / 8;
+	job.dither = options->dither;
+	job.pLayout = pLayout;
+
+	if (options->dither == DITHER_ERROR_DIFFUSION)
+	{
+		DiffuseRows(&job);
+	}
+	else
+	{
+		int numThreads = width * height < MIN_PARALLEL_PACK_PIXELS ? 1 : options->numThreads;
+		ParallelFor(height, numThreads, PackRows, &job);
+	}
+	return true;
+}
+
+void FreePackedImage(PackedImage* image)
+{
+	delete[] image->pixels;
+	memset(image, 0, sizeof(PackedImage));
+}
+
+void UploadPackedImage(const PackedImage* image, int level)
+{
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+	glTexImage2D(GL_TEXTURE_2D, level, image->glFormat, image->width, image->height, 0, image->glFormat, image->glType, image->pixels);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include <stddef.h>
+
+enum PackFormat
+{
+	PACK_FORMAT_AUTO,			// RGB565 for RGB sources, RGBA4444 for RGBA sources
+	PACK_FORMAT_RGB565,			// alpha is dropped
+	PACK_FORMAT_RGBA4444,
+	PACK_FORMAT_RGBA5551,		// 1 bit alpha, for cut-out textures
+};
+
+enum DitherMode
+{
+	DITHER_NONE,				// round to nearest
+	DITHER_ORDERED,				// 4x4 Bayer matrix, stable under animation and mip filtering
+	DITHER_ERROR_DIFFUSION,		// Floyd-Steinberg, best gradients but runs on one thread
+};
+
+struct PackOptions
+{
+	PackFormat	format;
+	DitherMode	dither;
+	int			numThreads;		// rows are split over this many threads, 0 = one per hardware thread
+};
+
+struct PackedImage
+{
+	int				width;
+	int				height;
+	GLenum			glFormat;	// GL_RGB or GL_RGBA
+	GLenum			glType;		// GL_UNSIGNED_SHORT_5_6_5, _4_4_4_4 or _5_5_5_1
+	unsigned short*	pixels;		// tightly packed rows, first component in the top bits
+	size_t			size;
+};
+
+void GetDefaultPackOptions(PackOptions* options);
+
+// Converts an RGB/RGBA image as returned by LoadTGA to 16 bits per pixel, halving its VRAM and
+// sampling bandwidth. options may be NULL for the defaults (auto format, ordered dither, all cores).
+bool PackPixels(const char* pixels, int width, int height, int bpp, const PackOptions* options, PackedImage* image);
+
+void FreePackedImage(PackedImage* image);
+
+// Uploads to the given level of the texture bound to GL_TEXTURE_2D
+void UploadPackedImage(const PackedImage* image, int level);
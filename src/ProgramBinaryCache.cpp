@@ -0,0 +1,261 @@
+#include "ProgramBinaryCache.h"
+#include "FileMap.h"
+#include "GLES2/gl2ext.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+// Bump when the file layout changes; files of older versions are left in their own directory
+const int PROGRAM_BINARY_VERSION = 1;
+const unsigned int PROGRAM_BINARY_MAGIC = 0x4E494250;	// "PBIN"
+
+struct PROGRAM_BINARY_HEADER
+{
+	unsigned int	magic;
+	unsigned int	version;
+	ShaderHash		sourceHash;
+	ShaderHash		driverHash;		// GL_RENDERER + GL_VERSION of the driver that produced the binary
+	ShaderHash		binaryHash;		// catches truncated or corrupted files before the driver sees them
+	unsigned int	binaryFormat;
+	unsigned int	binaryLength;
+};
+
+struct ProgramBinaryCache
+{
+	bool							enabled;
+	char							directory[260];
+	ShaderHash						driverHash;
+	PFNGLGETPROGRAMBINARYOESPROC	getProgramBinary;
+	PFNGLPROGRAMBINARYOESPROC		programBinary;
+};
+
+static ProgramBinaryCache s_binaryCache;
+
+static void MakeDirectory(const char* szPath)
+{
+	// Fails harmlessly when the directory already exists
+#if defined(_WIN32)
+	_mkdir(szPath);
+#else
+	mkdir(szPath, 0755);
+#endif
+}
+
+static bool HasExtension(const char* szName)
+{
+	const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+	if (extensions == NULL)
+		return false;
+
+	size_t length = strlen(szName);
+	for (const char* p = strstr(extensions, szName); p != NULL; p = strstr(p + length, szName))
+	{
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == 0))
+			return true;
+	}
+	return false;
+}
+
+static void GetBinaryFileName(ShaderHash hash, char* szFileName, size_t size)
+{
+	snprintf(szFileName, size, "%s/%016llx.bin", s_binaryCache.directory, hash);
+}
+
+bool InitProgramBinaryCache(const char* szDirectory)
+{
+	memset(&s_binaryCache, 0, sizeof(s_binaryCache));
+
+	GLint numFormats = 0;
+	if (HasExtension("GL_OES_get_program_binary"))
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &numFormats);
+	if (numFormats <= 0)
+	{
+		Debug("Program binary cache disabled: the driver cannot return program binaries\n");
+		return false;
+	}
+
+	s_binaryCache.getProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+	s_binaryCache.programBinary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+	if (s_binaryCache.getProgramBinary == NULL || s_binaryCache.programBinary == NULL)
+		return false;
+
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+	s_binaryCache.driverHash = HashShaderSources(renderer ? renderer : "", version ? version : "");
+
+	MakeDirectory(szDirectory);
+	snprintf(s_binaryCache.directory, sizeof(s_binaryCache.directory), "%s/v%d", szDirectory, PROGRAM_BINARY_VERSION);
+	MakeDirectory(s_binaryCache.directory);
+
+	s_binaryCache.enabled = true;
+	return true;
+}
+
+void ShutdownProgramBinaryCache()
+{
+	memset(&s_binaryCache, 0, sizeof(s_binaryCache));
+}
+
+bool IsProgramBinaryCacheEnabled()
+{
+	return s_binaryCache.enabled;
+}
+
+GLuint LoadProgramBinary(ShaderHash hash)
+{
+	if (!s_binaryCache.enabled)
+		return 0;
+
+	char szFileName[300];
+	GetBinaryFileName(hash, szFileName, sizeof(szFileName));
+
+	FileMap file;
+	if (!MapFile(szFileName, &file))
+		return 0;
+
+	PROGRAM_BINARY_HEADER header;
+	const char* binary = file.data + sizeof(header);
+	bool valid = file.size >= sizeof(header);
+	if (valid)
+	{
+		memcpy(&header, file.data, sizeof(header));
+		valid = header.magic == PROGRAM_BINARY_MAGIC && header.version == PROGRAM_BINARY_VERSION &&
+			header.sourceHash == hash && header.driverHash == s_binaryCache.driverHash &&
+			file.size - sizeof(header) == header.binaryLength &&
+			header.binaryHash == HashShaderBytes(SHADER_HASH_SEED, binary, header.binaryLength);
+	}
+
+	GLuint program = 0;
+	if (valid)
+	{
+		// The driver may still refuse a binary it produced itself, e.g. after a driver update that
+		// kept the version string; that shows up as a failed link
+		program = glCreateProgram();
+		s_binaryCache.programBinary(program, header.binaryFormat, binary, header.binaryLength);
+
+		GLint linked = 0;
+		glGetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (!linked)
+		{
+			glDeleteProgram(program);
+			program = 0;
+		}
+	}
+	UnmapFile(&file);
+
+	if (program == 0)
+	{
+		Debug("Program binary %s is stale, recompiling\n", szFileName);
+		remove(szFileName);
+	}
+	return program;
+}
+
+bool SaveProgramBinary(ShaderHash hash, GLuint program)
+{
+	if (!s_binaryCache.enabled)
+		return false;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+	if (length <= 0)
+		return false;
+
+	std::vector<char> binary(length);
+	GLsizei written = 0;
+	GLenum format = 0;
+	s_binaryCache.getProgramBinary(program, length, &written, &format, &binary[0]);
+	if (written <= 0)
+		return false;
+
+	PROGRAM_BINARY_HEADER header;
+	memset(&header, 0, sizeof(header));
+	header.magic = PROGRAM_BINARY_MAGIC;
+	header.version = PROGRAM_BINARY_VERSION;
+	header.sourceHash = hash;
+	header.driverHash = s_binaryCache.driverHash;
+	header.binaryHash = HashShaderBytes(SHADER_HASH_SEED, &binary[0], written);
+	header.binaryFormat = format;
+	header.binaryLength = written;
+
+	// Written under a temporary name and renamed, so a crash never leaves a half written binary
+	// under the real name
+	char szFileName[300], szTempName[310];
+	GetBinaryFileName(hash, szFileName, sizeof(szFileName));
+	snprintf(szTempName, sizeof(szTempName), "%s.tmp", szFileName);
+
+	FILE* pf;
+	if (fopen_s(&pf, szTempName, "wb") != 0)
+		return false;
+	bool ok = fwrite(&header, sizeof(header), 1, pf) == 1 && fwrite(&binary[0], 1, written, pf) == (size_t)written;
+	ok = fclose(pf) == 0 && ok;
+
+	if (ok)
+	{
+		remove(szFileName);
+		ok = rename(szTempName, szFileName) == 0;
+	}
+	if (!ok)
+		remove(szTempName);
+	return ok;
+}
+
+void DeleteProgramBinary(ShaderHash hash)
+{
+	if (!s_binaryCache.enabled)
+		return;
+
+	char szFileName[300];
+	GetBinaryFileName(hash, szFileName, sizeof(szFileName));
+	remove(szFileName);
+}
+
+// ------------------------------------------------------------------------------------------------
+// Startup benchmark
+// ------------------------------------------------------------------------------------------------
+
+static double TimeAcquireProgram(const char* vsSource, const char* fsSource)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	CachedProgram cached;
+	GLint result = AcquireProgram(vsSource, fsSource, &cached);
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+	if (result == 0)
+		ReleaseProgram(cached.program);
+	return elapsed.count();
+}
+
+void BenchmarkProgramBinaryCache(const char* vsSource, const char* fsSource, int numRuns)
+{
+	if (numRuns <= 0)
+		return;
+
+	ShaderCacheStats before, after;
+	GetShaderCacheStats(&before);
+
+	ShaderHash hash = HashShaderSources(vsSource, fsSource);
+	double coldMs = 0.0, warmMs = 0.0;
+	for (int i = 0; i < numRuns; i++)
+	{
+		DeleteProgramBinary(hash);
+		coldMs += TimeAcquireProgram(vsSource, fsSource);
+		warmMs += TimeAcquireProgram(vsSource, fsSource);
+	}
+
+	GetShaderCacheStats(&after);
+	Debug("Program startup over %d runs: cold cache %.3f ms, warm cache %.3f ms (%d of %d warm runs loaded a binary)\n",
+		numRuns, coldMs / numRuns, warmMs / numRuns, after.binaryLoads - before.binaryLoads, numRuns);
+
+	// With a live Shaders instance holding the pair both runs are in-memory cache hits
+	if (after.hits != before.hits)
+		Debug("Program startup benchmark: the pair was already in use, the timings do not include compiling\n");
+}
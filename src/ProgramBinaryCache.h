@@ -0,0 +1,29 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include "ShaderCache.h"
+
+// Linked programs saved through GL_OES_get_program_binary so later launches skip the compiler.
+// Files live in <directory>/v<format version>/ and are named after the source hash; each file also
+// records a hash of GL_RENDERER and GL_VERSION, so a driver update simply misses and recompiles.
+
+// Enables the cache; call with the GL context current. Returns false, leaving the cache disabled,
+// when the driver has no GL_OES_get_program_binary or reports no binary formats.
+bool InitProgramBinaryCache(const char* szDirectory);
+
+void ShutdownProgramBinaryCache();
+
+bool IsProgramBinaryCacheEnabled();
+
+// Creates a program from the binary stored for hash. Returns 0 when there is none or when it is
+// stale, corrupt or rejected by the driver; rejected files are deleted so they are rewritten.
+GLuint LoadProgramBinary(ShaderHash hash);
+
+// Stores the binary of a successfully linked program under hash, replacing any older file
+bool SaveProgramBinary(ShaderHash hash, GLuint program);
+
+void DeleteProgramBinary(ShaderHash hash);
+
+// Times AcquireProgram for the pair with the binary file removed before every run (cold) and with
+// it present (warm), averaged over numRuns, and logs both through Debug
+void BenchmarkProgramBinaryCache(const char* vsSource, const char* fsSource, int numRuns);
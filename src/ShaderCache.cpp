@@ -0,0 +1,268 @@
+#include "ShaderCache.h"
+#include "ProgramBinaryCache.h"
+#include "UniformStaging.h"
+
+#include <string.h>
+
+#include <unordered_map>
+
+struct CacheEntry
+{
+	CachedProgram	cached;
+	int				refCount;
+	UniformStaging*	uniforms;		// created by the first GetProgramUniforms
+};
+
+struct ProgramCache
+{
+	std::unordered_map<ShaderHash, CacheEntry>	programs;
+	std::unordered_map<GLuint, ShaderHash>		programHashes;
+	int											hits;
+	int											misses;
+	int											binaryLoads;
+};
+
+// Never destroyed: global Shaders objects release their programs during static destruction
+static ProgramCache& GetProgramCache()
+{
+	static ProgramCache* s_cache = new ProgramCache();
+	return *s_cache;
+}
+
+const ShaderHash FNV_PRIME = 1099511628211ULL;
+
+ShaderHash HashShaderBytes(ShaderHash hash, const void* data, size_t size)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+ShaderHash HashShaderSources(const char* vsSource, const char* fsSource)
+{
+	// The terminator is hashed as well so that moving text from one stage to the other changes the key
+	ShaderHash hash = HashShaderBytes(SHADER_HASH_SEED, vsSource, strlen(vsSource) + 1);
+	return HashShaderBytes(hash, fsSource, strlen(fsSource) + 1);
+}
+
+GLuint CompileShader(GLenum type, const char* source)
+{
+	GLuint shader;
+	GLint compiled;
+
+	// Create the shader object
+	shader = glCreateShader(type);
+
+	if (shader == 0)
+		return 0;
+
+	glShaderSource(shader, 1, &source, NULL);
+
+	// Compile the shader
+	glCompileShader(shader);
+
+	// Check the compile status
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+	if (!compiled)
+	{
+		GLint infoLen = 0;
+
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
+
+		if (infoLen > 1)
+		{
+			char* infoLog = new char[infoLen];
+
+			glGetShaderInfoLog(shader, infoLen, NULL, infoLog);
+			Debug("Error compiling shader:\n%s\n", infoLog);
+
+			delete[] infoLog;
+		}
+
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader)
+{
+	GLuint programObject;
+	GLint linked;
+
+	// Create the program object
+	programObject = glCreateProgram();
+
+	if (programObject == 0)
+		return 0;
+
+	glAttachShader(programObject, vertexShader);
+	glAttachShader(programObject, fragmentShader);
+
+	// Link the program
+	glLinkProgram(programObject);
+
+	// Check the link status
+	glGetProgramiv(programObject, GL_LINK_STATUS, &linked);
+
+	if (!linked)
+	{
+		GLint infoLen = 0;
+
+		glGetProgramiv(programObject, GL_INFO_LOG_LENGTH, &infoLen);
+
+		if (infoLen > 1)
+		{
+			char* infoLog = new char[infoLen];
+
+			glGetProgramInfoLog(programObject, infoLen, NULL, infoLog);
+			Debug("Error linking program:\n%s\n", infoLog);
+
+			delete[] infoLog;
+		}
+
+		glDeleteProgram(programObject);
+		return 0;
+	}
+
+	return programObject;
+}
+
+bool TryAcquireProgram(ShaderHash hash, CachedProgram* result)
+{
+	ProgramCache& cache = GetProgramCache();
+	std::unordered_map<ShaderHash, CacheEntry>::iterator it = cache.programs.find(hash);
+	if (it == cache.programs.end())
+		return false;
+
+	it->second.refCount++;
+	*result = it->second.cached;
+	cache.hits++;
+	return true;
+}
+
+void AdoptProgram(const CachedProgram* program, CachedProgram* result)
+{
+	if (TryAcquireProgram(program->hash, result))
+	{
+		glDeleteProgram(program->program);
+		glDeleteShader(program->vertexShader);
+		glDeleteShader(program->fragmentShader);
+		return;
+	}
+
+	ProgramCache& cache = GetProgramCache();
+	CacheEntry entry;
+	entry.cached = *program;
+	entry.refCount = 1;
+	entry.uniforms = NULL;
+	cache.programs[program->hash] = entry;
+	cache.programHashes[program->program] = program->hash;
+	cache.misses++;
+	*result = *program;
+}
+
+GLint AcquireProgram(const char* vsSource, const char* fsSource, CachedProgram* result)
+{
+	ProgramCache& cache = GetProgramCache();
+	ShaderHash hash = HashShaderSources(vsSource, fsSource);
+
+	if (TryAcquireProgram(hash, result))
+		return 0;
+
+	cache.misses++;
+	CacheEntry entry;
+	entry.cached.hash = hash;
+	entry.refCount = 1;
+	entry.uniforms = NULL;
+
+	// A binary saved by an earlier launch skips the compiler entirely
+	entry.cached.program = LoadProgramBinary(hash);
+	if (entry.cached.program != 0)
+	{
+		entry.cached.vertexShader = 0;
+		entry.cached.fragmentShader = 0;
+		cache.binaryLoads++;
+		cache.programs[hash] = entry;
+		cache.programHashes[entry.cached.program] = hash;
+		*result = entry.cached;
+		return 0;
+	}
+
+	entry.cached.vertexShader = CompileShader(GL_VERTEX_SHADER, vsSource);
+	if (entry.cached.vertexShader == 0)
+		return -1;
+
+	entry.cached.fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fsSource);
+	if (entry.cached.fragmentShader == 0)
+	{
+		glDeleteShader(entry.cached.vertexShader);
+		return -2;
+	}
+
+	entry.cached.program = LinkProgram(entry.cached.vertexShader, entry.cached.fragmentShader);
+	if (entry.cached.program == 0)
+	{
+		glDeleteShader(entry.cached.vertexShader);
+		glDeleteShader(entry.cached.fragmentShader);
+		return -3;
+	}
+
+	if (IsProgramBinaryCacheEnabled())
+		SaveProgramBinary(hash, entry.cached.program);
+
+	cache.programs[hash] = entry;
+	cache.programHashes[entry.cached.program] = hash;
+	*result = entry.cached;
+	return 0;
+}
+
+void ReleaseProgram(GLuint program)
+{
+	ProgramCache& cache = GetProgramCache();
+	std::unordered_map<GLuint, ShaderHash>::iterator itHash = cache.programHashes.find(program);
+	if (itHash == cache.programHashes.end())
+		return;
+
+	std::unordered_map<ShaderHash, CacheEntry>::iterator it = cache.programs.find(itHash->second);
+	if (--it->second.refCount > 0)
+		return;
+
+	glDeleteProgram(it->second.cached.program);
+	glDeleteShader(it->second.cached.vertexShader);
+	glDeleteShader(it->second.cached.fragmentShader);
+	delete it->second.uniforms;
+	cache.programs.erase(it);
+	cache.programHashes.erase(itHash);
+}
+
+UniformStaging* GetProgramUniforms(GLuint program, const ShaderReflection& reflection)
+{
+	ProgramCache& cache = GetProgramCache();
+	std::unordered_map<GLuint, ShaderHash>::iterator itHash = cache.programHashes.find(program);
+	if (itHash == cache.programHashes.end())
+		return NULL;
+
+	CacheEntry& entry = cache.programs[itHash->second];
+	if (entry.uniforms == NULL)
+	{
+		entry.uniforms = new UniformStaging();
+		entry.uniforms->Init(reflection);
+	}
+	return entry.uniforms;
+}
+
+void GetShaderCacheStats(ShaderCacheStats* stats)
+{
+	ProgramCache& cache = GetProgramCache();
+	stats->programs = (int)cache.programs.size();
+	stats->hits = cache.hits;
+	stats->misses = cache.misses;
+	stats->binaryLoads = cache.binaryLoads;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include <stddef.h>
+
+class ShaderReflection;
+class UniformStaging;
+
+typedef unsigned long long ShaderHash;
+
+const ShaderHash SHADER_HASH_SEED = 14695981039346656037ULL;
+
+// A linked program and the shader objects it was built from, all owned by the cache
+struct CachedProgram
+{
+	GLuint		program;
+	GLuint		vertexShader;
+	GLuint		fragmentShader;
+	ShaderHash	hash;
+};
+
+struct ShaderCacheStats
+{
+	int			programs;		// live programs in the cache
+	int			hits;			// AcquireProgram calls that skipped compiling
+	int			misses;			// AcquireProgram calls that had to create the program
+	int			binaryLoads;	// misses served from the on-disk program binary cache
+};
+
+// Continues a 64-bit FNV-1a hash over size bytes; start from SHADER_HASH_SEED
+ShaderHash HashShaderBytes(ShaderHash hash, const void* data, size_t size);
+
+// Hash of both sources, the key of the program cache
+ShaderHash HashShaderSources(const char* vsSource, const char* fsSource);
+
+// Compiles one stage and logs the info log on failure. Returns 0 on failure.
+GLuint CompileShader(GLenum type, const char* source);
+
+// Links the two stages and logs the info log on failure. Returns 0 on failure.
+GLuint LinkProgram(GLuint vertexShader, GLuint fragmentShader);
+
+// Process-wide program cache. Returns the program for this VS/FS pair with its reference count
+// raised, creating it only the first time the pair is seen: from the program binary cache when it
+// is enabled and holds the pair, otherwise by compiling and linking. The result is 0 on success,
+// -1 / -2 when the vertex / fragment shader does not compile and -3 when linking fails.
+// Every successful call must be matched by ReleaseProgram. GL thread only.
+GLint AcquireProgram(const char* vsSource, const char* fsSource, CachedProgram* result);
+
+// Looks a hash up without building anything; raises the reference count on a hit
+bool TryAcquireProgram(ShaderHash hash, CachedProgram* result);
+
+// Hands a program built elsewhere (e.g. on a compile thread) to the cache with one reference. If the
+// same sources were cached in the meantime, the new program is deleted and the cached one returned.
+void AdoptProgram(const CachedProgram* program, CachedProgram* result);
+
+// Drops one reference; the program and its shaders are deleted with the last one. Programs loaded
+// from a binary have no shader objects, vertexShader and fragmentShader are 0 for them.
+void ReleaseProgram(GLuint program);
+
+// The uniform shadow of a cached program, shared by everyone holding it since uniform values live
+// in the program object. Built from reflection on the first call; freed with the program.
+UniformStaging* GetProgramUniforms(GLuint program, const ShaderReflection& reflection);
+
+void GetShaderCacheStats(ShaderCacheStats* stats);
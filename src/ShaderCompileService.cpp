@@ -0,0 +1,330 @@
+#include "ShaderCompileService.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderPreprocessor.h"
+
+#include <chrono>
+#include <string.h>
+
+ShaderCompileService::ShaderCompileService()
+	: display(EGL_NO_DISPLAY)
+	, fallbackProgram(0)
+	, pendingCount(0)
+	, stopping(false)
+{
+}
+
+ShaderCompileService::~ShaderCompileService()
+{
+	Shutdown();
+}
+
+bool ShaderCompileService::Init(SysContext* sysCtx, int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = 1;
+
+	display = sysCtx->eglDisplay;
+
+	// A pbuffer capable config for the 1x1 surfaces; without one the workers go surfaceless
+	const EGLint configAttributes[] =
+	{
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint configsReturned;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configsReturned) || configsReturned != 1)
+		config = sysCtx->eglConfig;
+
+	const EGLint contextAttributes[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+	const EGLint pbufferAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+	EGLContext renderContext = eglGetCurrentContext();
+	EGLSurface renderDraw = eglGetCurrentSurface(EGL_DRAW);
+	EGLSurface renderRead = eglGetCurrentSurface(EGL_READ);
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		Worker worker;
+		worker.context = eglCreateContext(display, config, sysCtx->eglContext, contextAttributes);
+		if (worker.context == EGL_NO_CONTEXT)
+			break;
+
+		worker.surface = eglCreatePbufferSurface(display, config, pbufferAttributes);
+
+		// Try the pair out here, where a failure can still fall back to compiling synchronously
+		bool usable = eglMakeCurrent(display, worker.surface, worker.surface, worker.context) == EGL_TRUE;
+		eglMakeCurrent(display, renderDraw, renderRead, renderContext);
+		if (!usable)
+		{
+			if (worker.surface != EGL_NO_SURFACE)
+				eglDestroySurface(display, worker.surface);
+			eglDestroyContext(display, worker.context);
+			break;
+		}
+
+		workerContexts.push_back(worker);
+	}
+
+	if (workerContexts.empty())
+	{
+		Debug("ShaderCompileService: no shared EGL context (0x%x), compiling on the render thread\n", eglGetError());
+		return false;
+	}
+
+	stopping = false;
+	for (size_t i = 0; i < workerContexts.size(); i++)
+		workers.push_back(std::thread(&ShaderCompileService::WorkerMain, this, (int)i));
+	return true;
+}
+
+void ShaderCompileService::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(requestMutex);
+		stopping = true;
+		requests.clear();
+	}
+	requestCond.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+
+	// Unclaimed results were never handed to the program cache
+	Result result;
+	while (results.Pop(result))
+	{
+		glDeleteProgram(result.program.program);
+		glDeleteShader(result.program.vertexShader);
+		glDeleteShader(result.program.fragmentShader);
+	}
+
+	for (size_t i = 0; i < workerContexts.size(); i++)
+	{
+		if (workerContexts[i].surface != EGL_NO_SURFACE)
+			eglDestroySurface(display, workerContexts[i].surface);
+		eglDestroyContext(display, workerContexts[i].context);
+	}
+	workerContexts.clear();
+
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (slots[i].state == SLOT_READY)
+			ReleaseProgram(slots[i].program.program);
+	}
+	slots.clear();
+	freeSlots.clear();
+	pendingCount = 0;
+}
+
+ShaderCompileHandle ShaderCompileService::AllocSlot()
+{
+	ShaderCompileHandle handle;
+	if (!freeSlots.empty())
+	{
+		handle = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		handle = (ShaderCompileHandle)slots.size();
+		slots.push_back(Slot());
+	}
+
+	slots[handle].state = SLOT_PENDING;
+	memset(&slots[handle].program, 0, sizeof(CachedProgram));
+	return handle;
+}
+
+ShaderCompileHandle ShaderCompileService::Compile(const char* fileVertexShader, const char* fileFragmentShader, const char* const* defines, int numDefines)
+{
+	ShaderSource vsSource, fsSource;
+	if (!PreprocessShader(fileVertexShader, defines, numDefines, &vsSource) ||
+		!PreprocessShader(fileFragmentShader, defines, numDefines, &fsSource))
+		return INVALID_SHADER_COMPILE_HANDLE;
+
+	ShaderCompileHandle handle = AllocSlot();
+	Slot& slot = slots[handle];
+	ShaderHash hash = HashShaderSources(vsSource.text.c_str(), fsSource.text.c_str());
+
+	if (TryAcquireProgram(hash, &slot.program))
+	{
+		slot.state = SLOT_READY;
+		return handle;
+	}
+
+	if (workers.empty())
+	{
+		slot.state = AcquireProgram(vsSource.text.c_str(), fsSource.text.c_str(), &slot.program) == 0 ? SLOT_READY : SLOT_FAILED;
+		return handle;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(requestMutex);
+		requests.push_back(Request());
+		Request& request = requests.back();
+		request.handle = handle;
+		request.hash = hash;
+		request.vsSource.swap(vsSource.text);
+		request.fsSource.swap(fsSource.text);
+		pendingCount++;
+	}
+	requestCond.notify_one();
+	return handle;
+}
+
+void ShaderCompileService::WorkerMain(int index)
+{
+	const Worker& worker = workerContexts[index];
+	eglBindAPI(EGL_OPENGL_ES_API);
+	eglMakeCurrent(display, worker.surface, worker.surface, worker.context);
+
+	for (;;)
+	{
+		Request request;
+		{
+			std::unique_lock<std::mutex> lock(requestMutex);
+			while (requests.empty() && !stopping)
+				requestCond.wait(lock);
+			if (stopping)
+				break;
+			request.handle = requests.front().handle;
+			request.hash = requests.front().hash;
+			request.vsSource.swap(requests.front().vsSource);
+			request.fsSource.swap(requests.front().fsSource);
+			requests.pop_front();
+		}
+
+		Result result;
+		memset(&result, 0, sizeof(result));
+		result.handle = request.handle;
+		result.program.hash = request.hash;
+
+		result.program.program = LoadProgramBinary(request.hash);
+		if (result.program.program == 0)
+		{
+			CachedProgram& p = result.program;
+			p.vertexShader = CompileShader(GL_VERTEX_SHADER, request.vsSource.c_str());
+			p.fragmentShader = p.vertexShader ? CompileShader(GL_FRAGMENT_SHADER, request.fsSource.c_str()) : 0;
+			p.program = p.fragmentShader ? LinkProgram(p.vertexShader, p.fragmentShader) : 0;
+			if (p.program == 0)
+			{
+				glDeleteShader(p.vertexShader);
+				glDeleteShader(p.fragmentShader);
+				p.vertexShader = 0;
+				p.fragmentShader = 0;
+			}
+			else if (IsProgramBinaryCacheEnabled())
+			{
+				SaveProgramBinary(request.hash, p.program);
+			}
+		}
+
+		// Shared objects are only guaranteed complete for the render context once this context finished them
+		glFinish();
+
+		// The render thread drains the queue every frame, so a full queue only means it is behind
+		while (!results.Push(result))
+		{
+			if (stopping)
+			{
+				glDeleteProgram(result.program.program);
+				glDeleteShader(result.program.vertexShader);
+				glDeleteShader(result.program.fragmentShader);
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglReleaseThread();
+}
+
+void ShaderCompileService::Finish(const Result& result)
+{
+	Slot& slot = slots[result.handle];
+	pendingCount--;
+
+	if (slot.state == SLOT_RELEASED)
+	{
+		glDeleteProgram(result.program.program);
+		glDeleteShader(result.program.vertexShader);
+		glDeleteShader(result.program.fragmentShader);
+		slot.state = SLOT_FREE;
+		freeSlots.push_back(result.handle);
+		return;
+	}
+
+	if (result.program.program == 0)
+	{
+		slot.state = SLOT_FAILED;
+		return;
+	}
+
+	AdoptProgram(&result.program, &slot.program);
+	slot.state = SLOT_READY;
+}
+
+void ShaderCompileService::Update()
+{
+	Result result;
+	while (results.Pop(result))
+		Finish(result);
+}
+
+ShaderCompileStatus ShaderCompileService::GetStatus(ShaderCompileHandle handle) const
+{
+	if (handle < 0 || handle >= (int)slots.size())
+		return SHADER_COMPILE_FAILED;
+
+	switch (slots[handle].state)
+	{
+	case SLOT_READY:	return SHADER_COMPILE_READY;
+	case SLOT_PENDING:	return SHADER_COMPILE_PENDING;
+	default:			return SHADER_COMPILE_FAILED;
+	}
+}
+
+GLuint ShaderCompileService::GetProgram(ShaderCompileHandle handle) const
+{
+	return GetStatus(handle) == SHADER_COMPILE_READY ? slots[handle].program.program : fallbackProgram;
+}
+
+void ShaderCompileService::Release(ShaderCompileHandle handle)
+{
+	if (handle < 0 || handle >= (int)slots.size())
+		return;
+
+	Slot& slot = slots[handle];
+	switch (slot.state)
+	{
+	case SLOT_PENDING:
+		slot.state = SLOT_RELEASED;
+		break;
+	case SLOT_READY:
+		ReleaseProgram(slot.program.program);
+		slot.state = SLOT_FREE;
+		freeSlots.push_back(handle);
+		break;
+	case SLOT_FAILED:
+		slot.state = SLOT_FREE;
+		freeSlots.push_back(handle);
+		break;
+	default:
+		break;
+	}
+}
+
+bool ShaderCompileService::TakeProgram(ShaderCompileHandle handle, CachedProgram* result)
+{
+	if (GetStatus(handle) != SHADER_COMPILE_READY)
+		return false;
+
+	*result = slots[handle].program;
+	slots[handle].state = SLOT_FREE;
+	freeSlots.push_back(handle);
+	return true;
+}
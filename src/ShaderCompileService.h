@@ -0,0 +1,121 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include "LockFreeQueue.h"
+#include "ShaderCache.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef int ShaderCompileHandle;
+
+const ShaderCompileHandle INVALID_SHADER_COMPILE_HANDLE = -1;
+
+enum ShaderCompileStatus
+{
+	SHADER_COMPILE_PENDING,
+	SHADER_COMPILE_READY,
+	SHADER_COMPILE_FAILED,
+};
+
+// Compiles and links programs on worker threads, each owning an EGL context that shares objects
+// with the render context, so new materials never stall a frame on glCompileShader/glLinkProgram.
+// Sources are preprocessed on the calling thread and pairs already in the program cache are ready
+// at once. Until a program is ready GetProgram returns the fallback program.
+// Every call must come from the thread owning the render context.
+class ShaderCompileService
+{
+public:
+	ShaderCompileService();
+	~ShaderCompileService();
+
+	// numThreads <= 0 starts one worker. Returns false if no shared context could be created;
+	// Compile then builds synchronously like Shaders::Init.
+	bool Init(SysContext* sysCtx, int numThreads);
+	void Shutdown();
+
+	// Used while a program is compiling or after it failed, e.g. a flat colour shader. Not owned.
+	void SetFallbackProgram(GLuint program) { fallbackProgram = program; }
+
+	ShaderCompileHandle Compile(const char* vertexShaderFilePath, const char* fragmentShaderFilePath, const char* const* defines, int numDefines);
+
+	// Picks up finished programs without blocking. Call once per frame.
+	void Update();
+
+	ShaderCompileStatus GetStatus(ShaderCompileHandle handle) const;
+
+	// The program once it is ready, the fallback program before that and after a failure
+	GLuint GetProgram(ShaderCompileHandle handle) const;
+
+	// Drops the program, or its result if it is still compiling
+	void Release(ShaderCompileHandle handle);
+
+	// Hands a ready program's cache reference to the caller (e.g. Shaders::SwapProgram) and frees
+	// the handle. False, leaving the handle alone, if it is not ready.
+	bool TakeProgram(ShaderCompileHandle handle, CachedProgram* result);
+
+	int GetPendingCount() const { return pendingCount; }
+
+private:
+	enum SlotState
+	{
+		SLOT_FREE,
+		SLOT_PENDING,
+		SLOT_READY,
+		SLOT_FAILED,
+		SLOT_RELEASED,	// released while compiling, freed when the result arrives
+	};
+
+	struct Slot
+	{
+		SlotState		state;
+		CachedProgram	program;
+	};
+
+	struct Request
+	{
+		ShaderCompileHandle	handle;
+		ShaderHash			hash;
+		std::string			vsSource;
+		std::string			fsSource;
+	};
+
+	struct Result
+	{
+		ShaderCompileHandle	handle;
+		CachedProgram		program;	// program is 0 when compiling or linking failed
+	};
+
+	struct Worker
+	{
+		EGLContext		context;
+		EGLSurface		surface;	// 1x1 pbuffer, EGL_NO_SURFACE with EGL_KHR_surfaceless_context
+	};
+
+	void WorkerMain(int index);
+	void Finish(const Result& result);
+	ShaderCompileHandle AllocSlot();
+
+	EGLDisplay					display;
+	GLuint						fallbackProgram;
+
+	std::vector<Slot>			slots;
+	std::vector<ShaderCompileHandle>	freeSlots;
+	int							pendingCount;
+
+	// Render thread -> workers
+	std::mutex					requestMutex;
+	std::condition_variable		requestCond;
+	std::deque<Request>			requests;
+	std::atomic<bool>			stopping;
+
+	// Workers -> render thread
+	LockFreeQueue<Result, 64>	results;
+
+	std::vector<Worker>			workerContexts;
+	std::vector<std::thread>	workers;
+};
@@ -0,0 +1,163 @@
+#include "ShaderHotReload.h"
+#include "ShaderPreprocessor.h"
+
+#include <string.h>
+
+static void GetModifyTimes(const std::vector<std::string>& files, std::vector<unsigned long long>* times)
+{
+	times->resize(files.size());
+	for (size_t i = 0; i < files.size(); i++)
+		(*times)[i] = GetFileModifyTime(files[i].c_str());
+}
+
+ShaderHotReload::ShaderHotReload()
+	: compiler(NULL)
+	, reloadCount(0)
+{
+	memset(&watcher, 0, sizeof(watcher));
+}
+
+ShaderHotReload::~ShaderHotReload()
+{
+	Shutdown();
+}
+
+bool ShaderHotReload::Init(const char* szDirectory, ShaderCompileService* shaderCompiler)
+{
+	Shutdown();
+
+	compiler = shaderCompiler;
+	if (!StartFileWatcher(szDirectory, &watcher))
+	{
+		Debug("ShaderHotReload: cannot watch %s\n", szDirectory);
+		return false;
+	}
+	return true;
+}
+
+void ShaderHotReload::Shutdown()
+{
+	for (size_t i = 0; i < watchedShaders.size(); i++)
+	{
+		if (watchedShaders[i].pending != INVALID_SHADER_COMPILE_HANDLE)
+			compiler->Release(watchedShaders[i].pending);
+	}
+	watchedShaders.clear();
+	StopFileWatcher(&watcher);
+}
+
+void ShaderHotReload::Watch(Shaders* shaders)
+{
+	Watched watched;
+	watched.shaders = shaders;
+	watched.pending = INVALID_SHADER_COMPILE_HANDLE;
+	watched.files = shaders->files;
+	GetModifyTimes(watched.files, &watched.modifyTimes);
+	watchedShaders.push_back(watched);
+}
+
+void ShaderHotReload::Unwatch(Shaders* shaders)
+{
+	for (size_t i = 0; i < watchedShaders.size(); i++)
+	{
+		if (watchedShaders[i].shaders != shaders)
+			continue;
+
+		if (watchedShaders[i].pending != INVALID_SHADER_COMPILE_HANDLE)
+			compiler->Release(watchedShaders[i].pending);
+		watchedShaders.erase(watchedShaders.begin() + i);
+		return;
+	}
+}
+
+void ShaderHotReload::Rebuild(Watched& watched)
+{
+	// A save during a build supersedes it
+	if (watched.pending != INVALID_SHADER_COMPILE_HANDLE)
+	{
+		compiler->Release(watched.pending);
+		watched.pending = INVALID_SHADER_COMPILE_HANDLE;
+	}
+
+	Shaders* shaders = watched.shaders;
+	std::vector<const char*> defines(shaders->defines.size());
+	for (size_t i = 0; i < defines.size(); i++)
+		defines[i] = shaders->defines[i].c_str();
+	const char* const* pDefines = defines.empty() ? NULL : &defines[0];
+	int numDefines = (int)defines.size();
+
+	// Only for the file list, the edit may have added or removed includes. The compile service
+	// preprocesses again, which is cheap next to compiling.
+	ShaderSource vsSource, fsSource;
+	bool vsOk = PreprocessShader(shaders->fileVS, pDefines, numDefines, &vsSource);
+	bool fsOk = PreprocessShader(shaders->fileFS, pDefines, numDefines, &fsSource);
+
+	// Watch what this edit includes from now on, whether it builds or not, so fixing a new include
+	// or creating a missing one triggers the next rebuild. Times from before the build, so a save
+	// while it runs is still seen as a change.
+	watched.files = vsSource.files;
+	watched.files.insert(watched.files.end(), fsSource.files.begin(), fsSource.files.end());
+	GetModifyTimes(watched.files, &watched.modifyTimes);
+
+	if (!vsOk || !fsOk)
+	{
+		Debug("ShaderHotReload: %s / %s do not preprocess, keeping the current program\n", shaders->fileVS, shaders->fileFS);
+		return;
+	}
+
+	watched.pendingFiles = watched.files;
+	watched.pending = compiler->Compile(shaders->fileVS, shaders->fileFS, pDefines, numDefines);
+}
+
+void ShaderHotReload::Finish(Watched& watched)
+{
+	Shaders* shaders = watched.shaders;
+
+	CachedProgram cached;
+	if (compiler->TakeProgram(watched.pending, &cached))
+	{
+		shaders->SwapProgram(cached);
+		shaders->files.swap(watched.pendingFiles);
+		reloadCount++;
+		Debug("ShaderHotReload: reloaded %s / %s\n", shaders->fileVS, shaders->fileFS);
+	}
+	else
+	{
+		compiler->Release(watched.pending);
+		Debug("ShaderHotReload: %s / %s failed to build, keeping the current program\n", shaders->fileVS, shaders->fileFS);
+	}
+
+	watched.pending = INVALID_SHADER_COMPILE_HANDLE;
+	watched.pendingFiles.clear();
+}
+
+int ShaderHotReload::Update()
+{
+	int reloaded = reloadCount;
+
+	// The watcher only says that something changed; the modify times tell which shaders it hit,
+	// and also swallow the extra events editors produce for a single save
+	if (PollFileWatcher(&watcher))
+	{
+		std::vector<unsigned long long> times;
+		for (size_t i = 0; i < watchedShaders.size(); i++)
+		{
+			Watched& watched = watchedShaders[i];
+			GetModifyTimes(watched.files, &times);
+			if (times == watched.modifyTimes)
+				continue;
+
+			watched.modifyTimes.swap(times);
+			Rebuild(watched);
+		}
+	}
+
+	for (size_t i = 0; i < watchedShaders.size(); i++)
+	{
+		Watched& watched = watchedShaders[i];
+		if (watched.pending != INVALID_SHADER_COMPILE_HANDLE && compiler->GetStatus(watched.pending) != SHADER_COMPILE_PENDING)
+			Finish(watched);
+	}
+
+	return reloadCount - reloaded;
+}
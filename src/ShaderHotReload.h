@@ -0,0 +1,51 @@
+#pragma once
+
+#include "FileWatcher.h"
+#include "ShaderCompileService.h"
+#include "Shaders.h"
+#include <string>
+#include <vector>
+
+// Rebuilds watched Shaders when one of their files changes on disk: either stage or anything they
+// include. New programs are compiled on the compile service and swapped in between frames; the old
+// program keeps rendering while the new one builds and stays if it fails to compile.
+// Every call must come from the thread owning the render context.
+class ShaderHotReload
+{
+public:
+	ShaderHotReload();
+	~ShaderHotReload();
+
+	// Watches szDirectory and below. compiler is not owned and must outlive the reloader.
+	bool Init(const char* szDirectory, ShaderCompileService* compiler);
+	void Shutdown();
+
+	// Shaders must be unwatched before they are destroyed. Watching a Shaders whose Init failed
+	// is fine, fixing the file then builds it.
+	void Watch(Shaders* shaders);
+	void Unwatch(Shaders* shaders);
+
+	// Starts rebuilds for changed files and swaps finished programs in. Call once per frame,
+	// after ShaderCompileService::Update. Returns how many programs were swapped in.
+	int Update();
+
+	int GetReloadCount() const { return reloadCount; }
+
+private:
+	struct Watched
+	{
+		Shaders*							shaders;
+		std::vector<std::string>			files;			// of the last preprocess, even a failed one
+		std::vector<unsigned long long>		modifyTimes;	// of files
+		ShaderCompileHandle					pending;
+		std::vector<std::string>			pendingFiles;	// files of the pending build
+	};
+
+	void Rebuild(Watched& watched);
+	void Finish(Watched& watched);
+
+	FileWatcher					watcher;
+	ShaderCompileService*		compiler;
+	std::vector<Watched>		watchedShaders;
+	int							reloadCount;
+};
@@ -0,0 +1,1542 @@
+#include "ShaderOptimizer.h"
+
+#include <ctype.h>
+#include <limits>
+#include <math.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// lowp float is only guaranteed to hold (-2, 2), GLSL ES 1.00 section 4.5.2
+const double LOWP_LIMIT = 2.0;
+
+// Fixpoint rounds after which ranges that still grow (loop counters, accumulators) are given up on
+const int RANGE_WIDEN_ROUND = 8;
+
+// -----------------------------------------------------------------------------
+// Tokens
+// -----------------------------------------------------------------------------
+
+enum TokenType
+{
+	TOKEN_WORD,
+	TOKEN_NUMBER,
+	TOKEN_PUNCT,
+	TOKEN_DIRECTIVE,	// a whole preprocessor line
+};
+
+struct Token
+{
+	TokenType		type;
+	std::string		text;
+	int				file;
+	int				line;
+	bool			removed;
+	bool			lineDirective;
+};
+
+static const char* const s_multiCharPuncts[] =
+{
+	"<<=", ">>=", "++", "--", "+=", "-=", "*=", "/=", "%=", "&=", "|=", "^=",
+	"==", "!=", "<=", ">=", "&&", "||", "^^", "<<", ">>",
+};
+
+static const char* const s_typeNames[] =
+{
+	"void", "float", "vec2", "vec3", "vec4", "int", "ivec2", "ivec3", "ivec4",
+	"bool", "bvec2", "bvec3", "bvec4", "mat2", "mat3", "mat4", "sampler2D", "samplerCube",
+};
+
+static const char* const s_qualifiers[] =
+{
+	"const", "uniform", "attribute", "varying", "invariant", "highp", "mediump", "lowp", "in", "out", "inout",
+};
+
+static const char* const s_assignOps[] = { "=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=", "&=", "|=", "^=" };
+
+static const char* const s_textureFunctions[] =
+{
+	"texture2D", "texture2DProj", "texture2DLod", "texture2DProjLod", "textureCube", "textureCubeLod",
+	"texture2DGradEXT", "texture2DProjGradEXT", "textureCubeGradEXT", "texture2DLodEXT", "texture2DProjLodEXT", "textureCubeLodEXT",
+};
+
+template <size_t N>
+static bool IsOneOf(const std::string& text, const char* const (&list)[N])
+{
+	for (size_t i = 0; i < N; i++)
+	{
+		if (text == list[i])
+			return true;
+	}
+	return false;
+}
+
+static bool IsWordChar(char c)
+{
+	return isalnum((unsigned char)c) || c == '_';
+}
+
+static bool IsFloatType(const std::string& type)
+{
+	return type == "float" || type == "vec2" || type == "vec3" || type == "vec4";
+}
+
+static bool IsPrecision(const std::string& text)
+{
+	return text == "lowp" || text == "mediump" || text == "highp";
+}
+
+static void SkipComment(const char*& p, int* pLines)
+{
+	if (p[1] == '/')
+	{
+		while (*p && *p != '\n')
+			p++;
+		return;
+	}
+
+	p += 2;
+	while (*p && !(p[0] == '*' && p[1] == '/'))
+	{
+		if (*p == '\n')
+			(*pLines)++;
+		p++;
+	}
+	if (*p)
+		p += 2;
+}
+
+static void Tokenize(const char* p, std::vector<Token>* tokens)
+{
+	int file = 0;
+	int line = 1;
+	bool lineStart = true;
+
+	while (*p)
+	{
+		char c = *p;
+		if (c == '\n')
+		{
+			line++;
+			lineStart = true;
+			p++;
+			continue;
+		}
+		if (c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v')
+		{
+			p++;
+			continue;
+		}
+		if (c == '/' && (p[1] == '/' || p[1] == '*'))
+		{
+			SkipComment(p, &line);
+			continue;
+		}
+
+		Token token;
+		token.file = file;
+		token.line = line;
+		token.removed = false;
+		token.lineDirective = false;
+
+		if (c == '#' && lineStart)
+		{
+			// Continuations are joined and comments dropped, the newline itself is left for the loop
+			int lines = 0;
+			while (*p && *p != '\n')
+			{
+				if (p[0] == '\\' && (p[1] == '\n' || (p[1] == '\r' && p[2] == '\n')))
+				{
+					p += p[1] == '\n' ? 2 : 3;
+					lines++;
+					token.text += ' ';
+				}
+				else if (p[0] == '/' && (p[1] == '/' || p[1] == '*'))
+				{
+					SkipComment(p, &lines);
+					token.text += ' ';
+				}
+				else
+				{
+					token.text += *p++;
+				}
+			}
+			while (!token.text.empty() && isspace((unsigned char)token.text[token.text.size() - 1]))
+				token.text.erase(token.text.size() - 1);
+			line += lines;
+
+			// #line N S: the next line is line N of source string S
+			const char* q = token.text.c_str() + 1;
+			while (*q == ' ' || *q == '\t')
+				q++;
+			if (strncmp(q, "line", 4) == 0 && !IsWordChar(q[4]))
+			{
+				token.lineDirective = true;
+				char* end;
+				long lineNumber = strtol(q + 4, &end, 10);
+				if (end != q + 4)
+				{
+					line = (int)lineNumber - 1;
+					const char* fileStart = end;
+					long fileNumber = strtol(fileStart, &end, 10);
+					if (end != fileStart)
+						file = (int)fileNumber;
+				}
+			}
+
+			token.type = TOKEN_DIRECTIVE;
+			tokens->push_back(token);
+			continue;
+		}
+		lineStart = false;
+
+		if (isdigit((unsigned char)c) || (c == '.' && isdigit((unsigned char)p[1])))
+		{
+			const char* start = p;
+			while (IsWordChar(*p) || *p == '.' || ((*p == '+' || *p == '-') && (p[-1] == 'e' || p[-1] == 'E') && !(start[0] == '0' && (start[1] == 'x' || start[1] == 'X'))))
+				p++;
+			token.type = TOKEN_NUMBER;
+			token.text.assign(start, p);
+		}
+		else if (IsWordChar(c))
+		{
+			const char* start = p;
+			while (IsWordChar(*p))
+				p++;
+			token.type = TOKEN_WORD;
+			token.text.assign(start, p);
+		}
+		else
+		{
+			token.type = TOKEN_PUNCT;
+			token.text = c;
+			for (size_t i = 0; i < sizeof(s_multiCharPuncts) / sizeof(s_multiCharPuncts[0]); i++)
+			{
+				size_t length = strlen(s_multiCharPuncts[i]);
+				if (strncmp(p, s_multiCharPuncts[i], length) == 0)
+				{
+					token.text = s_multiCharPuncts[i];
+					break;
+				}
+			}
+			p += token.text.size();
+		}
+
+		tokens->push_back(token);
+	}
+}
+
+// Whether two tokens would fuse into something else when written without a space
+static bool NeedsSpace(const std::string& prev, const std::string& next)
+{
+	char a = prev[prev.size() - 1];
+	char b = next[0];
+	if (IsWordChar(a) && (IsWordChar(b) || (b == '.' && next.size() > 1 && isdigit((unsigned char)next[1]))))
+		return true;
+	return (a == '+' || a == '-') && b == a;
+}
+
+// Extra spaces of the non-minified output: "a, b", ") {", "} else"
+static bool IsReadableSpace(const std::string& prev, const Token& next)
+{
+	if (prev == "," || next.text == "{")
+		return true;
+	return (prev == ")" || prev == "}") && next.type == TOKEN_WORD;
+}
+
+static std::string WriteTokens(const std::vector<Token>& tokens, bool minify)
+{
+	std::string out;
+	const Token* prev = NULL;
+	int depth = 0;
+	int parens = 0;
+	bool lineStart = true;
+
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		const Token& token = tokens[i];
+		if (token.removed || (minify && token.lineDirective))
+			continue;
+
+		if (token.type == TOKEN_DIRECTIVE)
+		{
+			if (!out.empty() && out[out.size() - 1] != '\n')
+				out += '\n';
+			out += token.text;
+			out += '\n';
+			lineStart = true;
+			prev = NULL;
+			continue;
+		}
+
+		if (token.text == "}")
+		{
+			depth = depth > 0 ? depth - 1 : 0;
+			if (!minify && !lineStart)
+			{
+				out += '\n';
+				lineStart = true;
+			}
+		}
+
+		if (!minify && lineStart)
+			out.append(depth, '\t');
+		else if (prev != NULL && (NeedsSpace(prev->text, token.text) || (!minify && IsReadableSpace(prev->text, token))))
+			out += ' ';
+		out += token.text;
+		lineStart = false;
+		prev = &token;
+
+		if (token.text == "(")
+			parens++;
+		else if (token.text == ")")
+			parens--;
+		else if (token.text == "{")
+			depth++;
+
+		if (minify)
+			continue;
+
+		// One statement per line, but keep "};", "} else" and for (;;) headers together
+		size_t next = i + 1;
+		while (next < tokens.size() && tokens[next].removed)
+			next++;
+		const std::string* nextText = next < tokens.size() ? &tokens[next].text : NULL;
+		bool newline = token.text == "{" || (token.text == ";" && parens == 0) ||
+			(token.text == "}" && !(nextText && (*nextText == ";" || *nextText == "," || *nextText == "else")));
+		if (newline)
+		{
+			out += '\n';
+			lineStart = true;
+		}
+	}
+
+	if (!out.empty() && out[out.size() - 1] != '\n')
+		out += '\n';
+	return out;
+}
+
+// -----------------------------------------------------------------------------
+// Structure
+// -----------------------------------------------------------------------------
+
+struct Declaration
+{
+	int					begin;
+	int					end;				// the ';'
+	int					precisionToken;		// -1 when the default precision applies
+	int					typeToken;
+	std::string			storage;			// uniform, attribute, varying, const or empty
+	std::vector<int>	nameTokens;
+	std::vector<int>	initBegin;			// per name, equal to initEnd without an initializer
+	std::vector<int>	initEnd;
+};
+
+struct Function
+{
+	std::string			name;
+	int					begin;
+	int					end;				// the closing '}', or the ';' of a prototype
+	int					paramsBegin;		// the '('
+	int					bodyBegin;			// the '{', -1 for prototypes
+	bool				prototype;
+};
+
+struct Statement
+{
+	int					begin;
+	int					end;				// the ';'
+};
+
+class ShaderOptimizerPass
+{
+public:
+	std::vector<Token>			tokens;
+	std::set<std::string>		structNames;
+	std::vector<Declaration>	globals;
+	std::vector<Function>		functions;
+
+	bool Parse();
+	void Compact();
+
+	int FindMatching(int open) const;
+	bool ParseDeclaration(int begin, int end, Declaration* decl) const;
+	void ParseStatements(int begin, int end, std::vector<Statement>* statements) const;
+	bool IsUserFunction(const std::string& name) const;
+
+	bool RemoveDeadCode(ShaderOptimizeReport* report);
+};
+
+int ShaderOptimizerPass::FindMatching(int open) const
+{
+	const std::string& openText = tokens[open].text;
+	const char* closeText = openText == "(" ? ")" : (openText == "[" ? "]" : "}");
+	int depth = 0;
+	for (int i = open; i < (int)tokens.size(); i++)
+	{
+		if (tokens[i].text == openText)
+			depth++;
+		else if (tokens[i].text == closeText && --depth == 0)
+			return i;
+	}
+	return -1;
+}
+
+bool ShaderOptimizerPass::ParseDeclaration(int begin, int end, Declaration* decl) const
+{
+	decl->begin = begin;
+	decl->end = end;
+	decl->precisionToken = -1;
+	decl->storage.clear();
+	decl->nameTokens.clear();
+	decl->initBegin.clear();
+	decl->initEnd.clear();
+
+	int i = begin;
+	while (i < end && tokens[i].type == TOKEN_WORD && IsOneOf(tokens[i].text, s_qualifiers))
+	{
+		if (IsPrecision(tokens[i].text))
+			decl->precisionToken = i;
+		else if (tokens[i].text != "invariant")
+			decl->storage = tokens[i].text;
+		i++;
+	}
+
+	if (i >= end || tokens[i].type != TOKEN_WORD || !(IsOneOf(tokens[i].text, s_typeNames) || structNames.count(tokens[i].text)))
+		return false;
+	decl->typeToken = i++;
+
+	for (;;)
+	{
+		if (i >= end || tokens[i].type != TOKEN_WORD)
+			return false;
+		decl->nameTokens.push_back(i++);
+
+		if (i < end && tokens[i].text == "[")
+		{
+			i = FindMatching(i);
+			if (i < 0 || i >= end)
+				return false;
+			i++;
+		}
+
+		int initBegin = i;
+		if (i < end && tokens[i].text == "=")
+		{
+			initBegin = ++i;
+			int depth = 0;
+			for (; i < end; i++)
+			{
+				const std::string& text = tokens[i].text;
+				if (text == "(" || text == "[")
+					depth++;
+				else if (text == ")" || text == "]")
+					depth--;
+				else if (text == "," && depth == 0)
+					break;
+			}
+		}
+		decl->initBegin.push_back(initBegin);
+		decl->initEnd.push_back(i);
+
+		if (i == end)
+			return true;
+		if (tokens[i].text != ",")
+			return false;
+		i++;
+	}
+}
+
+void ShaderOptimizerPass::ParseStatements(int begin, int end, std::vector<Statement>* statements) const
+{
+	int i = begin;
+	while (i < end)
+	{
+		const Token& token = tokens[i];
+		if (token.type == TOKEN_DIRECTIVE || token.text == "{" || token.text == "}" || token.text == "else" || token.text == "do")
+		{
+			i++;
+			continue;
+		}
+
+		// The statement after an if / while / for header starts right after its ')'
+		if ((token.text == "if" || token.text == "while" || token.text == "for") && i + 1 < end && tokens[i + 1].text == "(")
+		{
+			int close = FindMatching(i + 1);
+			i = close < 0 ? end : close + 1;
+			continue;
+		}
+
+		int j = i;
+		int parens = 0;
+		for (; j < end; j++)
+		{
+			const std::string& text = tokens[j].text;
+			if (text == "(")
+				parens++;
+			else if (text == ")")
+				parens--;
+			else if (parens == 0 && (text == ";" || text == "{" || text == "}"))
+				break;
+		}
+
+		if (j < end && tokens[j].text == ";")
+		{
+			Statement statement;
+			statement.begin = i;
+			statement.end = j;
+			statements->push_back(statement);
+			i = j + 1;
+		}
+		else
+		{
+			i = j > i ? j : i + 1;
+		}
+	}
+}
+
+bool ShaderOptimizerPass::IsUserFunction(const std::string& name) const
+{
+	for (size_t i = 0; i < functions.size(); i++)
+	{
+		if (functions[i].name == name)
+			return true;
+	}
+	return false;
+}
+
+bool ShaderOptimizerPass::Parse()
+{
+	globals.clear();
+	functions.clear();
+	structNames.clear();
+
+	for (size_t i = 0; i + 1 < tokens.size(); i++)
+	{
+		if (tokens[i].text == "struct" && tokens[i + 1].type == TOKEN_WORD)
+			structNames.insert(tokens[i + 1].text);
+	}
+
+	int count = (int)tokens.size();
+	int i = 0;
+	while (i < count)
+	{
+		if (tokens[i].type == TOKEN_DIRECTIVE)
+		{
+			i++;
+			continue;
+		}
+
+		// Up to the ';' at depth 0, or the '}' of a function body
+		int end = -1;
+		int bodyBegin = -1;
+		int parens = 0;
+		int braces = 0;
+		for (int j = i; j < count && end < 0; j++)
+		{
+			const std::string& text = tokens[j].text;
+			if (tokens[j].type == TOKEN_DIRECTIVE)
+				continue;
+			if (text == "(")
+				parens++;
+			else if (text == ")")
+				parens--;
+			else if (text == "{")
+			{
+				if (braces == 0 && parens == 0 && j > i && tokens[j - 1].text == ")")
+				{
+					bodyBegin = j;
+					end = FindMatching(j);
+					if (end < 0)
+						return false;
+				}
+				else
+				{
+					braces++;
+				}
+			}
+			else if (text == "}")
+				braces--;
+			else if (text == ";" && braces == 0 && parens == 0)
+				end = j;
+		}
+		if (end < 0)
+			return false;
+
+		int paren = -1;
+		for (int j = i; j < end && paren < 0; j++)
+		{
+			if (tokens[j].text == "(")
+				paren = j;
+			else if (tokens[j].text == "=")
+				break;
+		}
+
+		Declaration decl;
+		if (bodyBegin >= 0 || (paren > i && tokens[paren - 1].type == TOKEN_WORD && !ParseDeclaration(i, end, &decl) && tokens[i].text != "precision" && tokens[i].text != "struct"))
+		{
+			Function function;
+			function.name = paren > i ? tokens[paren - 1].text : std::string();
+			function.begin = i;
+			function.end = end;
+			function.paramsBegin = paren;
+			function.bodyBegin = bodyBegin;
+			function.prototype = bodyBegin < 0;
+			functions.push_back(function);
+		}
+		else if (ParseDeclaration(i, end, &decl))
+		{
+			globals.push_back(decl);
+		}
+
+		i = end + 1;
+	}
+	return true;
+}
+
+void ShaderOptimizerPass::Compact()
+{
+	std::vector<Token> kept;
+	kept.reserve(tokens.size());
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		if (!tokens[i].removed)
+			kept.push_back(tokens[i]);
+	}
+	tokens.swap(kept);
+}
+
+// Identifiers used by #define and #if lines; code using them through a macro is invisible otherwise
+static void CollectDirectiveWords(const std::vector<Token>& tokens, std::set<std::string>* words)
+{
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		if (tokens[i].type != TOKEN_DIRECTIVE || tokens[i].removed || tokens[i].lineDirective)
+			continue;
+
+		const char* p = tokens[i].text.c_str() + 1;
+		while (*p)
+		{
+			if (IsWordChar(*p) && !isdigit((unsigned char)*p))
+			{
+				const char* start = p;
+				while (IsWordChar(*p))
+					p++;
+				words->insert(std::string(start, p));
+			}
+			else
+			{
+				p++;
+			}
+		}
+	}
+}
+
+// Names in every texture call argument after the sampler: coordinates, bias and lod
+static void CollectTextureCoordinates(const ShaderOptimizerPass& pass, std::set<std::string>* names)
+{
+	const std::vector<Token>& tokens = pass.tokens;
+	for (size_t i = 0; i + 1 < tokens.size(); i++)
+	{
+		if (tokens[i].type != TOKEN_WORD || tokens[i + 1].text != "(" || !IsOneOf(tokens[i].text, s_textureFunctions))
+			continue;
+
+		int close = pass.FindMatching((int)i + 1);
+		int depth = 0;
+		int arg = 0;
+		for (int j = (int)i + 2; j < close; j++)
+		{
+			const std::string& text = tokens[j].text;
+			if (text == "(" || text == "[")
+				depth++;
+			else if (text == ")" || text == "]")
+				depth--;
+			else if (text == "," && depth == 0)
+				arg++;
+			else if (arg > 0 && tokens[j].type == TOKEN_WORD)
+				names->insert(text);
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Dead code
+// -----------------------------------------------------------------------------
+
+static void RemoveTokens(std::vector<Token>& tokens, int begin, int end)
+{
+	for (int i = begin; i <= end; i++)
+		tokens[i].removed = true;
+}
+
+bool ShaderOptimizerPass::RemoveDeadCode(ShaderOptimizeReport* report)
+{
+	bool changed = false;
+
+	// Anything a directive mentions may be used through a macro
+	std::set<std::string> directiveWords;
+	CollectDirectiveWords(tokens, &directiveWords);
+
+	// Functions main cannot reach. Without a main this is a library and nothing is dead.
+	bool hasMain = false;
+	for (size_t i = 0; i < functions.size(); i++)
+		hasMain = hasMain || (functions[i].name == "main" && !functions[i].prototype);
+
+	if (hasMain)
+	{
+		std::set<std::string> reachable(directiveWords);
+		std::vector<std::string> work(directiveWords.begin(), directiveWords.end());
+		if (reachable.insert("main").second)
+			work.push_back("main");
+		while (!work.empty())
+		{
+			std::string name = work.back();
+			work.pop_back();
+			for (size_t f = 0; f < functions.size(); f++)
+			{
+				const Function& function = functions[f];
+				if (function.name != name || function.prototype)
+					continue;
+				for (int i = function.bodyBegin; i < function.end; i++)
+				{
+					if (tokens[i].type == TOKEN_WORD && tokens[i + 1].text == "(" && IsUserFunction(tokens[i].text) && reachable.insert(tokens[i].text).second)
+						work.push_back(tokens[i].text);
+				}
+			}
+		}
+
+		std::set<std::string> reported;
+		for (size_t f = 0; f < functions.size(); f++)
+		{
+			const Function& function = functions[f];
+			if (reachable.count(function.name))
+				continue;
+			RemoveTokens(tokens, function.begin, function.end);
+			if (reported.insert(function.name).second)
+				report->removedFunctions.push_back(function.name);
+			changed = true;
+		}
+	}
+
+	// Globals nobody reads or writes; interface variables stay, the application may set them
+	std::map<std::string, int> uses;
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		if (!tokens[i].removed && tokens[i].type == TOKEN_WORD)
+			uses[tokens[i].text]++;
+	}
+
+	for (size_t g = 0; g < globals.size(); g++)
+	{
+		const Declaration& decl = globals[g];
+		if (!decl.storage.empty() && decl.storage != "const")
+			continue;
+
+		bool unused = true;
+		for (size_t n = 0; n < decl.nameTokens.size(); n++)
+			unused = unused && uses[tokens[decl.nameTokens[n]].text] == 1 && !directiveWords.count(tokens[decl.nameTokens[n]].text);
+		if (!unused)
+			continue;
+
+		RemoveTokens(tokens, decl.begin, decl.end);
+		for (size_t n = 0; n < decl.nameTokens.size(); n++)
+			report->removedVariables.push_back(tokens[decl.nameTokens[n]].text);
+		changed = true;
+	}
+
+	// Locals nothing refers to again, as long as dropping the initializer cannot drop a side effect
+	for (size_t f = 0; f < functions.size(); f++)
+	{
+		const Function& function = functions[f];
+		if (function.prototype || tokens[function.begin].removed)
+			continue;
+
+		std::map<std::string, int> localUses;
+		for (int i = function.paramsBegin; i < function.end; i++)
+		{
+			if (!tokens[i].removed && tokens[i].type == TOKEN_WORD)
+				localUses[tokens[i].text]++;
+		}
+
+		std::vector<Statement> statements;
+		ParseStatements(function.bodyBegin + 1, function.end, &statements);
+		for (size_t s = 0; s < statements.size(); s++)
+		{
+			Declaration decl;
+			if (!ParseDeclaration(statements[s].begin, statements[s].end, &decl))
+				continue;
+
+			bool removable = true;
+			for (size_t n = 0; n < decl.nameTokens.size() && removable; n++)
+			{
+				removable = localUses[tokens[decl.nameTokens[n]].text] == 1 && !directiveWords.count(tokens[decl.nameTokens[n]].text);
+				for (int i = decl.initBegin[n]; i < decl.initEnd[n] && removable; i++)
+				{
+					const Token& token = tokens[i];
+					removable = !IsOneOf(token.text, s_assignOps) && token.text != "++" && token.text != "--" &&
+						!(token.type == TOKEN_WORD && tokens[i + 1].text == "(" && IsUserFunction(token.text));
+				}
+			}
+			if (!removable)
+				continue;
+
+			RemoveTokens(tokens, decl.begin, decl.end);
+			for (size_t n = 0; n < decl.nameTokens.size(); n++)
+				report->removedVariables.push_back(function.name + ":" + tokens[decl.nameTokens[n]].text);
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+// -----------------------------------------------------------------------------
+// Value ranges
+// -----------------------------------------------------------------------------
+
+static const double INF = std::numeric_limits<double>::infinity();
+
+static ShaderValueRange MakeRange(double lo, double hi)
+{
+	ShaderValueRange range;
+	range.lo = lo;
+	range.hi = hi;
+	return range;
+}
+
+static ShaderValueRange EmptyRange()		{ return MakeRange(INF, -INF); }
+static ShaderValueRange UnknownRange()		{ return MakeRange(-INF, INF); }
+static bool IsEmpty(const ShaderValueRange& r)		{ return r.lo > r.hi; }
+
+static ShaderValueRange Hull(const ShaderValueRange& a, const ShaderValueRange& b)
+{
+	return MakeRange(a.lo < b.lo ? a.lo : b.lo, a.hi > b.hi ? a.hi : b.hi);
+}
+
+static ShaderValueRange Add(const ShaderValueRange& a, const ShaderValueRange& b)
+{
+	if (IsEmpty(a) || IsEmpty(b))
+		return EmptyRange();
+	return MakeRange(a.lo + b.lo, a.hi + b.hi);
+}
+
+static ShaderValueRange Negate(const ShaderValueRange& a)
+{
+	return IsEmpty(a) ? a : MakeRange(-a.hi, -a.lo);
+}
+
+// 0 * inf is 0 here: a value known to be 0 stays 0 whatever it is multiplied with
+static double Product(double a, double b)
+{
+	return a == 0.0 || b == 0.0 ? 0.0 : a * b;
+}
+
+static ShaderValueRange Multiply(const ShaderValueRange& a, const ShaderValueRange& b)
+{
+	if (IsEmpty(a) || IsEmpty(b))
+		return EmptyRange();
+
+	double p[4] = { Product(a.lo, b.lo), Product(a.lo, b.hi), Product(a.hi, b.lo), Product(a.hi, b.hi) };
+	ShaderValueRange r = MakeRange(p[0], p[0]);
+	for (int i = 1; i < 4; i++)
+		r = Hull(r, MakeRange(p[i], p[i]));
+	return r;
+}
+
+static ShaderValueRange Divide(const ShaderValueRange& a, const ShaderValueRange& b)
+{
+	if (IsEmpty(a) || IsEmpty(b))
+		return EmptyRange();
+	if (b.lo <= 0.0 && b.hi >= 0.0)
+		return UnknownRange();
+	return Multiply(a, MakeRange(1.0 / b.hi, 1.0 / b.lo));
+}
+
+static ShaderValueRange Min(const ShaderValueRange& a, const ShaderValueRange& b)
+{
+	if (IsEmpty(a) || IsEmpty(b))
+		return EmptyRange();
+	return MakeRange(a.lo < b.lo ? a.lo : b.lo, a.hi < b.hi ? a.hi : b.hi);
+}
+
+static ShaderValueRange Max(const ShaderValueRange& a, const ShaderValueRange& b)
+{
+	if (IsEmpty(a) || IsEmpty(b))
+		return EmptyRange();
+	return MakeRange(a.lo > b.lo ? a.lo : b.lo, a.hi > b.hi ? a.hi : b.hi);
+}
+
+struct Variable
+{
+	ShaderValueRange	range;
+	bool				computed;		// range comes from the assignments below, not from outside
+	bool				floatType;
+	bool				keepPrecision;	// uniform, attribute, explicit highp or already lowp
+	bool				needsPrecision;	// feeds a texture coordinate
+	std::vector<const Declaration*>	declarations;
+};
+
+struct Assignment
+{
+	std::string		target;
+	std::string		op;
+	int				exprBegin;
+	int				exprEnd;
+};
+
+typedef std::map<std::string, Variable> VariableMap;
+
+// Interval evaluation of one expression. Anything it does not understand is unknown, so the result
+// always contains every value the expression can take.
+class RangeEvaluator
+{
+public:
+	RangeEvaluator(const ShaderOptimizerPass& pass, const VariableMap& vars, int begin, int end)
+		: pass(pass), tokens(pass.tokens), vars(vars), pos(begin), end(end)
+	{
+	}
+
+	ShaderValueRange Evaluate()
+	{
+		ShaderValueRange r = Ternary();
+		return pos == end ? r : UnknownRange();
+	}
+
+private:
+	const ShaderOptimizerPass&	pass;
+	const std::vector<Token>&	tokens;
+	const VariableMap&			vars;
+	int							pos;
+	int							end;
+
+	bool Accept(const char* text)
+	{
+		if (pos < end && tokens[pos].text == text)
+		{
+			pos++;
+			return true;
+		}
+		return false;
+	}
+
+	bool Peek(const char* text) const
+	{
+		return pos < end && tokens[pos].text == text;
+	}
+
+	ShaderValueRange Ternary()
+	{
+		ShaderValueRange condition = Binary(0);
+		if (!Accept("?"))
+			return condition;
+		ShaderValueRange a = Ternary();
+		if (!Accept(":"))
+			return UnknownRange();
+		ShaderValueRange b = Ternary();
+		return Hull(a, b);
+	}
+
+	// Precedence levels from loosest to tightest
+	static int GetLevel(const std::string& op)
+	{
+		if (op == "||" || op == "^^")								return 0;
+		if (op == "&&")												return 1;
+		if (op == "==" || op == "!=")								return 2;
+		if (op == "<" || op == ">" || op == "<=" || op == ">=")		return 3;
+		if (op == "+" || op == "-")									return 4;
+		if (op == "*" || op == "/")									return 5;
+		return -1;
+	}
+
+	ShaderValueRange Binary(int level)
+	{
+		if (level > 5)
+			return Unary();
+
+		ShaderValueRange left = Binary(level + 1);
+		while (pos < end && tokens[pos].type == TOKEN_PUNCT && GetLevel(tokens[pos].text) == level)
+		{
+			std::string op = tokens[pos++].text;
+			ShaderValueRange right = Binary(level + 1);
+			if (op == "+")
+				left = Add(left, right);
+			else if (op == "-")
+				left = Add(left, Negate(right));
+			else if (op == "*")
+				left = Multiply(left, right);
+			else if (op == "/")
+				left = Divide(left, right);
+			else
+				left = MakeRange(0.0, 1.0);
+		}
+		return left;
+	}
+
+	ShaderValueRange Unary()
+	{
+		if (Accept("-"))
+			return Negate(Unary());
+		if (Accept("+"))
+			return Unary();
+		if (Accept("!"))
+		{
+			Unary();
+			return MakeRange(0.0, 1.0);
+		}
+		if (Accept("++") || Accept("--"))
+		{
+			Unary();
+			return UnknownRange();
+		}
+		return Postfix();
+	}
+
+	ShaderValueRange Postfix()
+	{
+		ShaderValueRange r = Primary();
+		for (;;)
+		{
+			// Swizzles, struct fields and indexing keep the bounds of the whole value
+			if (Accept("."))
+			{
+				if (pos < end)
+					pos++;
+			}
+			else if (Peek("["))
+			{
+				pos++;
+				Ternary();
+				if (!Accept("]"))
+					return UnknownRange();
+			}
+			else if (Accept("++") || Accept("--"))
+			{
+				r = UnknownRange();
+			}
+			else
+			{
+				return r;
+			}
+		}
+	}
+
+	ShaderValueRange Primary()
+	{
+		if (pos >= end)
+			return UnknownRange();
+
+		const Token& token = tokens[pos];
+		if (token.type == TOKEN_NUMBER)
+		{
+			pos++;
+			double value = strtod(token.text.c_str(), NULL);
+			return MakeRange(value, value);
+		}
+
+		if (Accept("("))
+		{
+			ShaderValueRange r = Ternary();
+			return Accept(")") ? r : UnknownRange();
+		}
+
+		if (token.type == TOKEN_WORD)
+		{
+			pos++;
+			if (Peek("("))
+				return Call(token.text);
+
+			if (token.text == "true" || token.text == "false")
+				return MakeRange(0.0, 1.0);
+			if (token.text == "gl_PointCoord")
+				return MakeRange(0.0, 1.0);
+
+			VariableMap::const_iterator it = vars.find(token.text);
+			return it == vars.end() ? UnknownRange() : it->second.range;
+		}
+
+		pos++;
+		return UnknownRange();
+	}
+
+	ShaderValueRange Call(const std::string& name)
+	{
+		std::vector<ShaderValueRange> args;
+		pos++;
+		if (!Accept(")"))
+		{
+			for (;;)
+			{
+				args.push_back(Ternary());
+				if (Accept(")"))
+					break;
+				if (!Accept(","))
+					return UnknownRange();
+			}
+		}
+
+		// Normalized texture formats only
+		if (IsOneOf(name, s_textureFunctions))
+			return MakeRange(0.0, 1.0);
+
+		if (pass.IsUserFunction(name))
+			return UnknownRange();
+
+		if (IsFloatType(name) || name == "int" || name == "ivec2" || name == "ivec3" || name == "ivec4" ||
+			name == "mat2" || name == "mat3" || name == "mat4")
+		{
+			ShaderValueRange r = EmptyRange();
+			for (size_t a = 0; a < args.size(); a++)
+				r = Hull(r, args[a]);
+			return args.empty() ? UnknownRange() : r;
+		}
+
+		if (name == "bool" || name == "bvec2" || name == "bvec3" || name == "bvec4" || name == "step" || name == "smoothstep" ||
+			name == "any" || name == "all" || name == "not" || name == "equal" || name == "notEqual" ||
+			name == "lessThan" || name == "lessThanEqual" || name == "greaterThan" || name == "greaterThanEqual")
+			return MakeRange(0.0, 1.0);
+
+		if (name == "sin" || name == "cos" || name == "normalize" || name == "sign" || name == "faceforward")
+		{
+			if (name == "faceforward" && args.size() == 3)
+				return Hull(args[0], Negate(args[0]));
+			return MakeRange(-1.0, 1.0);
+		}
+
+		if (name == "fract")
+			return MakeRange(0.0, 1.0);
+
+		if (name == "abs" && args.size() == 1)
+		{
+			if (IsEmpty(args[0]))
+				return args[0];
+			double m = fabs(args[0].lo) > fabs(args[0].hi) ? fabs(args[0].lo) : fabs(args[0].hi);
+			return MakeRange(args[0].lo > 0.0 ? args[0].lo : (args[0].hi < 0.0 ? -args[0].hi : 0.0), m);
+		}
+
+		if (name == "sqrt" && args.size() == 1)
+		{
+			if (IsEmpty(args[0]))
+				return args[0];
+			return MakeRange(sqrt(args[0].lo > 0.0 ? args[0].lo : 0.0), args[0].hi > 0.0 ? sqrt(args[0].hi) : 0.0);
+		}
+
+		if (name == "min" && args.size() == 2)
+			return Min(args[0], args[1]);
+		if (name == "max" && args.size() == 2)
+			return Max(args[0], args[1]);
+		if (name == "clamp" && args.size() == 3)
+			return Min(Max(args[0], args[1]), args[2]);
+		if (name == "floor" && args.size() == 1 && !IsEmpty(args[0]))
+			return MakeRange(floor(args[0].lo), floor(args[0].hi));
+		if (name == "ceil" && args.size() == 1 && !IsEmpty(args[0]))
+			return MakeRange(ceil(args[0].lo), ceil(args[0].hi));
+
+		if (name == "mix" && args.size() == 3)
+		{
+			if (IsEmpty(args[2]))
+				return args[2];
+			if (args[2].lo >= 0.0 && args[2].hi <= 1.0)
+				return Hull(args[0], args[1]);
+			return Add(Multiply(args[0], Add(MakeRange(1.0, 1.0), Negate(args[2]))), Multiply(args[1], args[2]));
+		}
+
+		// GLES2 vectors have at most 4 components
+		if (name == "dot" && args.size() == 2)
+			return Multiply(Multiply(args[0], args[1]), MakeRange(0.0, 4.0));
+		if (name == "length" && args.size() == 1 && !IsEmpty(args[0]))
+		{
+			double m = fabs(args[0].lo) > fabs(args[0].hi) ? fabs(args[0].lo) : fabs(args[0].hi);
+			return MakeRange(0.0, 2.0 * m);
+		}
+
+		return UnknownRange();
+	}
+};
+
+// -----------------------------------------------------------------------------
+// Precision
+// -----------------------------------------------------------------------------
+
+static void MarkUnknown(VariableMap& vars, const std::string& name)
+{
+	VariableMap::iterator it = vars.find(name);
+	if (it == vars.end())
+		return;
+	it->second.computed = false;
+	it->second.range = UnknownRange();
+}
+
+// Walks back over ".xyz" and "[i]" to the variable an operator writes
+static int FindTarget(const std::vector<Token>& tokens, int op)
+{
+	int i = op - 1;
+	while (i >= 0)
+	{
+		if (tokens[i].text == "]")
+		{
+			int depth = 0;
+			for (; i >= 0; i--)
+			{
+				if (tokens[i].text == "]")
+					depth++;
+				else if (tokens[i].text == "[" && --depth == 0)
+					break;
+			}
+			i--;
+		}
+		else if (tokens[i].type == TOKEN_WORD && i > 0 && tokens[i - 1].text == ".")
+		{
+			i -= 2;
+		}
+		else
+		{
+			break;
+		}
+	}
+	return i >= 0 && tokens[i].type == TOKEN_WORD ? i : -1;
+}
+
+static void AnalyzePrecision(ShaderOptimizerPass& pass, ShaderStage stage, const ShaderOptimizeOptions* options,
+	ShaderVaryingRanges* varyings, ShaderOptimizeReport* report)
+{
+	std::vector<Token>& tokens = pass.tokens;
+	VariableMap vars;
+	std::vector<Assignment> assignments;
+	std::vector<bool> handled(tokens.size(), false);
+
+	// Every declaration: globals, locals and parameters
+	std::vector<Declaration> locals;
+	for (size_t f = 0; f < pass.functions.size(); f++)
+	{
+		const Function& function = pass.functions[f];
+		if (function.prototype)
+			continue;
+
+		std::vector<Statement> statements;
+		pass.ParseStatements(function.bodyBegin + 1, function.end, &statements);
+		for (size_t s = 0; s < statements.size(); s++)
+		{
+			Declaration decl;
+			if (pass.ParseDeclaration(statements[s].begin, statements[s].end, &decl))
+			{
+				locals.push_back(decl);
+				continue;
+			}
+
+			// "name[.xyz][i] op= expression;"
+			int i = statements[s].begin;
+			if (tokens[i].type != TOKEN_WORD)
+				continue;
+			int op = i + 1;
+			while (op < statements[s].end && (tokens[op].text == "." || tokens[op].text == "["))
+			{
+				if (tokens[op].text == ".")
+					op += 2;
+				else
+					op = pass.FindMatching(op) + 1;
+				if (op <= 0)
+					break;
+			}
+			if (op <= 0 || op >= statements[s].end || !IsOneOf(tokens[op].text, s_assignOps))
+				continue;
+
+			Assignment assignment;
+			assignment.target = tokens[i].text;
+			assignment.op = tokens[op].text;
+			assignment.exprBegin = op + 1;
+			assignment.exprEnd = statements[s].end;
+			assignments.push_back(assignment);
+			handled[op] = true;
+		}
+
+		// Parameters come from the caller
+		for (int i = function.paramsBegin + 1; i < function.bodyBegin; i++)
+		{
+			if (tokens[i].type == TOKEN_WORD && (tokens[i + 1].text == "," || tokens[i + 1].text == ")" || tokens[i + 1].text == "["))
+			{
+				Variable& var = vars[tokens[i].text];
+				var.range = UnknownRange();
+				var.computed = false;
+				var.floatType = false;
+				var.keepPrecision = true;
+				var.needsPrecision = false;
+			}
+		}
+	}
+
+	std::vector<const Declaration*> declarations;
+	for (size_t g = 0; g < pass.globals.size(); g++)
+		declarations.push_back(&pass.globals[g]);
+	for (size_t l = 0; l < locals.size(); l++)
+		declarations.push_back(&locals[l]);
+
+	for (size_t d = 0; d < declarations.size(); d++)
+	{
+		const Declaration& decl = *declarations[d];
+		for (size_t n = 0; n < decl.nameTokens.size(); n++)
+		{
+			const std::string& name = tokens[decl.nameTokens[n]].text;
+			bool isNew = vars.find(name) == vars.end();
+			Variable& var = vars[name];
+			if (isNew)
+			{
+				var.range = EmptyRange();
+				var.computed = true;
+				var.floatType = true;
+				var.keepPrecision = false;
+				var.needsPrecision = false;
+			}
+			var.declarations.push_back(&decl);
+			var.floatType = var.floatType && IsFloatType(tokens[decl.typeToken].text);
+
+			const std::string precision = decl.precisionToken >= 0 ? tokens[decl.precisionToken].text : std::string();
+			if (decl.storage == "uniform" || decl.storage == "attribute" || precision == "highp" || precision == "lowp")
+				var.keepPrecision = true;
+
+			// Uniforms and attributes are whatever the application sends; fragment varyings are what the vertex stage wrote
+			if (decl.storage == "uniform" || decl.storage == "attribute")
+			{
+				var.computed = false;
+				var.range = UnknownRange();
+			}
+			else if (decl.storage == "varying" && stage == SHADER_STAGE_FRAGMENT)
+			{
+				var.computed = false;
+				ShaderVaryingRanges::const_iterator it = varyings ? varyings->find(name) : ShaderVaryingRanges::const_iterator();
+				var.range = varyings && it != varyings->end() ? it->second : UnknownRange();
+			}
+
+			if (decl.initBegin[n] != decl.initEnd[n])
+			{
+				Assignment assignment;
+				assignment.target = name;
+				assignment.op = "=";
+				assignment.exprBegin = decl.initBegin[n];
+				assignment.exprEnd = decl.initEnd[n];
+				assignments.push_back(assignment);
+				handled[decl.initBegin[n] - 1] = true;
+			}
+		}
+	}
+
+	// Writes the statement scan did not see (for headers, nested assignments, ++, out parameters,
+	// macros) leave the variable unknown
+	std::set<std::string> directiveWords;
+	CollectDirectiveWords(tokens, &directiveWords);
+	for (std::set<std::string>::iterator it = directiveWords.begin(); it != directiveWords.end(); ++it)
+		MarkUnknown(vars, *it);
+
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		const Token& token = tokens[i];
+		if (token.type == TOKEN_PUNCT && IsOneOf(token.text, s_assignOps) && !handled[i])
+		{
+			int target = FindTarget(tokens, (int)i);
+			if (target >= 0)
+				MarkUnknown(vars, tokens[target].text);
+		}
+		else if (token.text == "++" || token.text == "--")
+		{
+			int target = FindTarget(tokens, (int)i);
+			if (target >= 0)
+				MarkUnknown(vars, tokens[target].text);
+			if (i + 1 < tokens.size() && tokens[i + 1].type == TOKEN_WORD)
+				MarkUnknown(vars, tokens[i + 1].text);
+		}
+		else if (token.type == TOKEN_WORD && i + 1 < tokens.size() && tokens[i + 1].text == "(" && pass.IsUserFunction(token.text) &&
+			!(i > 0 && tokens[i - 1].type == TOKEN_WORD))
+		{
+			int close = pass.FindMatching((int)i + 1);
+			for (int a = (int)i + 2; a < close; a++)
+			{
+				if (tokens[a].type == TOKEN_WORD && (tokens[a - 1].text == "(" || tokens[a - 1].text == ","))
+					MarkUnknown(vars, tokens[a].text);
+			}
+		}
+	}
+
+	// Grow every range until no assignment widens it any more
+	bool changed = true;
+	for (int round = 0; changed; round++)
+	{
+		changed = false;
+		for (size_t a = 0; a < assignments.size(); a++)
+		{
+			const Assignment& assignment = assignments[a];
+			VariableMap::iterator it = vars.find(assignment.target);
+			if (it == vars.end() || !it->second.computed)
+				continue;
+
+			Variable& var = it->second;
+			RangeEvaluator evaluator(pass, vars, assignment.exprBegin, assignment.exprEnd);
+			ShaderValueRange value = evaluator.Evaluate();
+			if (assignment.op == "+=")
+				value = Add(var.range, value);
+			else if (assignment.op == "-=")
+				value = Add(var.range, Negate(value));
+			else if (assignment.op == "*=")
+				value = Multiply(var.range, value);
+			else if (assignment.op == "/=")
+				value = Divide(var.range, value);
+			else if (assignment.op != "=")
+				value = UnknownRange();
+
+			ShaderValueRange grown = Hull(var.range, value);
+			if (grown.lo != var.range.lo || grown.hi != var.range.hi)
+			{
+				var.range = round >= RANGE_WIDEN_ROUND ? UnknownRange() : grown;
+				changed = true;
+			}
+		}
+	}
+
+	// Whatever flows into a texture coordinate needs its precision too. Macros can hide both reads
+	// and writes, so names used in directives are treated as coordinates as well.
+	std::set<std::string> texCoordNames;
+	CollectTextureCoordinates(pass, &texCoordNames);
+	CollectDirectiveWords(tokens, &texCoordNames);
+	for (std::set<std::string>::iterator it = texCoordNames.begin(); it != texCoordNames.end(); ++it)
+	{
+		VariableMap::iterator var = vars.find(*it);
+		if (var != vars.end())
+			var->second.needsPrecision = true;
+	}
+	changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (size_t a = 0; a < assignments.size(); a++)
+		{
+			VariableMap::iterator target = vars.find(assignments[a].target);
+			if (target == vars.end() || !target->second.needsPrecision)
+				continue;
+			for (int i = assignments[a].exprBegin; i < assignments[a].exprEnd; i++)
+			{
+				VariableMap::iterator source = tokens[i].type == TOKEN_WORD ? vars.find(tokens[i].text) : vars.end();
+				if (source != vars.end() && !source->second.needsPrecision)
+				{
+					source->second.needsPrecision = true;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	if (stage == SHADER_STAGE_VERTEX)
+	{
+		if (varyings == NULL)
+			return;
+		for (size_t g = 0; g < pass.globals.size(); g++)
+		{
+			const Declaration& decl = pass.globals[g];
+			if (decl.storage != "varying")
+				continue;
+			for (size_t n = 0; n < decl.nameTokens.size(); n++)
+			{
+				const std::string& name = tokens[decl.nameTokens[n]].text;
+				const ShaderValueRange& range = vars[name].range;
+				if (!IsEmpty(range) && range.lo > -INF && range.hi < INF)
+					(*varyings)[name] = range;
+				else
+					varyings->erase(name);
+			}
+		}
+		return;
+	}
+
+	std::set<std::string> candidates;
+	for (VariableMap::iterator it = vars.begin(); it != vars.end(); ++it)
+	{
+		const Variable& var = it->second;
+		if (var.floatType && !var.keepPrecision && !var.needsPrecision && !var.declarations.empty() &&
+			!IsEmpty(var.range) && var.range.lo > -LOWP_LIMIT && var.range.hi < LOWP_LIMIT)
+			candidates.insert(it->first);
+	}
+
+	for (std::set<std::string>::iterator it = candidates.begin(); it != candidates.end(); ++it)
+	{
+		const Variable& var = vars[*it];
+		const Token& nameToken = tokens[var.declarations[0]->nameTokens[0]];
+
+		// A declaration carries one precision for all its names, so all of them have to qualify
+		bool applied = options->applyPrecision;
+		for (size_t d = 0; d < var.declarations.size(); d++)
+		{
+			const Declaration& decl = *var.declarations[d];
+			for (size_t n = 0; n < decl.nameTokens.size(); n++)
+				applied = applied && candidates.count(tokens[decl.nameTokens[n]].text) != 0;
+		}
+
+		ShaderPrecisionChange change;
+		change.name = *it;
+		change.file = nameToken.file;
+		change.line = nameToken.line;
+		change.range = var.range;
+		change.applied = applied;
+		report->precision.push_back(change);
+	}
+
+	for (size_t c = 0; c < report->precision.size(); c++)
+	{
+		if (!report->precision[c].applied)
+			continue;
+
+		const Variable& var = vars[report->precision[c].name];
+		for (size_t d = 0; d < var.declarations.size(); d++)
+		{
+			const Declaration& decl = *var.declarations[d];
+			if (decl.precisionToken >= 0)
+				tokens[decl.precisionToken].text = "lowp";
+			else if (tokens[decl.typeToken].text.compare(0, 5, "lowp ") != 0)
+				tokens[decl.typeToken].text = "lowp " + tokens[decl.typeToken].text;
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+// Entry point
+// -----------------------------------------------------------------------------
+
+void GetDefaultShaderOptimizeOptions(ShaderOptimizeOptions* options)
+{
+	options->removeDeadCode = true;
+	options->applyPrecision = false;
+	options->minify = true;
+}
+
+bool OptimizeShader(const char* source, ShaderStage stage, const ShaderOptimizeOptions* options,
+	ShaderVaryingRanges* varyings, std::string* output, ShaderOptimizeReport* report)
+{
+	ShaderOptimizeOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultShaderOptimizeOptions(&defaults);
+		options = &defaults;
+	}
+
+	report->bytesIn = strlen(source);
+	report->bytesOut = 0;
+	report->removedFunctions.clear();
+	report->removedVariables.clear();
+	report->precision.clear();
+
+	ShaderOptimizerPass pass;
+	Tokenize(source, &pass.tokens);
+	if (!pass.Parse())
+		return false;
+
+	// Removing one thing can leave what it used unreferenced, so repeat until nothing changes
+	while (options->removeDeadCode && pass.RemoveDeadCode(report))
+	{
+		pass.Compact();
+		if (!pass.Parse())
+			return false;
+	}
+
+	AnalyzePrecision(pass, stage, options, varyings, report);
+
+	*output = WriteTokens(pass.tokens, options->minify);
+	report->bytesOut = output->size();
+	return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Offline GLSL ES 1.00 clean-up pass, used by the ShaderOptimize tool. Needs no GL context.
+
+enum ShaderStage
+{
+	SHADER_STAGE_VERTEX,
+	SHADER_STAGE_FRAGMENT,
+};
+
+struct ShaderOptimizeOptions
+{
+	bool	removeDeadCode;		// functions main never reaches, unreferenced globals and locals
+	bool	applyPrecision;		// write the lowp suggestions into the output instead of only reporting them
+	bool	minify;				// drop whitespace and #line directives; otherwise one statement per line
+};
+
+// Conservative bounds of a value over all of its components
+struct ShaderValueRange
+{
+	double	lo;
+	double	hi;
+};
+
+// Ranges of the varyings a vertex shader writes, handed on to its fragment shader
+typedef std::map<std::string, ShaderValueRange> ShaderVaryingRanges;
+
+struct ShaderPrecisionChange
+{
+	std::string			name;
+	int					file;		// source string number from #line directives, 0 without
+	int					line;
+	ShaderValueRange	range;
+	bool				applied;	// false when only suggested, or when the declaration also declares a variable that must keep its precision
+};
+
+struct ShaderOptimizeReport
+{
+	size_t								bytesIn;
+	size_t								bytesOut;
+	std::vector<std::string>			removedFunctions;
+	std::vector<std::string>			removedVariables;	// "name" for globals, "function:name" for locals
+	std::vector<ShaderPrecisionChange>	precision;
+};
+
+void GetDefaultShaderOptimizeOptions(ShaderOptimizeOptions* options);
+
+// Strips comments, optionally removes dead code, and finds fragment shader float variables that can
+// be lowp: every value written to them provably stays within lowp's guaranteed (-2, 2) range and
+// none of them feeds a texture coordinate. Texture reads are assumed to return normalized [0, 1]
+// values. Vertex shaders are never demoted; they record the ranges of the varyings they write into
+// varyings (may be NULL), and a fragment shader reads its varying ranges from there, so run the
+// vertex shader of a pair first.
+// source should be preprocessed (see PreprocessShader), otherwise functions only used by other
+// files look dead. Returns false when the source is not balanced.
+bool OptimizeShader(const char* source, ShaderStage stage, const ShaderOptimizeOptions* options /*NULL=defaults*/,
+	ShaderVaryingRanges* varyings, std::string* output, ShaderOptimizeReport* report);
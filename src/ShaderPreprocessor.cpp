@@ -0,0 +1,189 @@
+#include "ShaderPreprocessor.h"
+#include "ogles_sys.h"
+
+#include <stdio.h>
+#include <string.h>
+
+char* LoadShaderFile(const char* szFilePath)
+{
+	FILE * pf;
+	if (fopen_s(&pf, szFilePath, "rb") != 0)
+		return NULL;
+	fseek(pf, 0, SEEK_END);
+	long size = ftell(pf);
+	fseek(pf, 0, SEEK_SET);
+
+	char * shaderSrc = new char[size + 1];
+	fread(shaderSrc, sizeof(char), size, pf);
+	shaderSrc[size] = 0;
+	fclose(pf);
+
+	return shaderSrc;
+}
+
+static const char* SkipSpaces(const char* p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+// True when the line at p is "#<name> ...", p is then left right after the name
+static bool MatchDirective(const char*& p, const char* szName)
+{
+	const char* q = SkipSpaces(p);
+	if (*q != '#')
+		return false;
+	q = SkipSpaces(q + 1);
+
+	size_t length = strlen(szName);
+	if (strncmp(q, szName, length) != 0 || (q[length] != ' ' && q[length] != '\t' && q[length] != '"' && q[length] != '<'))
+		return false;
+	p = q + length;
+	return true;
+}
+
+// Directory part of a path including the trailing separator, empty for a bare file name
+static std::string GetDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static bool IsAbsolutePath(const std::string& path)
+{
+	return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+}
+
+static void AppendLineDirective(std::string* pText, int line, int fileIndex)
+{
+	char directive[32];
+	snprintf(directive, sizeof(directive), "#line %d %d\n", line, fileIndex);
+	*pText += directive;
+}
+
+static bool ExpandFile(const std::string& path, int depth, std::vector<std::string>* pStack, ShaderSource* source, std::string* pText)
+{
+	if (depth > MAX_SHADER_INCLUDE_DEPTH)
+	{
+		Debug("Shader preprocessor: includes nested deeper than %d at %s\n", MAX_SHADER_INCLUDE_DEPTH, path.c_str());
+		return false;
+	}
+
+	// Listed before it is read, so a missing include shows up in the file list of a failure
+	int fileIndex = (int)source->files.size();
+	source->files.push_back(path);
+
+	char* fileText = LoadShaderFile(path.c_str());
+	if (fileText == NULL)
+	{
+		Debug("Shader preprocessor: cannot read %s\n", path.c_str());
+		return false;
+	}
+
+	pStack->push_back(path);
+
+	bool ok = true;
+	int lineNumber = 1;
+	for (const char* pLine = fileText; *pLine && ok; lineNumber++)
+	{
+		const char* pEnd = strchr(pLine, '\n');
+		if (pEnd == NULL)
+			pEnd = pLine + strlen(pLine);
+
+		const char* p = pLine;
+		if (MatchDirective(p, "include"))
+		{
+			p = SkipSpaces(p);
+			char close = *p == '"' ? '"' : (*p == '<' ? '>' : 0);
+			const char* pNameEnd = close ? (const char*)memchr(p + 1, close, pEnd - p - 1) : NULL;
+			if (pNameEnd == NULL)
+			{
+				Debug("Shader preprocessor: %s(%d): malformed #include\n", path.c_str(), lineNumber);
+				ok = false;
+				break;
+			}
+
+			std::string name(p + 1, pNameEnd);
+			std::string includePath = IsAbsolutePath(name) ? name : GetDirectory(path) + name;
+
+			bool inStack = false, seen = false;
+			for (size_t i = 0; i < pStack->size(); i++)
+				inStack = inStack || (*pStack)[i] == includePath;
+			for (size_t i = 0; i < source->files.size(); i++)
+				seen = seen || source->files[i] == includePath;
+
+			if (inStack)
+			{
+				Debug("Shader preprocessor: %s(%d): %s includes itself\n", path.c_str(), lineNumber, includePath.c_str());
+				ok = false;
+			}
+			else if (!seen)
+			{
+				AppendLineDirective(pText, 1, (int)source->files.size());
+				ok = ExpandFile(includePath, depth + 1, pStack, source, pText);
+				AppendLineDirective(pText, lineNumber + 1, fileIndex);
+			}
+			else
+			{
+				// Keep the line count of the including file intact
+				*pText += '\n';
+			}
+		}
+		else
+		{
+			pText->append(pLine, pEnd);
+			*pText += '\n';
+		}
+
+		pLine = *pEnd ? pEnd + 1 : pEnd;
+	}
+
+	pStack->pop_back();
+	delete[] fileText;
+	return ok;
+}
+
+bool PreprocessShader(const char* szFilePath, const char* const* defines, int numDefines, ShaderSource* source)
+{
+	source->text.clear();
+	source->files.clear();
+
+	std::string body;
+	std::vector<std::string> stack;
+	if (!ExpandFile(szFilePath, 0, &stack, source, &body))
+		return false;
+
+	// #version has to stay the first line, so the defines go right after it
+	size_t bodyStart = 0;
+	int firstLine = 1;
+	const char* p = body.c_str();
+	while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+	{
+		if (*p == '\n')
+			firstLine++;
+		p++;
+	}
+	if (MatchDirective(p, "version"))
+	{
+		size_t lineEnd = body.find('\n', p - body.c_str());
+		bodyStart = lineEnd == std::string::npos ? body.size() : lineEnd + 1;
+		firstLine++;
+	}
+	else
+	{
+		firstLine = 1;
+	}
+
+	source->text.assign(body, 0, bodyStart);
+	for (int i = 0; i < numDefines; i++)
+	{
+		source->text += "#define ";
+		source->text += defines[i];
+		source->text += '\n';
+	}
+	if (numDefines > 0)
+		AppendLineDirective(&source->text, firstLine, 0);
+	source->text.append(body, bodyStart, std::string::npos);
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Maximum #include nesting, deeper chains are reported as errors
+const int MAX_SHADER_INCLUDE_DEPTH = 16;
+
+struct ShaderSource
+{
+	std::string					text;
+	std::vector<std::string>	files;	// the shader itself first, then every file it included; a file's
+										// index is its source string number in the #line directives
+};
+
+// Whole file as a NUL terminated string, delete[] when done. NULL if it cannot be read.
+char* LoadShaderFile(const char* szFilePath);
+
+// Loads szFilePath and expands every #include "file" (or <file>) relative to the including file.
+// A file that was already included is skipped, like #pragma once. Each define ("NAME" or
+// "NAME value") becomes a #define placed after the #version line if there is one, and #line
+// directives keep compiler messages pointing at the original files and lines.
+// defines may be NULL when numDefines is 0. Errors are logged through Debug. On failure files still
+// lists every file read so far plus the one that failed, so a fix to any of them can be noticed.
+bool PreprocessShader(const char* szFilePath, const char* const* defines, int numDefines, ShaderSource* source);
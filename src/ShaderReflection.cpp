@@ -0,0 +1,121 @@
+#include "ShaderReflection.h"
+
+#include <stdio.h>
+#include <string.h>
+
+const ShaderVariable* ShaderReflection::Table::Find(ShaderNameHash hash) const
+{
+	if (slots.empty())
+		return NULL;
+
+	// Linear probing; the table is at most half full, so the run ends quickly on an empty slot
+	size_t mask = slots.size() - 1;
+	for (size_t i = hash & mask;; i = (i + 1) & mask)
+	{
+		int index = slots[i];
+		if (index < 0)
+			return NULL;
+		if (variables[index].nameHash == hash)
+			return &variables[index];
+	}
+}
+
+void ShaderReflection::Table::Rebuild()
+{
+	size_t size = 8;
+	while (size < variables.size() * 2)
+		size *= 2;
+	slots.assign(size, -1);
+
+	size_t mask = size - 1;
+	for (size_t v = 0; v < variables.size(); v++)
+	{
+		size_t i = variables[v].nameHash & mask;
+		while (slots[i] >= 0)
+			i = (i + 1) & mask;
+		slots[i] = (int)v;
+	}
+}
+
+// Adds one variable unless its hash is taken; two names with the same hash need a rename
+static bool AddVariable(std::vector<ShaderVariable>* pVariables, const char* szName, GLint location, GLenum type, GLint size, GLint element)
+{
+	ShaderNameHash hash = HashShaderName(szName);
+	for (size_t i = 0; i < pVariables->size(); i++)
+	{
+		if ((*pVariables)[i].nameHash == hash)
+		{
+			Debug("ShaderReflection: %s has the same name hash as another variable and is skipped\n", szName);
+			return false;
+		}
+	}
+
+	ShaderVariable variable;
+	variable.nameHash = hash;
+	variable.location = location;
+	variable.type = type;
+	variable.size = size;
+	variable.element = element;
+	pVariables->push_back(variable);
+	return true;
+}
+
+void ShaderReflection::Build(GLuint program)
+{
+	Clear();
+
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+	// Room for the name plus a "[index]" suffix
+	std::vector<char> name(maxLength + 16);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(program, i, maxLength, &length, &size, &type, &name[0]);
+
+		// Arrays are reported as "name[0]"
+		char* bracket = strchr(&name[0], '[');
+		if (bracket)
+			*bracket = 0;
+
+		bool added = AddVariable(&uniforms.variables, &name[0], glGetUniformLocation(program, &name[0]), type, size, -1);
+		if (added && (size > 1 || bracket))
+		{
+			size_t baseLength = strlen(&name[0]);
+			for (GLint element = 0; element < size; element++)
+			{
+				snprintf(&name[baseLength], name.size() - baseLength, "[%d]", element);
+				AddVariable(&uniforms.variables, &name[0], glGetUniformLocation(program, &name[0]), type, 1, element);
+			}
+		}
+	}
+
+	count = 0;
+	maxLength = 0;
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(program, i, maxLength, &length, &size, &type, &name[0]);
+		AddVariable(&attributes.variables, &name[0], glGetAttribLocation(program, &name[0]), type, size, -1);
+	}
+
+	uniforms.Rebuild();
+	attributes.Rebuild();
+}
+
+void ShaderReflection::Clear()
+{
+	uniforms.variables.clear();
+	uniforms.slots.clear();
+	attributes.variables.clear();
+	attributes.slots.clear();
+}
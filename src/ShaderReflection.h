@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include <vector>
+
+typedef unsigned int ShaderNameHash;
+
+// 32-bit FNV-1a of a uniform or attribute name, evaluated by the compiler for string literals
+constexpr ShaderNameHash HashShaderName(const char* str, ShaderNameHash hash = 2166136261u)
+{
+	return *str ? HashShaderName(str + 1, (hash ^ (unsigned char)*str) * 16777619u) : hash;
+}
+
+// Forces the hash to be a compile-time constant, e.g. shader.GetUniformLocation(SHADER_NAME("u_mvp"))
+template <ShaderNameHash Hash>
+struct ShaderNameConstant
+{
+	static const ShaderNameHash value = Hash;
+};
+
+#define SHADER_NAME(str) (ShaderNameConstant<HashShaderName(str)>::value)
+
+struct ShaderVariable
+{
+	ShaderNameHash	nameHash;
+	GLint			location;
+	GLenum			type;		// GL_FLOAT_VEC4, GL_SAMPLER_2D, ...
+	GLint			size;		// array length, 1 for everything else
+	GLint			element;	// i for the "name[i]" entries of an array, -1 otherwise
+};
+
+// Every active uniform and attribute of a linked program, enumerated once with glGetActiveUniform /
+// glGetActiveAttrib and stored in flat open-addressed tables keyed by name hash, so the frame loop
+// never calls glGetUniformLocation. Arrays are reachable both as "name" (element 0, with size set)
+// and as "name[i]" for every element; the element entries directly follow their array.
+class ShaderReflection
+{
+public:
+	void Build(GLuint program);
+	void Clear();
+
+	// -1 when the program has no such active variable, like glGetUniformLocation
+	GLint GetUniformLocation(ShaderNameHash hash) const	{ const ShaderVariable* v = FindUniform(hash); return v ? v->location : -1; }
+	GLint GetAttribLocation(ShaderNameHash hash) const	{ const ShaderVariable* v = FindAttrib(hash); return v ? v->location : -1; }
+
+	const ShaderVariable* FindUniform(ShaderNameHash hash) const	{ return uniforms.Find(hash); }
+	const ShaderVariable* FindAttrib(ShaderNameHash hash) const		{ return attributes.Find(hash); }
+
+	// Position in GetUniform order, -1 if not found
+	int FindUniformIndex(ShaderNameHash hash) const		{ const ShaderVariable* v = FindUniform(hash); return v ? (int)(v - &uniforms.variables[0]) : -1; }
+
+	int GetUniformCount() const							{ return (int)uniforms.variables.size(); }
+	const ShaderVariable& GetUniform(int index) const	{ return uniforms.variables[index]; }
+	int GetAttribCount() const							{ return (int)attributes.variables.size(); }
+	const ShaderVariable& GetAttrib(int index) const	{ return attributes.variables[index]; }
+
+private:
+	struct Table
+	{
+		std::vector<ShaderVariable>	variables;
+		std::vector<int>			slots;		// index into variables, -1 = empty; size is a power of two
+
+		const ShaderVariable* Find(ShaderNameHash hash) const;
+		void Rebuild();
+	};
+
+	Table	uniforms;
+	Table	attributes;
+};
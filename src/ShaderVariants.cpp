@@ -0,0 +1,81 @@
+#include "ShaderVariants.h"
+
+#include <string.h>
+
+ShaderVariants::ShaderVariants()
+	: numFeatures(0)
+{
+	fileVS[0] = 0;
+	fileFS[0] = 0;
+}
+
+ShaderVariants::~ShaderVariants()
+{
+	Clear();
+}
+
+void ShaderVariants::Init(const char* vertexShaderFilePath, const char* fragmentShaderFilePath, const char* const* names, int count)
+{
+	Clear();
+
+	strncpy_s(fileVS, vertexShaderFilePath, _TRUNCATE);
+	strncpy_s(fileFS, fragmentShaderFilePath, _TRUNCATE);
+
+	numFeatures = count < MAX_SHADER_FEATURES ? count : MAX_SHADER_FEATURES;
+	for (int i = 0; i < numFeatures; i++)
+		featureNames[i] = names[i];
+}
+
+// Bits without a feature name would only create duplicates of the same program
+unsigned int ShaderVariants::MaskFeatures(unsigned int featureMask) const
+{
+	if (numFeatures < MAX_SHADER_FEATURES)
+		featureMask &= (1u << numFeatures) - 1;
+	return featureMask;
+}
+
+Shaders* ShaderVariants::GetVariant(unsigned int featureMask)
+{
+	featureMask = MaskFeatures(featureMask);
+
+	std::unordered_map<unsigned int, Shaders*>::iterator it = variants.find(featureMask);
+	if (it != variants.end())
+		return it->second;
+
+	std::string defineText[MAX_SHADER_FEATURES];
+	const char* defines[MAX_SHADER_FEATURES];
+	int numDefines = 0;
+	for (int i = 0; i < numFeatures; i++)
+	{
+		if (featureMask & (1u << i))
+		{
+			defineText[numDefines] = featureNames[i] + " 1";
+			defines[numDefines] = defineText[numDefines].c_str();
+			numDefines++;
+		}
+	}
+
+	Shaders* shaders = new Shaders();
+	if (shaders->Init(fileVS, fileFS, defines, numDefines) != 0)
+	{
+		Debug("ShaderVariants: variant 0x%x of %s / %s failed to build\n", featureMask, fileVS, fileFS);
+		delete shaders;
+		shaders = NULL;
+	}
+
+	variants[featureMask] = shaders;
+	return shaders;
+}
+
+bool ShaderVariants::IsCompiled(unsigned int featureMask) const
+{
+	std::unordered_map<unsigned int, Shaders*>::const_iterator it = variants.find(MaskFeatures(featureMask));
+	return it != variants.end() && it->second != NULL;
+}
+
+void ShaderVariants::Clear()
+{
+	for (std::unordered_map<unsigned int, Shaders*>::iterator it = variants.begin(); it != variants.end(); ++it)
+		delete it->second;
+	variants.clear();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Shaders.h"
+#include <string>
+#include <unordered_map>
+
+// Bits of a variant mask, one per feature
+const int MAX_SHADER_FEATURES = 32;
+
+// All permutations of one VS/FS pair. Feature i of the mask turns into "#define <name i> 1"; a
+// variant is preprocessed and compiled the first time it is asked for and kept until Clear, so
+// only the combinations materials actually use are ever compiled.
+class ShaderVariants
+{
+public:
+	ShaderVariants();
+	~ShaderVariants();
+
+	void Init(const char* vertexShaderFilePath, const char* fragmentShaderFilePath, const char* const* featureNames, int numFeatures);
+
+	// The compiled variant, or NULL if it failed to build (the failure is remembered too)
+	Shaders* GetVariant(unsigned int featureMask);
+
+	bool IsCompiled(unsigned int featureMask) const;
+	int GetVariantCount() const { return (int)variants.size(); }
+
+	void Clear();
+
+private:
+	unsigned int MaskFeatures(unsigned int featureMask) const;
+
+	char									fileVS[260];
+	char									fileFS[260];
+	std::string								featureNames[MAX_SHADER_FEATURES];
+	int										numFeatures;
+	std::unordered_map<unsigned int, Shaders*>	variants;
+};
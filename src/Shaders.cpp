@@ -1,137 +1,84 @@
 #include "Shaders.h"
+#include "ShaderCache.h"
+#include "ShaderPreprocessor.h"
+#include <string.h>
 
 
 Shaders::Shaders()
+	: program(0)
+	, vertexShader(0)
+	, fragmentShader(0)
+	, positionAttribute(-1)
+	, uniforms(NULL)
 {
+	fileVS[0] = 0;
+	fileFS[0] = 0;
 }
 
 GLint Shaders::Init(char* fileVertexShader, char* fileFragmentShader)
 {
-	vertexShader = LoadShader(GL_VERTEX_SHADER, fileVertexShader);
+	return Init(fileVertexShader, fileFragmentShader, NULL, 0);
+}
 
-	if (vertexShader == 0)
+GLint Shaders::Init(char* fileVertexShader, char* fileFragmentShader, const char* const* defines, int numDefines)
+{
+	strncpy_s(fileVS, fileVertexShader, _TRUNCATE);
+	strncpy_s(fileFS, fileFragmentShader, _TRUNCATE);
+
+	this->defines.assign(defines, defines + numDefines);
+	files.clear();
+	files.push_back(fileVS);
+	files.push_back(fileFS);
+
+	ShaderSource vsSource, fsSource;
+	bool vsOk = PreprocessShader(fileVertexShader, defines, numDefines, &vsSource);
+	bool fsOk = PreprocessShader(fileFragmentShader, defines, numDefines, &fsSource);
+
+	// Includes after the stage itself, the stages are already in the list. Also kept when
+	// preprocessing failed, a broken or missing include is what gets fixed next.
+	if (vsSource.files.size() > 1)
+		files.insert(files.end(), vsSource.files.begin() + 1, vsSource.files.end());
+	if (fsSource.files.size() > 1)
+		files.insert(files.end(), fsSource.files.begin() + 1, fsSource.files.end());
+
+	if (!vsOk)
 		return -1;
 
-	fragmentShader = LoadShader(GL_FRAGMENT_SHADER, fileFragmentShader);
-
-	if (fragmentShader == 0)
-	{
-		glDeleteShader(vertexShader);
+	if (!fsOk)
 		return -2;
-	}
 
-	program = LoadProgram(vertexShader, fragmentShader);
+	// A pair another instance already built is only a hash lookup
+	CachedProgram cached;
+	GLint result = AcquireProgram(vsSource.text.c_str(), fsSource.text.c_str(), &cached);
 
-	//finding location of uniforms / attributes
-	positionAttribute = glGetAttribLocation(program, "a_posL");
+	if (result != 0)
+		return result;
 
+	SwapProgram(cached);
 	return 0;
 }
 
-GLuint Shaders::LoadShader(uint type, char* filePath)
+void Shaders::SwapProgram(const CachedProgram& cached)
 {
-	GLuint shader;
-	GLint compiled;
-
-	// Create the shader object
-	shader = glCreateShader(type);
-
-	if (shader == 0)
-		return 0;
-
-	// Load the shader source
-	FILE * pf;
-	if (fopen_s(&pf, filePath, "rb") != 0)
-		return NULL;
-	fseek(pf, 0, SEEK_END);
-	long size = ftell(pf);
-	fseek(pf, 0, SEEK_SET);
-
-	char * shaderSrc = new char[size + 1];
-	fread(shaderSrc, sizeof(char), size, pf);
-	shaderSrc[size] = 0;
-	fclose(pf);
-
-	glShaderSource(shader, 1, (const char **)&shaderSrc, NULL);
-	delete[] shaderSrc;
-
-	// Compile the shader
-	glCompileShader(shader);
-
-	// Check the compile status
-	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-
-	if (!compiled)
-	{
-		GLint infoLen = 0;
-
-		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &infoLen);
-
-		if (infoLen > 1)
-		{
-			char* infoLog = new char[infoLen];
-
-
-			glGetShaderInfoLog(shader, infoLen, NULL, infoLog);
-			Debug("Error compiling shader:\n%s\n", infoLog);
+	if (program != 0)
+		ReleaseProgram(program);
+	program = cached.program;
+	vertexShader = cached.vertexShader;
+	fragmentShader = cached.fragmentShader;
 
-			delete[] infoLog;
-		}
-
-		glDeleteShader(shader);
-		return 0;
-	}
-
-	return shader;
+	//finding location of uniforms / attributes
+	reflection.Build(program);
+	uniforms = GetProgramUniforms(program, reflection);
+	positionAttribute = reflection.GetAttribLocation(SHADER_NAME("a_posL"));
 }
 
-GLuint Shaders::LoadProgram(uint vertexShader, uint fragmentShader)
+char* Shaders::LoadShaderSource(const char* filePath)
 {
-	GLuint programObject;
-	GLint linked;
-
-	// Create the program object
-	programObject = glCreateProgram();
-
-	if (programObject == 0)
-		return 0;
-
-	glAttachShader(programObject, vertexShader);
-	glAttachShader(programObject, fragmentShader);
-
-	// Link the program
-	glLinkProgram(programObject);
-
-	// Check the link status
-	glGetProgramiv(programObject, GL_LINK_STATUS, &linked);
-
-	if (!linked)
-	{
-		GLint infoLen = 0;
-
-		glGetProgramiv(programObject, GL_INFO_LOG_LENGTH, &infoLen);
-
-		if (infoLen > 1)
-		{
-			char* infoLog = new char[sizeof(char) * infoLen];
-
-
-			glGetProgramInfoLog(programObject, infoLen, NULL, infoLog);
-			Debug("Error linking program:\n%s\n", infoLog);
-
-			delete infoLog;
-		}
-
-		glDeleteProgram(programObject);
-		return 0;
-	}
-
-	return programObject;
+	return LoadShaderFile(filePath);
 }
 
 Shaders::~Shaders()
 {
-	glDeleteProgram(program);
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+	if (program != 0)
+		ReleaseProgram(program);
 }
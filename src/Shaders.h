@@ -1,26 +1,53 @@
 #pragma once
 
 #include "ogles_sys.h"
+#include "ShaderCache.h"
+#include "ShaderReflection.h"
+#include "UniformStaging.h"
 #include <glm.hpp>
 #include <stdio.h>
+#include <string>
+#include <vector>
 
 using namespace glm;
 
 class Shaders
 {
 public:
+	// Shared through the program cache, owned by it
 	GLuint program, vertexShader, fragmentShader;
 	char fileVS[260];
 	char fileFS[260];
 	GLint positionAttribute;
 
+	// Active uniforms and attributes by name hash, rebuilt by Init
+	ShaderReflection reflection;
+
+	// Last values sent to program, shared with every Shaders using the same program.
+	// Set uniforms through it and call uniforms->Apply() after glUseProgram.
+	UniformStaging* uniforms;
+
+	// What the last Init was given and read, so the program can be rebuilt when a file changes:
+	// the defines, and both stages plus every file they included
+	std::vector<std::string> defines;
+	std::vector<std::string> files;
+
 	Shaders();
 	~Shaders();
 
 	GLint Init(char* vertexShaderFilePath, char* fragmentShaderFilePath);
 
-private:
-	GLuint LoadShader(GLuint type, char* filePath);
-	GLuint LoadProgram(GLuint vertexShader, GLuint fragmentShader);
+	// Both stages are run through PreprocessShader with the given defines ("NAME" or "NAME value")
+	GLint Init(char* vertexShaderFilePath, char* fragmentShaderFilePath, const char* const* defines, int numDefines);
+
+	// Replaces the program with one the caller holds a cache reference to, which Shaders takes over
+	void SwapProgram(const CachedProgram& cached);
+
+	// Hashed lookups for the frame loop, e.g. GetUniformLocation(SHADER_NAME("u_mvp"))
+	GLint GetUniformLocation(ShaderNameHash name) const	{ return reflection.GetUniformLocation(name); }
+	GLint GetAttribLocation(ShaderNameHash name) const	{ return reflection.GetAttribLocation(name); }
+
+	// Whole file as a NUL terminated string, delete[] when done. NULL if it cannot be read.
+	static char* LoadShaderSource(const char* filePath);
 };
 
@@ -1,167 +1,409 @@
 
 #include "TGA.h"
+#include "TGAFormat.h"
+#include "TGASwizzle.h"
+#include "FileMap.h"
+#include "Parallel.h"
 #include <stdio.h>
+#include <string.h>
 
-#pragma pack(push,x1)					// Byte alignment (8-bit)
-#pragma pack(1)
-
-typedef struct
+// Where a row starts in the RLE stream: the packet covering its first pixel, and how
+// many pixels of that packet belong to the rows before it.
+struct TGA_ROW_START
 {
-    unsigned char  identsize;			// size of ID field that follows 18 byte header (0 usually)
-    unsigned char  colourmaptype;		// type of colour map 0=none, 1=has palette
-    unsigned char  imagetype;			// type of image 2=rgb uncompressed, 10 - rgb rle compressed
-
-    short colourmapstart;				// first colour map entry in palette
-    short colourmaplength;				// number of colours in palette
-    unsigned char  colourmapbits;		// number of bits per palette entry 15,16,24,32
+    const char * pPacket;
+    int skip;
+};
 
-    short xstart;						// image x origin
-    short ystart;						// image y origin
-    short width;						// image width in pixels
-    short height;						// image height in pixels
-    unsigned char  bits;				// image bits per pixel 24,32
-    unsigned char  descriptor;			// image descriptor bits (vh flip bits)
-
-    // pixel data follows header
+struct TGA_RLE_JOB
+{
+    char * pDest;
+    int destPitch;
+    const TGA_ROW_START * pRowStarts;
+    TGA_HEADER * pHeader;
+    const TGAPixelFormat * pFormat;
+};
 
-} TGA_HEADER;
+// Per thread, so a pool of loader threads does not start a full set of decode threads each
+static thread_local int s_numDecodeThreads = 0;
 
-#pragma pack(pop,x1)
+// Below this many pixels the thread start-up costs more than the decode
+const int MIN_PARALLEL_RLE_PIXELS = 256 * 256;
 
-const int IT_COMPRESSED = 10;
-const int IT_UNCOMPRESSED = 2;
+void SetTGADecodeThreads( int numThreads )
+{
+    s_numDecodeThreads = numThreads;
+}
 
-void LoadCompressedImage( char* pDest, char * pSrc, TGA_HEADER * pHeader )
+// First pass: walks the packet headers only, checks that the stream is complete and
+// records the packet position at the start of every row.
+static bool IndexCompressedRows( TGA_ROW_START * pRowStarts, const char * pSrc, const char * pSrcEnd, TGA_HEADER * pHeader )
 {
     int w = pHeader->width;
     int h = pHeader->height;
-    int rowSize = w * pHeader->bits / 8;
-    bool bInverted = ( (pHeader->descriptor & (1 << 5)) != 0 );
-    char * pDestPtr = bInverted ? pDest + (h + 1) * rowSize : pDest;
-    int countPixels = 0;
+    int pixelSize = ( pHeader->bits + 7 ) >> 3;
     int nPixels = w * h;
+    int countPixels = 0;
+    int row = 0;
 
     while( nPixels > countPixels )
     {
-        unsigned char chunk = *pSrc ++;
-        if ( chunk < 128 )
+        if ( pSrc >= pSrcEnd )
+            return false;
+        unsigned char chunk = *pSrc;
+        int chunkSize = ( chunk & 127 ) + 1;
+        int dataSize = chunk < 128 ? chunkSize * pixelSize : pixelSize;
+        if ( chunkSize > nPixels - countPixels || pSrcEnd - pSrc - 1 < dataSize )
+            return false;
+
+        // Every row that starts inside this packet
+        while ( row < h && row * w < countPixels + chunkSize )
         {
-            int chunkSize = chunk + 1;
-            for ( int i = 0; i < chunkSize; i ++ )
-            {
-                if ( bInverted && (countPixels % w) == 0 )
-                    pDestPtr -= 2 * rowSize;
-                *pDestPtr ++ = pSrc[2];
-                *pDestPtr ++ = pSrc[1];
-                *pDestPtr ++ = pSrc[0];
-                pSrc += 3;
-                if ( pHeader->bits != 24 )
-                    *pDestPtr ++ = *pSrc ++;
-                countPixels ++;
-            }
+            pRowStarts[row].pPacket = pSrc;
+            pRowStarts[row].skip = row * w - countPixels;
+            row ++;
         }
-        else
+
+        countPixels += chunkSize;
+        pSrc += 1 + dataSize;
+    }
+    return true;
+}
+
+// Second pass: decodes rows [rowBegin, rowEnd). The stream was validated by the index pass.
+static void DecodeCompressedRows( void * pUserData, int rowBegin, int rowEnd )
+{
+    TGA_RLE_JOB * pJob = (TGA_RLE_JOB *)pUserData;
+    int w = pJob->pHeader->width;
+    int h = pJob->pHeader->height;
+    int srcSize = pJob->pFormat->srcSize;
+    int dstSize = pJob->pFormat->dstSize;
+    bool bInverted = ( (pJob->pHeader->descriptor & (1 << 5)) != 0 );
+    const char * pPacket = pJob->pRowStarts[rowBegin].pPacket;
+    int skip = pJob->pRowStarts[rowBegin].skip;
+
+    for ( int row = rowBegin; row < rowEnd; row ++ )
+    {
+        char * pDest = pJob->pDest + (size_t)( bInverted ? h - row - 1 : row ) * pJob->destPitch;
+        int x = 0;
+        while ( x < w )
         {
-            int chunkSize = chunk - 127;
-            for ( int i = 0; i < chunkSize; i ++ )
+            unsigned char chunk = *pPacket;
+            int chunkSize = ( chunk & 127 ) + 1;
+            int count = chunkSize - skip;
+            if ( count > w - x )
+                count = w - x;
+
+            if ( chunk < 128 )
+            {
+                ConvertTGAPixels( pJob->pFormat, pDest, pPacket + 1 + skip * srcSize, count );
+                pDest += count * dstSize;
+            }
+            else
             {
-                if ( bInverted && (countPixels % w) == 0 )
-                    pDestPtr -= 2 * rowSize;
-                *pDestPtr ++ = pSrc[2];
-                *pDestPtr ++ = pSrc[1];
-                *pDestPtr ++ = pSrc[0];
-                if ( pHeader->bits != 24 )
-                    *pDestPtr ++ = pSrc[3];
-                countPixels ++;
+                char pixel[4];
+                ConvertTGAPixels( pJob->pFormat, pixel, pPacket + 1, 1 );
+                for ( int i = 0; i < count; i ++ )
+                {
+                    memcpy( pDest, pixel, dstSize );
+                    pDest += dstSize;
+                }
+            }
+
+            x += count;
+            skip += count;
+            if ( skip == chunkSize )
+            {
+                pPacket += 1 + ( chunk < 128 ? chunkSize * srcSize : srcSize );
+                skip = 0;
             }
-            pSrc += (pHeader->bits >> 3);
         }
     }
 }
 
-void LoadUncompressedImage( char* pDest, char * pSrc, TGA_HEADER * pHeader )
+// Packets may run across row boundaries, so the rows are indexed first and then
+// decoded independently, in parallel for large images.
+bool LoadCompressedImage( char* pDest, int destPitch, const char * pSrc, const char * pSrcEnd, TGA_HEADER * pHeader, const TGAPixelFormat * pFormat )
 {
     int w = pHeader->width;
     int h = pHeader->height;
-    int rowSize = w * pHeader->bits / 8;
+
+    TGA_ROW_START * pRowStarts = new TGA_ROW_START[h];
+    if ( !IndexCompressedRows( pRowStarts, pSrc, pSrcEnd, pHeader ) )
+    {
+        delete[] pRowStarts;
+        return false;
+    }
+
+    TGA_RLE_JOB job;
+    job.pDest = pDest;
+    job.destPitch = destPitch;
+    job.pRowStarts = pRowStarts;
+    job.pHeader = pHeader;
+    job.pFormat = pFormat;
+
+    int numThreads = ( w * h < MIN_PARALLEL_RLE_PIXELS ) ? 1 : s_numDecodeThreads;
+    ParallelFor( h, numThreads, DecodeCompressedRows, &job );
+
+    delete[] pRowStarts;
+    return true;
+}
+
+void LoadUncompressedImage( char* pDest, int destPitch, const char * pSrc, TGA_HEADER * pHeader, const TGAPixelFormat * pFormat )
+{
+    int w = pHeader->width;
+    int h = pHeader->height;
+    int rowSize = w * pFormat->srcSize;
     bool bInverted = ( (pHeader->descriptor & (1 << 5)) != 0 );
     for ( int i = 0; i < h; i ++ )
     {
-        char * pSrcRow = pSrc + 
+        const char * pSrcRow = pSrc + 
             ( bInverted ? ( h - i - 1 ) * rowSize : i * rowSize );
-        if ( pHeader->bits == 24 )
+        ConvertTGAPixels( pFormat, pDest, pSrcRow, w );
+        pDest += destPitch;
+    }
+}
+
+static bool IsTGAColourMapped( const TGA_HEADER * pHeader )
+{
+    return pHeader->imagetype == IT_COLOURMAPPED || pHeader->imagetype == IT_COLOURMAPPED_COMPRESSED;
+}
+
+static bool IsTGAPixelBits( int bits )
+{
+    return bits == 15 || bits == 16 || bits == 24 || bits == 32;
+}
+
+bool ParseTGAHeader( const char * pData, TGA_HEADER * pHeader )
+{
+    memcpy( pHeader, pData, sizeof( TGA_HEADER ) );
+
+    if ( IsTGAColourMapped( pHeader ) )
+    {
+        // 8 bit indices into a palette of truecolour entries
+        if ( pHeader->colourmaptype != 1 || pHeader->bits != 8 || !IsTGAPixelBits( pHeader->colourmapbits ) ||
+             pHeader->colourmapstart < 0 || pHeader->colourmaplength <= 0 )
+            return false;
+    }
+    else
+    {
+        if ( pHeader->imagetype != IT_COMPRESSED && pHeader->imagetype != IT_UNCOMPRESSED )
+            return false;
+
+        if ( !IsTGAPixelBits( pHeader->bits ) )
+            return false;
+
+        // A truecolour image may still carry a palette, which is skipped
+        if ( pHeader->colourmaptype == 1 && ( pHeader->colourmaplength < 0 || pHeader->colourmapbits > 32 ) )
+            return false;
+    }
+
+    return pHeader->width > 0 && pHeader->height > 0;
+}
+
+size_t GetTGAColourMapSize( const TGA_HEADER * pHeader )
+{
+    if ( pHeader->colourmaptype != 1 )
+        return 0;
+    return (size_t)pHeader->colourmaplength * ( ( pHeader->colourmapbits + 7 ) >> 3 );
+}
+
+int GetTGAOutputBits( const TGA_HEADER * pHeader )
+{
+    int bits = IsTGAColourMapped( pHeader ) ? pHeader->colourmapbits : pHeader->bits;
+    int alphaBits = pHeader->descriptor & 0xF;
+    if ( bits == 32 || ( bits == 16 && alphaBits > 0 ) )
+        return 32;
+    return 24;
+}
+
+// 15/16 bit pixels are little-endian ARRRRRGG GGGBBBBB; the 5 bit channels are widened by
+// replicating their top bits so that 31 maps to 255
+static void ExpandTGA16( unsigned char * pDest, const unsigned char * pSrc, int dstSize )
+{
+    unsigned int c = pSrc[0] | ( pSrc[1] << 8 );
+    unsigned int r = ( c >> 10 ) & 31;
+    unsigned int g = ( c >> 5 ) & 31;
+    unsigned int b = c & 31;
+    pDest[0] = (unsigned char)( ( r << 3 ) | ( r >> 2 ) );
+    pDest[1] = (unsigned char)( ( g << 3 ) | ( g >> 2 ) );
+    pDest[2] = (unsigned char)( ( b << 3 ) | ( b >> 2 ) );
+    if ( dstSize == 4 )
+        pDest[3] = ( c & 0x8000 ) ? 255 : 0;
+}
+
+void InitTGAPixelFormat( TGAPixelFormat * pFormat, const TGA_HEADER * pHeader, const char * pColourMap )
+{
+    memset( pFormat, 0, sizeof( TGAPixelFormat ) );
+    pFormat->srcSize = ( pHeader->bits + 7 ) >> 3;
+    pFormat->dstSize = GetTGAOutputBits( pHeader ) >> 3;
+    if ( pFormat->srcSize >= 3 )
+        pFormat->swizzleRow = GetTGASwizzleRowFunc( pHeader->bits );
+
+    if ( !IsTGAColourMapped( pHeader ) || pColourMap == NULL )
+        return;
+
+    // Indices outside the stored entries stay transparent black
+    int entrySize = ( pHeader->colourmapbits + 7 ) >> 3;
+    const unsigned char * pEntry = (const unsigned char *)pColourMap;
+    for ( int i = 0; i < pHeader->colourmaplength; i ++, pEntry += entrySize )
+    {
+        int index = pHeader->colourmapstart + i;
+        if ( index > 255 )
+            break;
+
+        unsigned char * pDest = pFormat->palette[index];
+        if ( entrySize == 2 )
         {
-            for ( int j = 0; j < w; j ++ )
-            {
-                *pDest ++ = pSrcRow[2];
-                *pDest ++ = pSrcRow[1];
-                *pDest ++ = pSrcRow[0];
-                pSrcRow += 3;
-            }
+            ExpandTGA16( pDest, pEntry, pFormat->dstSize );
         }
         else
         {
-            for ( int j = 0; j < w; j ++ )
-            {
-                *pDest ++ = pSrcRow[2];
-                *pDest ++ = pSrcRow[1];
-                *pDest ++ = pSrcRow[0];
-                *pDest ++ = pSrcRow[3];
-                pSrcRow += 4;
-            }
+            pDest[0] = pEntry[2];
+            pDest[1] = pEntry[1];
+            pDest[2] = pEntry[0];
+            pDest[3] = entrySize == 4 ? pEntry[3] : 255;
         }
     }
 }
 
+void ConvertTGAPixels( const TGAPixelFormat * pFormat, char * pDest, const char * pSrc, int nPixels )
+{
+    const unsigned char * pIn = (const unsigned char *)pSrc;
+    switch ( pFormat->srcSize )
+    {
+    case 1:
+        for ( int i = 0; i < nPixels; i ++ )
+        {
+            memcpy( pDest, pFormat->palette[pIn[i]], pFormat->dstSize );
+            pDest += pFormat->dstSize;
+        }
+        break;
+    case 2:
+        for ( int i = 0; i < nPixels; i ++ )
+        {
+            ExpandTGA16( (unsigned char *)pDest, pIn + i * 2, pFormat->dstSize );
+            pDest += pFormat->dstSize;
+        }
+        break;
+    default:
+        pFormat->swizzleRow( pDest, pSrc, nPixels );
+        break;
+    }
+}
 
-char * LoadTGA( const char * szFileName, int * width, int * height, int * bpp )
+// Checks the header of a mapped file and returns where the image data starts
+static bool ReadTGAHeader( const FileMap * pFile, TGA_HEADER * pHeader, const char ** ppData )
 {
-    
-    FILE * f;
-	
-	if (fopen_s(&f, szFileName, "rb" ) != 0)
-        return NULL;
+    if ( pFile->size < sizeof( TGA_HEADER ) || !ParseTGAHeader( pFile->data, pHeader ) )
+        return false;
 
-    TGA_HEADER header;
-    fread( &header, sizeof(header), 1, f );
+    size_t dataOffset = sizeof( TGA_HEADER ) + pHeader->identsize + GetTGAColourMapSize( pHeader );
+    size_t imageSize = (size_t)pHeader->width * pHeader->height * ( ( pHeader->bits + 7 ) >> 3 );
+    if ( pFile->size < dataOffset ||
+         ( !IsTGACompressed( pHeader ) && pFile->size - dataOffset < imageSize ) )
+        return false;
+
+    *ppData = pFile->data + dataOffset;
+    return true;
+}
+
+static bool DecodeTGA( char * pDest, int destPitch, const FileMap * pFile, TGA_HEADER * pHeader, const char * pSrc )
+{
+    // The palette sits right before the pixel data
+    TGAPixelFormat format;
+    InitTGAPixelFormat( &format, pHeader, pSrc - GetTGAColourMapSize( pHeader ) );
+
+    if ( IsTGACompressed( pHeader ) )
+        return LoadCompressedImage( pDest, destPitch, pSrc, pFile->data + pFile->size, pHeader, &format );
+
+    LoadUncompressedImage( pDest, destPitch, pSrc, pHeader, &format );
+    return true;
+}
 
-    fseek( f, 0, SEEK_END );
-    int fileLen = ftell( f );
-    fseek( f, sizeof( header ) + header.identsize, SEEK_SET );
+static int GetTGARowPitch( int width, int bpp, int alignment )
+{
+    int rowSize = width * bpp / 8;
+    if ( alignment <= 1 )
+        return rowSize;
+    return ( rowSize + alignment - 1 ) / alignment * alignment;
+}
 
-    if ( header.imagetype != IT_COMPRESSED && header.imagetype != IT_UNCOMPRESSED )
+
+// Decodes straight from the mapped file into the output buffer, so the only
+// full-size allocation is the one returned to the caller.
+char * LoadTGA( const char * szFileName, int * width, int * height, int * pBpp )
+{
+    FileMap file;
+    if ( !MapFile( szFileName, &file ) )
+        return NULL;
+
+    TGA_HEADER header;
+    const char * pSrc;
+    if ( !ReadTGAHeader( &file, &header, &pSrc ) )
     {
-        fclose( f );
+        UnmapFile( &file );
         return NULL;
     }
 
-    if ( header.bits != 24 && header.bits != 32 )
+    int bpp = GetTGAOutputBits( &header );
+    int rowSize = header.width * bpp / 8;
+    char * pOutBuffer = new char[ (size_t)rowSize * header.height ];
+    bool bDecoded = DecodeTGA( pOutBuffer, rowSize, &file, &header, pSrc );
+
+    UnmapFile( &file );
+
+    if ( !bDecoded )
     {
-        fclose( f );
+        delete[] pOutBuffer;
         return NULL;
     }
 
-    int bufferSize = fileLen - sizeof( header ) - header.identsize;
-    char * pBuffer = new char[bufferSize];
-    fread( pBuffer, 1, bufferSize, f );
-    fclose( f );
-
     *width = header.width;
     *height = header.height;
-    *bpp = header.bits;
-    char * pOutBuffer = new char[ header.width * header.height * header.bits / 8 ];
+    *pBpp = bpp;
+    return pOutBuffer;
+}
+
+bool GetTGAInfo( const char * szFileName, int alignment, TGAInfo * pInfo )
+{
+    FileMap file;
+    if ( !MapFile( szFileName, &file ) )
+        return false;
+
+    TGA_HEADER header;
+    const char * pSrc;
+    bool bValid = ReadTGAHeader( &file, &header, &pSrc );
+    UnmapFile( &file );
+
+    if ( !bValid )
+        return false;
+
+    pInfo->width = header.width;
+    pInfo->height = header.height;
+    pInfo->bpp = GetTGAOutputBits( &header );
+    pInfo->rowPitch = GetTGARowPitch( header.width, pInfo->bpp, alignment );
+    pInfo->size = (size_t)pInfo->rowPitch * header.height;
+    return true;
+}
 
-    switch( header.imagetype )
+bool LoadTGAInto( const char * szFileName, char * pDest, size_t destSize, int rowPitch )
+{
+    FileMap file;
+    if ( !MapFile( szFileName, &file ) )
+        return false;
+
+    TGA_HEADER header;
+    const char * pSrc;
+    if ( !ReadTGAHeader( &file, &header, &pSrc ) ||
+         rowPitch < header.width * GetTGAOutputBits( &header ) / 8 ||
+         destSize < (size_t)rowPitch * header.height )
     {
-    case IT_UNCOMPRESSED:
-        LoadUncompressedImage( pOutBuffer, pBuffer, &header );
-        break;
-    case IT_COMPRESSED:
-        LoadCompressedImage( pOutBuffer, pBuffer, &header );
-        break;
+        UnmapFile( &file );
+        return false;
     }
 
-    delete[] pBuffer;
-
-    return pOutBuffer;
+    bool bDecoded = DecodeTGA( pDest, rowPitch, &file, &header, pSrc );
+    UnmapFile( &file );
+    return bDecoded;
 }
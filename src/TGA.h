@@ -1,3 +1,28 @@
 #pragma once
 
+#include <stddef.h>
+
+struct TGAInfo
+{
+    int width;
+    int height;
+    int bpp;            // bits per pixel of the decoded image, 24 (RGB) or 32 (RGBA)
+    int rowPitch;       // bytes from one row to the next in the destination
+    size_t size;        // bytes LoadTGAInto needs for rowPitch * height
+};
+
 char * LoadTGA( const char * szFileName, int * width, int * height, int * bpp );
+
+// Reads only the header and reports the buffer layout LoadTGAInto needs when every row starts
+// on an alignment byte boundary (use the same value as GL_UNPACK_ALIGNMENT, 1 = tightly packed).
+bool GetTGAInfo( const char * szFileName, int alignment, TGAInfo * pInfo );
+
+// Decodes into a caller-owned buffer, e.g. a staging arena or a buffer mapped through
+// GL_OES_mapbuffer. Rows are rowPitch bytes apart; padding bytes are left untouched.
+// Fails if the buffer is too small for rowPitch * height.
+bool LoadTGAInto( const char * szFileName, char * pDest, size_t destSize, int rowPitch );
+
+// Number of threads used to decode large RLE compressed images loaded from the calling thread,
+// 0 = one per hardware thread (the default). Threads that already run one load each, like a
+// loader pool, should set 1.
+void SetTGADecodeThreads( int numThreads );
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "TGASwizzle.h"
+#include <stddef.h>
+
+// On-disk TGA layout shared by the TGA decoders
+
+#pragma pack(push,x1)					// Byte alignment (8-bit)
+#pragma pack(1)
+
+typedef struct
+{
+    unsigned char  identsize;			// size of ID field that follows 18 byte header (0 usually)
+    unsigned char  colourmaptype;		// type of colour map 0=none, 1=has palette
+    unsigned char  imagetype;			// type of image 1/9=colour mapped, 2/10=rgb (uncompressed/rle compressed)
+
+    short colourmapstart;				// first colour map entry in palette
+    short colourmaplength;				// number of colours in palette
+    unsigned char  colourmapbits;		// number of bits per palette entry 15,16,24,32
+
+    short xstart;						// image x origin
+    short ystart;						// image y origin
+    short width;						// image width in pixels
+    short height;						// image height in pixels
+    unsigned char  bits;				// image bits per pixel 8 (colour mapped),15,16,24,32
+    unsigned char  descriptor;			// image descriptor bits (vh flip bits, low 4 bits = alpha bits)
+
+    // pixel data follows header
+
+} TGA_HEADER;
+
+#pragma pack(pop,x1)
+
+const int IT_COMPRESSED = 10;
+const int IT_UNCOMPRESSED = 2;
+const int IT_COLOURMAPPED_COMPRESSED = 9;
+const int IT_COLOURMAPPED = 1;
+
+// Turns stored pixels (palette indices, 15/16 bit ARGB1555 or BGR(A)) into RGB(A) output pixels
+struct TGAPixelFormat
+{
+    int srcSize;                        // bytes per stored pixel, 1 to 4
+    int dstSize;                        // bytes per output pixel, 3 or 4
+    TGASwizzleRowFunc swizzleRow;       // 24/32 bit sources
+    unsigned char palette[256][4];      // colour mapped sources, already in output order
+};
+
+// Copies the 18 byte header at pData into pHeader and checks that it is an image we can
+// decode. The caller guarantees sizeof(TGA_HEADER) readable bytes.
+bool ParseTGAHeader( const char * pData, TGA_HEADER * pHeader );
+
+inline bool IsTGACompressed( const TGA_HEADER * pHeader )
+{
+    return pHeader->imagetype == IT_COMPRESSED || pHeader->imagetype == IT_COLOURMAPPED_COMPRESSED;
+}
+
+// Bytes of colour map between the image ID field and the pixel data
+size_t GetTGAColourMapSize( const TGA_HEADER * pHeader );
+
+// Bits per decoded pixel: 32 when the source carries alpha, 24 otherwise
+int GetTGAOutputBits( const TGA_HEADER * pHeader );
+
+// pColourMap points at GetTGAColourMapSize bytes for colour mapped images (NULL leaves the
+// palette black until it is known) and is ignored otherwise
+void InitTGAPixelFormat( TGAPixelFormat * pFormat, const TGA_HEADER * pHeader, const char * pColourMap );
+
+void ConvertTGAPixels( const TGAPixelFormat * pFormat, char * pDest, const char * pSrc, int nPixels );
@@ -0,0 +1,231 @@
+#include "TGAStream.h"
+#include <string.h>
+
+TGAStreamDecoder::TGAStreamDecoder( TGARowFunc rowFunc, void * pUserData )
+    : rowFunc( rowFunc )
+    , pUserData( pUserData )
+    , state( STATE_HEADER )
+    , identRemaining( 0 )
+    , pColourMap( NULL )
+    , colourMapSize( 0 )
+    , packetRemaining( 0 )
+    , pendingBytes( 0 )
+    , pRow( NULL )
+    , rowX( 0 )
+    , rowsDecoded( 0 )
+{
+    memset( &header, 0, sizeof( header ) );
+    memset( &format, 0, sizeof( format ) );
+}
+
+TGAStreamDecoder::~TGAStreamDecoder()
+{
+    delete[] pColourMap;
+    delete[] pRow;
+}
+
+// Moves the current row forward by nPixels just written to pRow and hands it out when full
+void TGAStreamDecoder::AdvanceRow( int nPixels )
+{
+    rowX += nPixels;
+    packetRemaining -= nPixels;
+    if ( rowX < header.width )
+        return;
+
+    bool bInverted = ( (header.descriptor & (1 << 5)) != 0 );
+    int row = bInverted ? header.height - rowsDecoded - 1 : rowsDecoded;
+    rowFunc( pUserData, row, pRow );
+
+    rowX = 0;
+    rowsDecoded ++;
+    if ( rowsDecoded == header.height )
+        state = STATE_DONE;
+}
+
+// A run needs no further input once its pixel is known, so it is expanded in one go
+void TGAStreamDecoder::FillRun()
+{
+    char pixel[4];
+    ConvertTGAPixels( &format, pixel, pixelBytes, 1 );
+    int pixelSize = format.dstSize;
+
+    while ( packetRemaining > 0 )
+    {
+        int count = header.width - rowX;
+        if ( count > packetRemaining )
+            count = packetRemaining;
+
+        char * pDest = pRow + rowX * pixelSize;
+        for ( int i = 0; i < count; i ++ )
+        {
+            memcpy( pDest, pixel, pixelSize );
+            pDest += pixelSize;
+        }
+        AdvanceRow( count );
+    }
+}
+
+bool TGAStreamDecoder::Feed( const char * pData, size_t len )
+{
+    const char * pEnd = pData + len;
+
+    while ( pData < pEnd && state != STATE_DONE && state != STATE_ERROR )
+    {
+        switch ( state )
+        {
+        case STATE_HEADER:
+        {
+            size_t count = sizeof( TGA_HEADER ) - pendingBytes;
+            if ( count > (size_t)( pEnd - pData ) )
+                count = pEnd - pData;
+            memcpy( headerBytes + pendingBytes, pData, count );
+            pendingBytes += (int)count;
+            pData += count;
+
+            if ( pendingBytes < (int)sizeof( TGA_HEADER ) )
+                break;
+
+            pendingBytes = 0;
+            if ( !ParseTGAHeader( headerBytes, &header ) )
+            {
+                state = STATE_ERROR;
+                break;
+            }
+
+            // The palette is only known after STATE_COLOURMAP; truecolour formats are complete here
+            InitTGAPixelFormat( &format, &header, NULL );
+            pRow = new char[header.width * format.dstSize];
+            colourMapSize = GetTGAColourMapSize( &header );
+            pColourMap = new char[colourMapSize > 0 ? colourMapSize : 1];
+            identRemaining = header.identsize;
+            state = STATE_IDENT;
+        }
+        break;
+
+        case STATE_IDENT:
+        {
+            int count = identRemaining;
+            if ( count > pEnd - pData )
+                count = (int)( pEnd - pData );
+            pData += count;
+            identRemaining -= count;
+            break;
+        }
+
+        case STATE_COLOURMAP:
+        {
+            size_t count = colourMapSize - pendingBytes;
+            if ( count > (size_t)( pEnd - pData ) )
+                count = pEnd - pData;
+            memcpy( pColourMap + pendingBytes, pData, count );
+            pendingBytes += (int)count;
+            pData += count;
+            break;
+        }
+
+        case STATE_PACKET:
+        {
+            unsigned char chunk = *pData ++;
+            packetRemaining = ( chunk & 127 ) + 1;
+            if ( packetRemaining > header.width * ( header.height - rowsDecoded ) - rowX )
+                state = STATE_ERROR;
+            else
+                state = chunk < 128 ? STATE_RAW_PIXELS : STATE_RUN_PIXEL;
+        }
+        break;
+
+        case STATE_RUN_PIXEL:
+        {
+            int count = format.srcSize - pendingBytes;
+            if ( count > pEnd - pData )
+                count = (int)( pEnd - pData );
+            memcpy( pixelBytes + pendingBytes, pData, count );
+            pendingBytes += count;
+            pData += count;
+
+            if ( pendingBytes < format.srcSize )
+                break;
+
+            pendingBytes = 0;
+            state = STATE_PACKET;
+            FillRun();
+        }
+        break;
+
+        case STATE_RAW_PIXELS:
+        {
+            int srcSize = format.srcSize;
+            if ( pendingBytes > 0 )
+            {
+                // Finish a pixel that was split across two chunks
+                int count = srcSize - pendingBytes;
+                if ( count > pEnd - pData )
+                    count = (int)( pEnd - pData );
+                memcpy( pixelBytes + pendingBytes, pData, count );
+                pendingBytes += count;
+                pData += count;
+
+                if ( pendingBytes < srcSize )
+                    break;
+
+                pendingBytes = 0;
+                ConvertTGAPixels( &format, pRow + rowX * format.dstSize, pixelBytes, 1 );
+                AdvanceRow( 1 );
+            }
+            else
+            {
+                int count = header.width - rowX;
+                if ( count > packetRemaining )
+                    count = packetRemaining;
+                if ( count > ( pEnd - pData ) / srcSize )
+                    count = (int)( ( pEnd - pData ) / srcSize );
+
+                if ( count > 0 )
+                {
+                    ConvertTGAPixels( &format, pRow + rowX * format.dstSize, pData, count );
+                    pData += count * srcSize;
+                    AdvanceRow( count );
+                }
+                else
+                {
+                    // Less than a pixel left in this chunk
+                    pendingBytes = (int)( pEnd - pData );
+                    memcpy( pixelBytes, pData, pendingBytes );
+                    pData = pEnd;
+                }
+            }
+
+            if ( packetRemaining == 0 && state == STATE_RAW_PIXELS )
+                state = STATE_PACKET;
+        }
+        break;
+
+        default:
+            break;
+        }
+
+        if ( state == STATE_IDENT && identRemaining == 0 )
+        {
+            pendingBytes = 0;
+            state = STATE_COLOURMAP;
+        }
+
+        // Uncompressed data is one raw packet covering the whole image
+        if ( state == STATE_COLOURMAP && pendingBytes == (int)colourMapSize )
+        {
+            pendingBytes = 0;
+            InitTGAPixelFormat( &format, &header, pColourMap );
+            if ( IsTGACompressed( &header ) )
+            {
+                state = STATE_PACKET;
+            }
+            else
+            {
+                packetRemaining = header.width * header.height;
+                state = STATE_RAW_PIXELS;
+            }
+        }
+    }
+
+    return state != STATE_ERROR;
+}
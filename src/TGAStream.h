@@ -0,0 +1,69 @@
+#pragma once
+
+#include "TGAFormat.h"
+#include <stddef.h>
+
+// Receives one finished RGB(A) row. row is the destination row index in the same bottom-up
+// order LoadTGA produces; pPixels is only valid for the duration of the call.
+typedef void (*TGARowFunc)( void * pUserData, int row, const char * pPixels );
+
+// Resumable TGA decoder. Bytes can be fed in chunks of any size as they arrive from storage,
+// and every row is handed to the row callback as soon as it is complete, so decoding (and
+// uploading in row bands) overlaps the I/O instead of waiting for the whole file.
+class TGAStreamDecoder
+{
+public:
+    TGAStreamDecoder( TGARowFunc rowFunc, void * pUserData );
+    ~TGAStreamDecoder();
+
+    // Consumes len bytes. Returns false once the stream turned out to be invalid.
+    // Bytes past the end of the image are ignored.
+    bool Feed( const char * pData, size_t len );
+
+    bool HasHeader() const      { return state > STATE_HEADER && state != STATE_ERROR; }
+    bool IsComplete() const     { return state == STATE_DONE; }
+    bool HasFailed() const      { return state == STATE_ERROR; }
+
+    // Valid once HasHeader() returns true
+    int GetWidth() const        { return header.width; }
+    int GetHeight() const       { return header.height; }
+    int GetBpp() const          { return format.dstSize * 8; }
+    int GetRowsDecoded() const  { return rowsDecoded; }
+
+private:
+    enum State
+    {
+        STATE_HEADER,       // collecting the fixed size header
+        STATE_IDENT,        // skipping the image ID field
+        STATE_COLOURMAP,    // collecting the palette (skipped for truecolour images)
+        STATE_PACKET,       // waiting for an RLE packet header
+        STATE_RUN_PIXEL,    // collecting the pixel of an RLE run packet
+        STATE_RAW_PIXELS,   // copying the pixels of a raw packet (the whole image when uncompressed)
+        STATE_DONE,
+        STATE_ERROR,
+    };
+
+    void FillRun();
+    void AdvanceRow( int nPixels );
+
+    TGARowFunc          rowFunc;
+    void *              pUserData;
+
+    State               state;
+    TGA_HEADER          header;
+    char                headerBytes[sizeof( TGA_HEADER )];
+    int                 identRemaining;
+    TGAPixelFormat      format;
+    char *              pColourMap;
+    size_t              colourMapSize;
+
+    // Current packet
+    int                 packetRemaining;
+    char                pixelBytes[4];  // partially received source pixel
+    int                 pendingBytes;   // bytes in headerBytes / pColourMap / pixelBytes
+
+    // Current row
+    char *              pRow;
+    int                 rowX;
+    int                 rowsDecoded;
+};
@@ -0,0 +1,254 @@
+#include "TGASwizzle.h"
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#define TGA_SWIZZLE_X86 1
+#endif
+
+#if TGA_SWIZZLE_X86
+
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define TGA_TARGET_SSSE3
+#define TGA_TARGET_AVX2
+#else
+#include <cpuid.h>
+#define TGA_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TGA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#endif // TGA_SWIZZLE_X86
+
+// ------------------------------------------------------------------------------------------------
+// Scalar kernels (also used for the row tails of the SIMD kernels)
+// ------------------------------------------------------------------------------------------------
+
+static void SwizzleRow24Scalar( char * pDest, const char * pSrc, int nPixels )
+{
+    for ( int j = 0; j < nPixels; j ++ )
+    {
+        *pDest ++ = pSrc[2];
+        *pDest ++ = pSrc[1];
+        *pDest ++ = pSrc[0];
+        pSrc += 3;
+    }
+}
+
+static void SwizzleRow32Scalar( char * pDest, const char * pSrc, int nPixels )
+{
+    for ( int j = 0; j < nPixels; j ++ )
+    {
+        *pDest ++ = pSrc[2];
+        *pDest ++ = pSrc[1];
+        *pDest ++ = pSrc[0];
+        *pDest ++ = pSrc[3];
+        pSrc += 4;
+    }
+}
+
+#if TGA_SWIZZLE_X86
+
+// ------------------------------------------------------------------------------------------------
+// SSSE3 kernels
+// ------------------------------------------------------------------------------------------------
+
+// 5 pixels (15 bytes) per iteration. Every load and store touches 16 bytes, so the loop keeps
+// at least one pixel in reserve; the 16th byte written is overwritten by the next store or the tail.
+TGA_TARGET_SSSE3
+static void SwizzleRow24SSSE3( char * pDest, const char * pSrc, int nPixels )
+{
+    const __m128i mask = _mm_setr_epi8( 2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15 );
+    int j = 0;
+    for ( ; j + 6 <= nPixels; j += 5 )
+    {
+        __m128i v = _mm_loadu_si128( (const __m128i *)pSrc );
+        _mm_storeu_si128( (__m128i *)pDest, _mm_shuffle_epi8( v, mask ) );
+        pSrc += 15;
+        pDest += 15;
+    }
+    SwizzleRow24Scalar( pDest, pSrc, nPixels - j );
+}
+
+// 16 pixels per iteration, then 4 at a time
+TGA_TARGET_SSSE3
+static void SwizzleRow32SSSE3( char * pDest, const char * pSrc, int nPixels )
+{
+    const __m128i mask = _mm_setr_epi8( 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 );
+    int j = 0;
+    for ( ; j + 16 <= nPixels; j += 16 )
+    {
+        __m128i v0 = _mm_loadu_si128( (const __m128i *)pSrc + 0 );
+        __m128i v1 = _mm_loadu_si128( (const __m128i *)pSrc + 1 );
+        __m128i v2 = _mm_loadu_si128( (const __m128i *)pSrc + 2 );
+        __m128i v3 = _mm_loadu_si128( (const __m128i *)pSrc + 3 );
+        _mm_storeu_si128( (__m128i *)pDest + 0, _mm_shuffle_epi8( v0, mask ) );
+        _mm_storeu_si128( (__m128i *)pDest + 1, _mm_shuffle_epi8( v1, mask ) );
+        _mm_storeu_si128( (__m128i *)pDest + 2, _mm_shuffle_epi8( v2, mask ) );
+        _mm_storeu_si128( (__m128i *)pDest + 3, _mm_shuffle_epi8( v3, mask ) );
+        pSrc += 64;
+        pDest += 64;
+    }
+    for ( ; j + 4 <= nPixels; j += 4 )
+    {
+        __m128i v = _mm_loadu_si128( (const __m128i *)pSrc );
+        _mm_storeu_si128( (__m128i *)pDest, _mm_shuffle_epi8( v, mask ) );
+        pSrc += 16;
+        pDest += 16;
+    }
+    SwizzleRow32Scalar( pDest, pSrc, nPixels - j );
+}
+
+// ------------------------------------------------------------------------------------------------
+// AVX2 kernels
+// ------------------------------------------------------------------------------------------------
+
+// 8 pixels (24 bytes) per iteration. vpshufb cannot cross 128-bit lanes, so the six source dwords
+// are first spread to 12 bytes per lane, swizzled in-lane and packed back together. Loads and
+// stores touch 32 bytes, hence the 11 pixel (33 byte) reserve.
+TGA_TARGET_AVX2
+static void SwizzleRow24AVX2( char * pDest, const char * pSrc, int nPixels )
+{
+    const __m256i spread = _mm256_setr_epi32( 0, 1, 2, 2, 3, 4, 5, 5 );
+    const __m256i pack = _mm256_setr_epi32( 0, 1, 2, 4, 5, 6, 3, 7 );
+    const __m256i mask = _mm256_setr_epi8(
+        2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1,
+        2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, -1, -1, -1, -1 );
+    int j = 0;
+    for ( ; j + 11 <= nPixels; j += 8 )
+    {
+        __m256i v = _mm256_loadu_si256( (const __m256i *)pSrc );
+        v = _mm256_permutevar8x32_epi32( v, spread );
+        v = _mm256_shuffle_epi8( v, mask );
+        v = _mm256_permutevar8x32_epi32( v, pack );
+        _mm256_storeu_si256( (__m256i *)pDest, v );
+        pSrc += 24;
+        pDest += 24;
+    }
+    // The tail is legacy SSE code, which stalls on dirty upper YMM halves
+    _mm256_zeroupper();
+    SwizzleRow24SSSE3( pDest, pSrc, nPixels - j );
+}
+
+// 32 pixels per iteration, then 8 at a time
+TGA_TARGET_AVX2
+static void SwizzleRow32AVX2( char * pDest, const char * pSrc, int nPixels )
+{
+    const __m256i mask = _mm256_setr_epi8(
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15 );
+    int j = 0;
+    for ( ; j + 32 <= nPixels; j += 32 )
+    {
+        __m256i v0 = _mm256_loadu_si256( (const __m256i *)pSrc + 0 );
+        __m256i v1 = _mm256_loadu_si256( (const __m256i *)pSrc + 1 );
+        __m256i v2 = _mm256_loadu_si256( (const __m256i *)pSrc + 2 );
+        __m256i v3 = _mm256_loadu_si256( (const __m256i *)pSrc + 3 );
+        _mm256_storeu_si256( (__m256i *)pDest + 0, _mm256_shuffle_epi8( v0, mask ) );
+        _mm256_storeu_si256( (__m256i *)pDest + 1, _mm256_shuffle_epi8( v1, mask ) );
+        _mm256_storeu_si256( (__m256i *)pDest + 2, _mm256_shuffle_epi8( v2, mask ) );
+        _mm256_storeu_si256( (__m256i *)pDest + 3, _mm256_shuffle_epi8( v3, mask ) );
+        pSrc += 128;
+        pDest += 128;
+    }
+    for ( ; j + 8 <= nPixels; j += 8 )
+    {
+        __m256i v = _mm256_loadu_si256( (const __m256i *)pSrc );
+        _mm256_storeu_si256( (__m256i *)pDest, _mm256_shuffle_epi8( v, mask ) );
+        pSrc += 32;
+        pDest += 32;
+    }
+    _mm256_zeroupper();
+    SwizzleRow32SSSE3( pDest, pSrc, nPixels - j );
+}
+
+// ------------------------------------------------------------------------------------------------
+// CPU detection
+// ------------------------------------------------------------------------------------------------
+
+static void CpuId( int regs[4], int leaf, int subLeaf )
+{
+#if defined(_MSC_VER)
+    __cpuidex( regs, leaf, subLeaf );
+#else
+    unsigned int a, b, c, d;
+    __cpuid_count( leaf, subLeaf, a, b, c, d );
+    regs[0] = (int)a; regs[1] = (int)b; regs[2] = (int)c; regs[3] = (int)d;
+#endif
+}
+
+static unsigned long long XGetBV()
+{
+#if defined(_MSC_VER)
+    return _xgetbv( 0 );
+#else
+    unsigned int lo, hi;
+    __asm__ __volatile__( "xgetbv" : "=a"(lo), "=d"(hi) : "c"(0) );
+    return ( (unsigned long long)hi << 32 ) | lo;
+#endif
+}
+
+static TGASimdLevel DetectTGASimdLevel()
+{
+    int regs[4];
+    CpuId( regs, 0, 0 );
+    int maxLeaf = regs[0];
+    if ( maxLeaf < 1 )
+        return TGA_SIMD_SCALAR;
+
+    CpuId( regs, 1, 0 );
+    bool ssse3 = ( regs[2] & (1 << 9) ) != 0;
+    bool osxsave = ( regs[2] & (1 << 27) ) != 0;
+    bool avx = ( regs[2] & (1 << 28) ) != 0;
+    if ( !ssse3 )
+        return TGA_SIMD_SCALAR;
+
+    // AVX2 also needs the OS to save the YMM registers on context switches
+    if ( maxLeaf >= 7 && osxsave && avx && ( XGetBV() & 6 ) == 6 )
+    {
+        CpuId( regs, 7, 0 );
+        if ( regs[1] & (1 << 5) )
+            return TGA_SIMD_AVX2;
+    }
+    return TGA_SIMD_SSSE3;
+}
+
+#endif // TGA_SWIZZLE_X86
+
+TGASimdLevel GetTGASimdLevel()
+{
+#if TGA_SWIZZLE_X86
+    static const TGASimdLevel s_level = DetectTGASimdLevel();
+    return s_level;
+#else
+    return TGA_SIMD_SCALAR;
+#endif
+}
+
+TGASwizzleRowFunc GetTGASwizzleRowFunc( int bits, TGASimdLevel level )
+{
+    if ( level > GetTGASimdLevel() )
+        level = GetTGASimdLevel();
+
+    switch ( level )
+    {
+#if TGA_SWIZZLE_X86
+    case TGA_SIMD_AVX2:
+        return bits == 24 ? SwizzleRow24AVX2 : SwizzleRow32AVX2;
+    case TGA_SIMD_SSSE3:
+        return bits == 24 ? SwizzleRow24SSSE3 : SwizzleRow32SSSE3;
+#endif
+    default:
+        return bits == 24 ? SwizzleRow24Scalar : SwizzleRow32Scalar;
+    }
+}
+
+TGASwizzleRowFunc GetTGASwizzleRowFunc( int bits )
+{
+    // The 24 bit AVX2 kernel needs two lane crossing permutes per 8 pixels and measures no faster
+    // than SSSE3 (see SwizzleBenchmark), so it is only used when asked for
+    TGASimdLevel level = GetTGASimdLevel();
+    if ( bits == 24 && level > TGA_SIMD_SSSE3 )
+        level = TGA_SIMD_SSSE3;
+    return GetTGASwizzleRowFunc( bits, level );
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Instruction set levels for the BGR(A) -> RGB(A) row kernels
+enum TGASimdLevel
+{
+    TGA_SIMD_SCALAR = 0,
+    TGA_SIMD_SSSE3,
+    TGA_SIMD_AVX2,
+};
+
+// Converts nPixels BGR(A) pixels from pSrc into RGB(A) pixels at pDest.
+// pSrc and pDest must not overlap.
+typedef void (*TGASwizzleRowFunc)( char * pDest, const char * pSrc, int nPixels );
+
+// Highest level supported by the CPU we are running on (queried once through CPUID).
+TGASimdLevel GetTGASimdLevel();
+
+// Row kernel for 24 or 32 bit pixels at the given level, clamped to what the CPU supports.
+TGASwizzleRowFunc GetTGASwizzleRowFunc( int bits, TGASimdLevel level );
+
+// Fastest row kernel for 24 or 32 bit pixels on this CPU.
+TGASwizzleRowFunc GetTGASwizzleRowFunc( int bits );
@@ -0,0 +1,404 @@
+#include "TextureLoader.h"
+#include "TGA.h"
+#include "Parallel.h"
+
+#include <chrono>
+#include <string.h>
+
+static bool IsKTXFileName(const char* szFileName)
+{
+	size_t length = strlen(szFileName);
+	return length > 4 && _stricmp(szFileName + length - 4, ".ktx") == 0;
+}
+
+// Faults the mapping in on the worker so the upload on the GL thread does not wait on disk
+static void TouchPages(const KTXFile* file)
+{
+	const size_t TOUCH_STRIDE = 4096;
+	volatile char sum = 0;
+	for (size_t i = 0; i < file->map.size; i += TOUCH_STRIDE)
+		sum += file->map.data[i];
+}
+
+void TextureLoader::FreeResultData(Result& result)
+{
+	if (result.mips)
+		FreeMipChain(result.mips);
+	else
+		delete[] result.pixels;
+	delete result.mips;
+
+	if (result.ktx)
+		CloseKTX(result.ktx);
+	delete result.ktx;
+
+	for (int i = 0; i < result.numPacked; i++)
+		FreePackedImage(&result.packed[i]);
+	delete[] result.packed;
+
+	result.pixels = NULL;
+	result.mips = NULL;
+	result.ktx = NULL;
+	result.packed = NULL;
+	result.numPacked = 0;
+}
+
+// Replaces the 24/32-bit level(s) of a decoded result with 16-bit ones
+bool TextureLoader::PackResult(Result& result, const PackOptions& options)
+{
+	int numLevels = result.mips ? result.mips->numLevels : 1;
+	PackedImage* packed = new PackedImage[numLevels];
+	for (int i = 0; i < numLevels; i++)
+	{
+		const char* pixels = result.mips ? result.mips->levels[i].pixels : result.pixels;
+		int width = result.mips ? result.mips->levels[i].width : result.width;
+		int height = result.mips ? result.mips->levels[i].height : result.height;
+		if (!PackPixels(pixels, width, height, result.bpp, &options, &packed[i]))
+		{
+			for (int j = 0; j < i; j++)
+				FreePackedImage(&packed[j]);
+			delete[] packed;
+			return false;
+		}
+	}
+
+	FreeResultData(result);
+	result.packed = packed;
+	result.numPacked = numLevels;
+	return true;
+}
+
+TextureLoader::TextureLoader()
+	: pendingCount(0)
+	, buildMips(false)
+	, stopping(false)
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	Shutdown();
+}
+
+void TextureLoader::Init(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = GetHardwareThreadCount() > 1 ? GetHardwareThreadCount() - 1 : 1;
+
+	stopping = false;
+	for (int i = 0; i < numThreads; i++)
+		workers.push_back(std::thread(&TextureLoader::WorkerMain, this));
+}
+
+void TextureLoader::SetMipOptions(const MipOptions* options)
+{
+	std::lock_guard<std::mutex> lock(requestMutex);
+	buildMips = options != NULL;
+	if (options)
+		mipOptions = *options;
+}
+
+void TextureLoader::Shutdown()
+{
+	{
+		std::lock_guard<std::mutex> lock(requestMutex);
+		stopping = true;
+		requests.clear();
+	}
+	requestCond.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+	workers.clear();
+
+	Result result;
+	while (results.Pop(result))
+		FreeResultData(result);
+
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (slots[i].texture != 0)
+			glDeleteTextures(1, &slots[i].texture);
+	}
+	slots.clear();
+	freeSlots.clear();
+	pendingCount = 0;
+}
+
+TextureHandle TextureLoader::AllocSlot()
+{
+	TextureHandle handle;
+	if (!freeSlots.empty())
+	{
+		handle = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		handle = (TextureHandle)slots.size();
+		slots.push_back(Slot());
+	}
+
+	slots[handle].state = SLOT_PENDING;
+	slots[handle].texture = 0;
+	return handle;
+}
+
+TextureHandle TextureLoader::Load(const char* szFileName, const PackOptions* pack)
+{
+	TextureHandle handle;
+	LoadBatch(&szFileName, 1, &handle, pack);
+	return handle;
+}
+
+void TextureLoader::LoadBatch(const char** fileNames, int count, TextureHandle* handles, const PackOptions* pack)
+{
+	{
+		std::lock_guard<std::mutex> lock(requestMutex);
+		for (int i = 0; i < count; i++)
+		{
+			Request request;
+			request.handle = AllocSlot();
+			strncpy_s(request.fileName, fileNames[i], _TRUNCATE);
+			request.pack = pack != NULL;
+			if (pack)
+				request.packOptions = *pack;
+			requests.push_back(request);
+
+			handles[i] = request.handle;
+		}
+		pendingCount += count;
+	}
+	requestCond.notify_all();
+}
+
+void TextureLoader::WorkerMain()
+{
+	// The pool already decodes one file per worker, so large RLE files stay on this thread too
+	SetTGADecodeThreads(1);
+
+	for (;;)
+	{
+		Request request;
+		bool mipsRequested;
+		MipOptions options;
+		{
+			std::unique_lock<std::mutex> lock(requestMutex);
+			while (requests.empty() && !stopping)
+				requestCond.wait(lock);
+			if (stopping)
+				return;
+			request = requests.front();
+			requests.pop_front();
+			mipsRequested = buildMips;
+			options = mipOptions;
+		}
+
+		Result result;
+		result.handle = request.handle;
+		result.mips = NULL;
+		result.ktx = NULL;
+		result.pixels = NULL;
+		result.packed = NULL;
+		result.numPacked = 0;
+		if (IsKTXFileName(request.fileName))
+		{
+			result.ktx = new KTXFile;
+			if (OpenKTX(request.fileName, result.ktx))
+			{
+				TouchPages(result.ktx);
+				result.width = result.ktx->width;
+				result.height = result.ktx->height;
+				result.bpp = 0;
+			}
+			else
+			{
+				delete result.ktx;
+				result.ktx = NULL;
+			}
+		}
+		else
+		{
+			result.pixels = LoadTGA(request.fileName, &result.width, &result.height, &result.bpp);
+		}
+		if (result.pixels == NULL && result.ktx == NULL)
+			Debug("TextureLoader: failed to load %s\n", request.fileName);
+
+		bool isPowerOfTwo = result.pixels && (result.width & (result.width - 1)) == 0 && (result.height & (result.height - 1)) == 0;
+		if (mipsRequested && isPowerOfTwo)
+		{
+			// The pool already runs one file per worker, so keep the chain on this thread
+			options.numThreads = 1;
+			result.mips = new MipChain;
+			if (BuildMipChain(result.pixels, result.width, result.height, result.bpp, &options, result.mips))
+			{
+				delete[] result.pixels;
+				result.pixels = result.mips->levels[0].pixels;
+			}
+			else
+			{
+				delete result.mips;
+				result.mips = NULL;
+			}
+		}
+
+		if (request.pack && result.pixels)
+		{
+			// Like the mip chain, one file per worker is already enough parallelism
+			request.packOptions.numThreads = 1;
+			if (!PackResult(result, request.packOptions))
+				Debug("TextureLoader: failed to pack %s, keeping 32 bits per pixel\n", request.fileName);
+		}
+
+		// The render thread drains the queue every frame, so a full queue only means it is behind
+		while (!results.Push(result))
+		{
+			if (stopping)
+			{
+				FreeResultData(result);
+				return;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+void TextureLoader::Upload(const Result& result)
+{
+	Slot& slot = slots[result.handle];
+	pendingCount--;
+
+	if (slot.state == SLOT_RELEASED)
+	{
+		slot.state = SLOT_FREE;
+		freeSlots.push_back(result.handle);
+		return;
+	}
+
+	if (result.pixels == NULL && result.ktx == NULL && result.packed == NULL)
+	{
+		slot.state = SLOT_FAILED;
+		return;
+	}
+
+	GLenum format = result.bpp == 32 ? GL_RGBA : GL_RGB;
+	bool isPowerOfTwo = (result.width & (result.width - 1)) == 0 && (result.height & (result.height - 1)) == 0;
+
+	glGenTextures(1, &slot.texture);
+	glBindTexture(GL_TEXTURE_2D, slot.texture);
+	if (result.ktx)
+	{
+		UploadKTX(result.ktx);
+	}
+	else if (result.packed)
+	{
+		for (int i = 0; i < result.numPacked; i++)
+			UploadPackedImage(&result.packed[i], i);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, result.numPacked > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	else if (result.mips)
+	{
+		UploadMipChain(result.mips);
+	}
+	else
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, result.width, result.height, 0, format, GL_UNSIGNED_BYTE, result.pixels);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	}
+	if (!isPowerOfTwo)
+	{
+		// GLES2 only samples NPOT textures with clamped addressing
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	slot.state = SLOT_READY;
+}
+
+int TextureLoader::Update(float budgetMs, size_t budgetBytes)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t uploadedBytes = 0;
+	int finished = 0;
+	Result result;
+
+	while (results.Pop(result))
+	{
+		Upload(result);
+		finished++;
+		if (result.ktx)
+		{
+			for (int i = 0; i < result.ktx->numLevels; i++)
+				uploadedBytes += result.ktx->levelSizes[i];
+		}
+		else if (result.packed)
+		{
+			for (int i = 0; i < result.numPacked; i++)
+				uploadedBytes += result.packed[i].size;
+		}
+		else if (result.mips)
+		{
+			for (int i = 0; i < result.mips->numLevels; i++)
+				uploadedBytes += result.mips->levels[i].size;
+		}
+		else if (result.pixels)
+		{
+			uploadedBytes += (size_t)result.width * result.height * result.bpp / 8;
+		}
+		FreeResultData(result);
+
+		if (budgetBytes > 0 && uploadedBytes >= budgetBytes)
+			break;
+		if (budgetMs > 0.0f)
+		{
+			std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			if (elapsed.count() >= budgetMs)
+				break;
+		}
+	}
+
+	return finished;
+}
+
+bool TextureLoader::IsReady(TextureHandle handle) const
+{
+	return handle >= 0 && handle < (int)slots.size() && slots[handle].state == SLOT_READY;
+}
+
+bool TextureLoader::HasFailed(TextureHandle handle) const
+{
+	return handle >= 0 && handle < (int)slots.size() && slots[handle].state == SLOT_FAILED;
+}
+
+GLuint TextureLoader::GetTexture(TextureHandle handle) const
+{
+	return IsReady(handle) ? slots[handle].texture : 0;
+}
+
+void TextureLoader::Release(TextureHandle handle)
+{
+	if (handle < 0 || handle >= (int)slots.size())
+		return;
+
+	Slot& slot = slots[handle];
+	switch (slot.state)
+	{
+	case SLOT_PENDING:
+		slot.state = SLOT_RELEASED;
+		break;
+	case SLOT_READY:
+	case SLOT_FAILED:
+		if (slot.texture != 0)
+			glDeleteTextures(1, &slot.texture);
+		slot.texture = 0;
+		slot.state = SLOT_FREE;
+		freeSlots.push_back(handle);
+		break;
+	default:
+		break;
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include "KTX.h"
+#include "LockFreeQueue.h"
+#include "Mipmap.h"
+#include "PixelPack.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef int TextureHandle;
+
+const TextureHandle INVALID_TEXTURE_HANDLE = -1;
+
+// Decodes TGA files on a pool of worker threads and uploads the results on the GL thread under
+// a per-frame budget, so loading never stalls the render thread on image decode. Cooked .ktx files
+// skip decoding: the worker maps them and the upload reads straight from the mapping.
+// Load/Update/IsReady/GetTexture/Release must all be called from the thread owning the GL context.
+class TextureLoader
+{
+public:
+	TextureLoader();
+	~TextureLoader();
+
+	// numThreads <= 0 uses one worker per hardware thread, minus the render thread
+	void Init(int numThreads);
+	void Shutdown();
+
+	// Builds a mip chain on the worker for every power-of-two texture loaded from now on,
+	// NULL turns it off (the default)
+	void SetMipOptions(const MipOptions* options);
+
+	// Queues a file for decoding; the handle becomes ready once Update has uploaded it. With pack
+	// options the worker converts every level of a TGA to 16 bits per pixel before the upload.
+	TextureHandle Load(const char* szFileName, const PackOptions* pack = NULL);
+	void LoadBatch(const char** fileNames, int count, TextureHandle* handles, const PackOptions* pack = NULL);
+
+	// Uploads finished images until either budget is spent (<= 0 means unlimited). At least one
+	// image is uploaded per call so large textures cannot starve. Call once per frame. Returns how
+	// many requests became ready or failed, so the caller knows when to redraw.
+	int Update(float budgetMs, size_t budgetBytes);
+
+	bool IsReady(TextureHandle handle) const;
+	bool HasFailed(TextureHandle handle) const;
+	GLuint GetTexture(TextureHandle handle) const;	// 0 until ready
+
+	// Deletes the texture, or drops the result if it is still in flight
+	void Release(TextureHandle handle);
+
+	// Requests that are queued, decoding or waiting for upload
+	int GetPendingCount() const { return pendingCount; }
+
+private:
+	enum SlotState
+	{
+		SLOT_FREE,
+		SLOT_PENDING,
+		SLOT_READY,
+		SLOT_FAILED,
+		SLOT_RELEASED,	// released while in flight, freed when the result arrives
+	};
+
+	struct Slot
+	{
+		SlotState	state;
+		GLuint		texture;
+	};
+
+	struct Request
+	{
+		TextureHandle	handle;
+		char			fileName[260];
+		bool			pack;
+		PackOptions		packOptions;
+	};
+
+	struct Result
+	{
+		TextureHandle	handle;
+		char*			pixels;		// NULL when decoding failed
+		MipChain*		mips;		// NULL unless mipmaps were requested
+		KTXFile*		ktx;		// mapped cooked file, pixels and mips are NULL
+		PackedImage*	packed;		// one per level when packing was requested, pixels and mips are NULL
+		int				numPacked;
+		int				width;
+		int				height;
+		int				bpp;
+	};
+
+	static void FreeResultData(Result& result);
+	static bool PackResult(Result& result, const PackOptions& options);
+
+	void WorkerMain();
+	void Upload(const Result& result);
+	TextureHandle AllocSlot();
+
+	std::vector<Slot>			slots;
+	std::vector<TextureHandle>	freeSlots;
+	int							pendingCount;
+
+	bool						buildMips;
+	MipOptions					mipOptions;
+
+	// Render thread -> workers
+	std::mutex					requestMutex;
+	std::condition_variable		requestCond;
+	std::deque<Request>			requests;
+	std::atomic<bool>			stopping;
+
+	// Workers -> render thread
+	LockFreeQueue<Result, 256>	results;
+
+	std::vector<std::thread>	workers;
+};
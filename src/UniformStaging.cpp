@@ -0,0 +1,158 @@
+#include "UniformStaging.h"
+
+#include <string.h>
+
+// GL thread only, like the programs themselves
+static UniformUploadStats s_frameStats;
+static UniformUploadStats s_lastFrameStats;
+
+// 32-bit words per element of a uniform type, 0 for types GLES2 does not have
+static int GetUniformTypeWords(GLenum type)
+{
+	switch (type)
+	{
+	case GL_FLOAT:
+	case GL_INT:
+	case GL_BOOL:
+	case GL_SAMPLER_2D:
+	case GL_SAMPLER_CUBE:	return 1;
+	case GL_FLOAT_VEC2:
+	case GL_INT_VEC2:
+	case GL_BOOL_VEC2:		return 2;
+	case GL_FLOAT_VEC3:
+	case GL_INT_VEC3:
+	case GL_BOOL_VEC3:		return 3;
+	case GL_FLOAT_VEC4:
+	case GL_INT_VEC4:
+	case GL_BOOL_VEC4:
+	case GL_FLOAT_MAT2:		return 4;
+	case GL_FLOAT_MAT3:		return 9;
+	case GL_FLOAT_MAT4:		return 16;
+	default:				return 0;
+	}
+}
+
+void UniformStaging::Init(const ShaderReflection& programReflection)
+{
+	reflection = programReflection;
+	uniforms.clear();
+	dirtyList.clear();
+
+	int numWords = 0;
+	int arrayOffset = 0;
+	for (int i = 0; i < reflection.GetUniformCount(); i++)
+	{
+		const ShaderVariable& variable = reflection.GetUniform(i);
+		int elementWords = GetUniformTypeWords(variable.type);
+
+		Uniform uniform;
+		uniform.location = variable.location;
+		uniform.type = variable.type;
+		uniform.count = variable.size;
+		uniform.words = variable.size * elementWords;
+		uniform.dirty = false;
+
+		// "name[i]" entries alias their slice of the array, so both spellings see the same shadow
+		if (variable.element >= 0)
+		{
+			uniform.offset = arrayOffset + variable.element * elementWords;
+		}
+		else
+		{
+			uniform.offset = numWords;
+			arrayOffset = numWords;
+			numWords += uniform.words;
+		}
+
+		uniforms.push_back(uniform);
+	}
+
+	shadow.assign(numWords, 0);
+}
+
+bool UniformStaging::Set(ShaderNameHash name, const void* values, int numWords)
+{
+	int index = reflection.FindUniformIndex(name);
+	if (index < 0)
+		return false;
+
+	Uniform& uniform = uniforms[index];
+	if (numWords > uniform.words)
+		numWords = uniform.words;
+	if (numWords <= 0)
+		return true;
+
+	GLint* stored = &shadow[uniform.offset];
+	size_t bytes = numWords * sizeof(GLint);
+	if (memcmp(stored, values, bytes) == 0)
+	{
+		s_frameStats.skipped++;
+		return true;
+	}
+
+	memcpy(stored, values, bytes);
+	if (!uniform.dirty)
+	{
+		uniform.dirty = true;
+		dirtyList.push_back(index);
+	}
+	return true;
+}
+
+void UniformStaging::Apply()
+{
+	for (size_t i = 0; i < dirtyList.size(); i++)
+	{
+		Uniform& uniform = uniforms[dirtyList[i]];
+		uniform.dirty = false;
+
+		const GLint* iv = &shadow[uniform.offset];
+		const GLfloat* fv = (const GLfloat*)iv;
+		switch (uniform.type)
+		{
+		case GL_FLOAT:			glUniform1fv(uniform.location, uniform.count, fv); break;
+		case GL_FLOAT_VEC2:		glUniform2fv(uniform.location, uniform.count, fv); break;
+		case GL_FLOAT_VEC3:		glUniform3fv(uniform.location, uniform.count, fv); break;
+		case GL_FLOAT_VEC4:		glUniform4fv(uniform.location, uniform.count, fv); break;
+		case GL_INT:
+		case GL_BOOL:
+		case GL_SAMPLER_2D:
+		case GL_SAMPLER_CUBE:	glUniform1iv(uniform.location, uniform.count, iv); break;
+		case GL_INT_VEC2:
+		case GL_BOOL_VEC2:		glUniform2iv(uniform.location, uniform.count, iv); break;
+		case GL_INT_VEC3:
+		case GL_BOOL_VEC3:		glUniform3iv(uniform.location, uniform.count, iv); break;
+		case GL_INT_VEC4:
+		case GL_BOOL_VEC4:		glUniform4iv(uniform.location, uniform.count, iv); break;
+		case GL_FLOAT_MAT2:		glUniformMatrix2fv(uniform.location, uniform.count, GL_FALSE, fv); break;
+		case GL_FLOAT_MAT3:		glUniformMatrix3fv(uniform.location, uniform.count, GL_FALSE, fv); break;
+		case GL_FLOAT_MAT4:		glUniformMatrix4fv(uniform.location, uniform.count, GL_FALSE, fv); break;
+		default:				continue;
+		}
+		s_frameStats.uploads++;
+	}
+	dirtyList.clear();
+}
+
+void UniformStaging::Invalidate()
+{
+	dirtyList.clear();
+	for (size_t i = 0; i < uniforms.size(); i++)
+	{
+		// Arrays cover their element entries
+		uniforms[i].dirty = reflection.GetUniform((int)i).element < 0;
+		if (uniforms[i].dirty)
+			dirtyList.push_back((int)i);
+	}
+}
+
+void GetUniformUploadStats(UniformUploadStats* stats)
+{
+	*stats = s_lastFrameStats;
+}
+
+void EndUniformUploadFrame()
+{
+	s_lastFrameStats = s_frameStats;
+	memset(&s_frameStats, 0, sizeof(s_frameStats));
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ogles_sys.h"
+#include "ShaderReflection.h"
+#include <glm.hpp>
+#include <vector>
+
+struct UniformUploadStats
+{
+	int		uploads;	// glUniform* calls issued
+	int		skipped;	// Set calls whose value was already on the program
+};
+
+// Shadow copy of every uniform value last sent to one program. Set* compares the new value with the
+// shadow and only marks the uniform dirty when it differs; Apply then issues one glUniform* per dirty
+// uniform. The shadow starts zeroed, which is what linking (or glProgramBinary) leaves in the
+// program, so values still at their default are never sent either. All uniform writes to the
+// program must go through here, or Invalidate must be called afterwards.
+class UniformStaging
+{
+public:
+	void Init(const ShaderReflection& programReflection);
+
+	// False if the program has no such active uniform. Arrays take count elements from values.
+	bool SetFloat(ShaderNameHash name, float value)					{ return Set(name, &value, 1); }
+	bool SetInt(ShaderNameHash name, GLint value)					{ return Set(name, &value, 1); }	// also samplers and bools
+	bool SetVec2(ShaderNameHash name, const glm::vec2& value)		{ return Set(name, &value.x, 2); }
+	bool SetVec3(ShaderNameHash name, const glm::vec3& value)		{ return Set(name, &value.x, 3); }
+	bool SetVec4(ShaderNameHash name, const glm::vec4& value)		{ return Set(name, &value.x, 4); }
+	bool SetMat3(ShaderNameHash name, const glm::mat3& value)		{ return Set(name, &value[0].x, 9); }
+	bool SetMat4(ShaderNameHash name, const glm::mat4& value)		{ return Set(name, &value[0].x, 16); }
+	bool SetVec4Array(ShaderNameHash name, const glm::vec4* values, int count)	{ return Set(name, &values[0].x, count * 4); }
+
+	// Raw form of the above: numWords 32-bit floats or ints in the uniform's own layout
+	bool Set(ShaderNameHash name, const void* values, int numWords);
+
+	// Uploads the dirty uniforms. The program must be current.
+	void Apply();
+
+	// Sends every uniform again on the next Apply, e.g. after glUniform* was called directly
+	void Invalidate();
+
+	const ShaderReflection& GetReflection() const { return reflection; }
+
+private:
+	struct Uniform
+	{
+		GLint		location;
+		GLenum		type;
+		int			count;		// array elements uploaded by Apply
+		int			offset;		// first word in shadow
+		int			words;		// count * words per element
+		bool		dirty;
+	};
+
+	ShaderReflection		reflection;
+	std::vector<Uniform>	uniforms;		// same order as the reflection's uniforms
+	std::vector<GLint>		shadow;			// 32-bit words, floats stored bit for bit
+	std::vector<int>		dirtyList;
+};
+
+// Counters of the last finished frame, summed over all programs
+void GetUniformUploadStats(UniformUploadStats* stats);
+
+// Closes the current frame's counters. Call once per frame, e.g. after eglSwapBuffers.
+void EndUniformUploadFrame();
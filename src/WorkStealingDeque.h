@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+// Fixed size Chase-Lev deque (the C11 formulation of Lê et al.). The owning thread pushes and pops
+// at the bottom, any other thread steals from the top. Nothing blocks or takes a lock; Push returns
+// false when the deque is full, Pop and Steal return false when it is empty, and Steal also when it
+// lost a race for the last item. T must be lock-free as a std::atomic, e.g. a pointer.
+// Capacity must be a power of two.
+template <typename T, int Capacity>
+class WorkStealingDeque
+{
+public:
+	WorkStealingDeque()
+	{
+		static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+		top.store(0, std::memory_order_relaxed);
+		bottom.store(0, std::memory_order_relaxed);
+	}
+
+	// Owner only
+	bool Push(T value)
+	{
+		ptrdiff_t b = bottom.load(std::memory_order_relaxed);
+		ptrdiff_t t = top.load(std::memory_order_acquire);
+		if (b - t >= Capacity)
+			return false;	// full
+
+		items[b & (Capacity - 1)].store(value, std::memory_order_relaxed);
+		bottom.store(b + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Owner only, newest first
+	bool Pop(T& value)
+	{
+		ptrdiff_t b = bottom.load(std::memory_order_relaxed) - 1;
+		bottom.store(b, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		ptrdiff_t t = top.load(std::memory_order_relaxed);
+
+		if (t > b)
+		{
+			// empty
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return false;
+		}
+
+		value = items[b & (Capacity - 1)].load(std::memory_order_relaxed);
+		if (t == b)
+		{
+			// The last item, thieves may be after it too
+			bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+			bottom.store(b + 1, std::memory_order_relaxed);
+			return won;
+		}
+		return true;
+	}
+
+	// Any thread, oldest first
+	bool Steal(T& value)
+	{
+		ptrdiff_t t = top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		ptrdiff_t b = bottom.load(std::memory_order_acquire);
+		if (t >= b)
+			return false;	// empty
+
+		value = items[t & (Capacity - 1)].load(std::memory_order_relaxed);
+		return top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<T>						items[Capacity];
+	alignas(64) std::atomic<ptrdiff_t>	top;
+	alignas(64) std::atomic<ptrdiff_t>	bottom;
+};
@@ -1,43 +1,148 @@
 #include "ogles_sys.h"
 #include <glm.hpp>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "Shaders.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderCompileService.h"
+#include "FileWatcher.h"
+#include "ShaderHotReload.h"
+#include "UniformStaging.h"
+
+// Set to 1 to log the cold / warm program binary cache startup times at launch
+#define SHADER_STARTUP_BENCHMARK 0
+
+#define DATA_DIRECTORY "../data"
+#define TRIANGLE_VS "../data/Shaders/TriangleShaderVS.vs"
+#define TRIANGLE_FS "../data/Shaders/TriangleShaderFS.fs"
 
 using namespace glm;
 
 SysContext oglSysCtx;
 vec3 vertex[3];
 Shaders myShader;
+ShaderCompileService shaderCompiler;
+ShaderHotReload shaderHotReload;
+FileWatcher shaderChangeWatcher;	// update side wake up for the reloader in render thread mode
+
+// Rebuilds shaders when their files under DATA_DIRECTORY change. It takes a compile thread with a
+// shared context and a directory watcher, so it is left to Debug builds and "-hotreload".
+#if defined(_DEBUG)
+bool shaderHotReloadEnabled = true;
+#else
+bool shaderHotReloadEnabled = false;
+#endif
+
+// What Render needs of a frame in render thread mode
+struct FramePacket
+{
+	vec3 vertex[3];
+};
+
+// "-frames N" quits after N frames, for headless and automated runs. 0 runs until closed.
+// "-vsync N" sets the swap interval, "-fps N" turns the frame limiter on and "-ondemand" only renders
+// frames something changed. "-renderthread" renders on a thread of its own, see sysRegisterFrameFunc.
+// "-jobs N" sizes the job system, 1 runs every job on the main thread. "-hotreload" rebuilds edited shaders.
+int frameLimit = 0;
+int frameCount = 0;
 
 int Init()
 {
 	vertex[0].x = 0.0f;		vertex[0].y = 0.5f;		vertex[0].z = 0.0f;
 	vertex[1].x = -0.5f;	vertex[1].y = -0.5f;	vertex[1].z = 0.0f;
 	vertex[2].x = 0.5f;		vertex[2].y = -0.5f;	vertex[2].z = 0.0f;
-	
-	return myShader.Init("../data/Shaders/TriangleShaderVS.vs", "../data/Shaders/TriangleShaderFS.fs");
+
+	InitProgramBinaryCache("../shader_cache");
+
+#if SHADER_STARTUP_BENCHMARK
+	char* vsSource = Shaders::LoadShaderSource(TRIANGLE_VS);
+	char* fsSource = Shaders::LoadShaderSource(TRIANGLE_FS);
+	if (vsSource && fsSource)
+		BenchmarkProgramBinaryCache(vsSource, fsSource, 10);
+	delete[] vsSource;
+	delete[] fsSource;
+#endif
+
+	int result = myShader.Init(TRIANGLE_VS, TRIANGLE_FS);
+
+	if (shaderHotReloadEnabled)
+	{
+		// Watched even when Init failed, saving a fix builds it
+		shaderCompiler.Init(&oglSysCtx, 1);
+		shaderHotReload.Init(DATA_DIRECTORY, &shaderCompiler);
+		shaderHotReload.Watch(&myShader);
+
+		// The reloader makes GL calls, so in render thread mode it runs in Render, which only runs on
+		// demand when something asks for a frame
+		if (oglSysCtx.renderThread && !StartFileWatcher(DATA_DIRECTORY, &shaderChangeWatcher))
+			Debug("cannot watch %s, shader edits show with the next frame\n", DATA_DIRECTORY);
+	}
+
+	return result;
 }
 
-void Update(float deltaTime)
+// Builds the programs the compile workers finished, on whichever thread owns the context
+void UpdateShaders()
 {
+	if (!shaderHotReloadEnabled)
+		return;
+
+	shaderCompiler.Update();
+	if (shaderHotReload.Update() > 0)
+		sysInvalidate(&oglSysCtx);
 
+	// Keep frames coming until the builds that were started are swapped in
+	if (shaderCompiler.GetPendingCount() > 0)
+		sysInvalidate(&oglSysCtx);
 }
 
-void Render()
+void Update(float)
 {
+	if (oglSysCtx.renderThread == NULL)
+		UpdateShaders();
+	else if (shaderHotReloadEnabled && PollFileWatcher(&shaderChangeWatcher))
+		sysInvalidate(&oglSysCtx);
+
+	// -frames counts rendered frames, so keep them coming when rendering on demand
+	if (frameLimit > 0)
+		sysInvalidate(&oglSysCtx);
+}
+
+void BuildFrame(void* packet)
+{
+	FramePacket* frame = (FramePacket*)packet;
+	memcpy(frame->vertex, vertex, sizeof(frame->vertex));
+}
+
+void Render(float)
+{
+	// The render thread owns the context, so the reloader runs here; Update asks for the frames
+	if (oglSysCtx.renderThread)
+		UpdateShaders();
+
+	const FramePacket* frame = (const FramePacket*)sysGetFramePacket(&oglSysCtx);
+	const vec3* positions = frame ? frame->vertex : vertex;
+
 	glClear(GL_COLOR_BUFFER_BIT);
 
 	glUseProgram(myShader.program);
+	if (myShader.uniforms)
+		myShader.uniforms->Apply();
 
 	if (myShader.positionAttribute != -1)
 	{
 		glEnableVertexAttribArray(myShader.positionAttribute);
-		glVertexAttribPointer(myShader.positionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), &vertex[0].x);
+		glVertexAttribPointer(myShader.positionAttribute, 3, GL_FLOAT, GL_FALSE, sizeof(vec3), &positions[0].x);
 	}
 
 	glDrawArrays(GL_TRIANGLES, 0, 3);
 
-	eglSwapBuffers(oglSysCtx.eglDisplay, oglSysCtx.eglSurface);
+	// sysMainLoop swaps
+	EndUniformUploadFrame();
+
+	if (frameLimit > 0 && ++frameCount >= frameLimit)
+		sysRequestQuit(&oglSysCtx);
 }
 
 void Key(unsigned char key, bool bIsPressed)
@@ -45,11 +150,30 @@ void Key(unsigned char key, bool bIsPressed)
 
 }
 
-void main()
+int main(int argc, char** argv)
 {
-	ZeroMemory(&oglSysCtx, sizeof(SysContext));
+	SysOptions sysOptions;
+	GetDefaultSysOptions(&sysOptions);
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-ondemand") == 0)
+			sysOptions.renderOnDemand = true;
+		else if (strcmp(argv[i], "-renderthread") == 0)
+			sysOptions.renderThread = true;
+		else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			frameLimit = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-vsync") == 0 && i + 1 < argc)
+			sysOptions.swapInterval = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-fps") == 0 && i + 1 < argc)
+			sysOptions.targetFPS = (float)atof(argv[++i]);
+		else if (strcmp(argv[i], "-jobs") == 0 && i + 1 < argc)
+			sysOptions.jobThreads = atoi(argv[++i]);
+		else if (strcmp(argv[i], "-hotreload") == 0)
+			shaderHotReloadEnabled = true;
+	}
 
-	sysInit(&oglSysCtx, 800, 600);
+	sysInit(&oglSysCtx, 800, 600, &sysOptions);
 
 	if (Init() != 0)	//duongnt
 	{	
@@ -59,6 +183,19 @@ void main()
 	sysRegisterKeyFunc(&oglSysCtx, Key);
 	sysRegisterRenderFunc(&oglSysCtx, Render);
 	sysRegisterUpdateFunc(&oglSysCtx, Update);
+	sysRegisterFrameFunc(&oglSysCtx, sizeof(FramePacket), BuildFrame);
 
 	sysMainLoop(&oglSysCtx);
+
+	SysFrameStats frameStats;
+	sysGetFrameStats(&oglSysCtx, &frameStats);
+	Debug("Last %d frames: %.2f ms average, %.2f min, %.2f max, %.2f 99th percentile, %.2f jitter, %d late\n",
+		frameStats.frames, frameStats.averageMs, frameStats.minMs, frameStats.maxMs, frameStats.percentile99Ms,
+		frameStats.jitterMs, frameStats.lateFrames);
+
+	StopFileWatcher(&shaderChangeWatcher);
+	shaderHotReload.Shutdown();
+	shaderCompiler.Shutdown();
+	sysCleanUp(&oglSysCtx);
+	return 0;
 }
\ No newline at end of file
@@ -1,8 +1,48 @@
 #include "ogles_sys.h"
+#include "JobSystem.h"
 
 #include <stdio.h>
-#include <Windows.h>
+#include <stdarg.h>
+#include <string.h>
 #include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#include <Windows.h>
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include "GLES2/gl2ext.h"
+#include <signal.h>
+#endif
+
+static void RenderFrame(SysContext* sysCtx, float alpha);
+static void SetFullFrame(const SysContext* sysCtx, int* rect);
+
+// Three frame packets rotate between the update side, which fills writeSlot, and the render thread,
+// which draws readSlot. readySlot holds the latest published packet.
+struct SysRenderThread
+{
+	std::thread				thread;
+	std::mutex				mutex;
+	std::condition_variable	cond;
+	std::vector<char>		packets[3];
+	float					alphas[3];
+	int						rects[3][4];
+	int						writeSlot;
+	int						readySlot;
+	int						readSlot;
+	bool					fresh;		// readySlot has not been taken by the render thread yet
+	bool					stopping;
+};
+
+#if defined(_WIN32)
 
 /*
 * process_window(): This function handles Windows callbacks.
@@ -25,20 +65,52 @@ LRESULT CALLBACK ProcessWindow(HWND hWnd, UINT uiMsg, WPARAM wParam, LPARAM lPar
 	{
 		if (sysCtx && sysCtx->keyFunc)
 			sysCtx->keyFunc((unsigned char)wParam, true);
+		if (sysCtx)
+			sysInvalidate(sysCtx);
 	}
 	break;
 	case WM_KEYUP:
 	{		
 		if (sysCtx && sysCtx->keyFunc)
 			sysCtx->keyFunc((unsigned char)wParam, false);
+		if (sysCtx)
+			sysInvalidate(sysCtx);
+	}
+	break;
+	case WM_MOUSEMOVE:
+	case WM_LBUTTONDOWN:
+	case WM_LBUTTONUP:
+	case WM_RBUTTONDOWN:
+	case WM_RBUTTONUP:
+	case WM_MBUTTONDOWN:
+	case WM_MBUTTONUP:
+	case WM_MOUSEWHEEL:
+	{
+		if (sysCtx)
+			sysInvalidate(sysCtx);
+		lRet = DefWindowProc(hWnd, uiMsg, wParam, lParam);
+	}
+	break;
+	case WM_SIZE:
+	{
+		if (sysCtx)
+		{
+			sysCtx->width = LOWORD(lParam);
+			sysCtx->height = HIWORD(lParam);
+			sysInvalidate(sysCtx);
+		}
 	}
 	break;
 	case WM_PAINT:
 	{
-		if (sysCtx && sysCtx->renderFunc)
+		// Exposed by the system, e.g. while it runs its own loop to move or resize the window.
+		// The render thread owns the context in render thread mode, so it gets a new frame instead.
+		if (sysCtx && sysCtx->renderThread)
+			sysInvalidate(sysCtx);
+		else if (sysCtx && sysCtx->renderFunc)
 		{
-			sysCtx->renderFunc();
-			eglSwapBuffers(sysCtx->eglDisplay, sysCtx->eglSurface);
+			SetFullFrame(sysCtx, sysCtx->renderRect);
+			RenderFrame(sysCtx, sysCtx->renderAlpha);
 		}
 
 		ValidateRect(hWnd, NULL);
@@ -53,15 +125,28 @@ LRESULT CALLBACK ProcessWindow(HWND hWnd, UINT uiMsg, WPARAM wParam, LPARAM lPar
 	return lRet;
 }
 
+static void ShowError(SysContext* sysCtx, const char* text)
+{
+	MessageBox(sysCtx->nativeWindow, text, "Error", MB_OK | MB_ICONEXCLAMATION);
+}
+
+#else
+
+static void ShowError(SysContext*, const char* text)
+{
+	Debug("%s", text);
+}
+
+#endif
 
 /*!*****************************************************************************************************************************************
 @Function		TestEGLError
-@Input			nativeWindow                Handle to the window
+@Input			sysCtx                      Context whose window shows the message box
 @Input			functionLastCalled          Function which triggered the error
 @Return		True if no EGL error was detected
 @Description	Tests for an EGL error and prints it in a message box.
 *******************************************************************************************************************************************/
-bool TestEGLError(HWND nativeWindow, const char* functionLastCalled)
+bool TestEGLError(SysContext* sysCtx, const char* functionLastCalled)
 {
 	/*	eglGetError returns the last error that occurred using EGL, not necessarily the status of the last called function. The user has to
 	check after every single EGL call or at least once every frame. Usually this would be for debugging only, but for this example
@@ -70,9 +155,9 @@ bool TestEGLError(HWND nativeWindow, const char* functionLastCalled)
 	EGLint lastError = eglGetError();
 	if (lastError != EGL_SUCCESS)
 	{
-		TCHAR stringBuffer[256];
+		char stringBuffer[256];
 		sprintf(stringBuffer, ("%s failed (%x).\n"), functionLastCalled, lastError);
-		MessageBox(nativeWindow, stringBuffer, "Error", MB_OK | MB_ICONEXCLAMATION);
+		ShowError(sysCtx, stringBuffer);
 		return false;
 	}
 
@@ -81,12 +166,12 @@ bool TestEGLError(HWND nativeWindow, const char* functionLastCalled)
 
 /*!*****************************************************************************************************************************************
 @Function		TestGLError
-@Input			nativeWindow                Handle to the window
+@Input			sysCtx                      Context whose window shows the message box
 @Input			functionLastCalled          Function which triggered the error
 @Return		True if no EGL error was detected
 @Description	Tests for an EGL error and prints it in a message box.
 *******************************************************************************************************************************************/
-bool TestGLError(HWND nativeWindow, const char* functionLastCalled)
+bool TestGLError(SysContext* sysCtx, const char* functionLastCalled)
 {
 
 	/*	glGetError returns the last error that occurred using OpenGL ES, not necessarily the status of the last called function. The user
@@ -96,15 +181,16 @@ bool TestGLError(HWND nativeWindow, const char* functionLastCalled)
 	GLenum lastError = glGetError();
 	if (lastError != GL_NO_ERROR)
 	{
-		TCHAR stringBuffer[256];
+		char stringBuffer[256];
 		sprintf(stringBuffer, ("%s failed (%x).\n"), functionLastCalled, lastError);
-		MessageBox(nativeWindow, stringBuffer, "Error", MB_OK | MB_ICONEXCLAMATION);
+		ShowError(sysCtx, stringBuffer);
 		return false;
 	}
 
 	return true;
 }
 
+#if defined(_WIN32)
 
 /*!*****************************************************************************************************************************************
 @Function		CreateWindowAndDisplay
@@ -158,6 +244,8 @@ void CreateWindowAndDisplay(SysContext* sysCtx, int width, int height)
 		assert(false && "Failed to create the device context");		
 	}
 
+	sysCtx->width = width;
+	sysCtx->height = height;
 	SetWindowLongPtr(sysCtx->nativeWindow, GWL_USERDATA, (LONG)(LONG_PTR) sysCtx);
 }
 
@@ -200,14 +288,114 @@ void CreateEGLDisplay(SysContext* sysCtx)
 	}
 }
 
+#else
+
+// Headless platforms, newer than the bundled eglext.h
+#define SYS_EGL_PLATFORM_DEVICE_EXT				0x313F
+#define SYS_EGL_PLATFORM_SURFACELESS_MESA		0x31DD
+
+typedef void* SysEGLDevice;
+typedef EGLDisplay (EGLAPIENTRYP SysGetPlatformDisplayFunc)(EGLenum platform, void* nativeDisplay, const EGLint* attribList);
+typedef EGLBoolean (EGLAPIENTRYP SysQueryDevicesFunc)(EGLint maxDevices, SysEGLDevice* devices, EGLint* numDevices);
+typedef const char* (EGLAPIENTRYP SysQueryDeviceStringFunc)(SysEGLDevice device, EGLint name);
+
+const int MAX_EGL_DEVICES = 16;
+
+// Whole word match in a space separated EGL or GL extension string, which may be NULL
+static bool HasExtension(const char* extensions, const char* name)
+{
+	size_t length = strlen(name);
+	for (const char* p = extensions; p != NULL && (p = strstr(p, name)) != NULL; p += length)
+	{
+		if ((p == extensions || p[-1] == ' ') && (p[length] == ' ' || p[length] == 0))
+			return true;
+	}
+	return false;
+}
+
+static bool InitializeEGLDisplay(EGLDisplay display)
+{
+	EGLint eglMajorVersion, eglMinorVersion;
+	if (display != EGL_NO_DISPLAY && eglInitialize(display, &eglMajorVersion, &eglMinorVersion))
+		return true;
+
+	eglGetError(); // Clear error
+	return false;
+}
+
+/*!*****************************************************************************************************************************************
+@Function		CreateEGLDisplay
+@Output		eglDisplay				    EGLDisplay of a GPU, or of Mesa's software rasterizer
+@Return		Whether the function succeeded or not.
+@Description	Finds an EGLDisplay that needs no window system, and initialises it.
+*******************************************************************************************************************************************/
+void CreateEGLDisplay(SysContext* sysCtx)
+{
+	/*	Without a window system there is no native display to ask for. In order of preference:
+	- A GPU through EGL_EXT_platform_device, skipping Mesa's software device.
+	- EGL_MESA_platform_surfaceless, which takes a GPU render node and falls back to the software rasterizer.
+	- The default display; Mesa also goes surfaceless there when no window system is running.
+	The client extension string is NULL on EGL 1.4 implementations without EGL_EXT_client_extensions.
+	*/
+	const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	eglGetError(); // Clear error
+	SysGetPlatformDisplayFunc getPlatformDisplay = (SysGetPlatformDisplayFunc)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+	sysCtx->eglDisplay = EGL_NO_DISPLAY;
+	if (getPlatformDisplay && HasExtension(clientExtensions, "EGL_EXT_platform_device"))
+	{
+		SysQueryDevicesFunc queryDevices = (SysQueryDevicesFunc)eglGetProcAddress("eglQueryDevicesEXT");
+		SysQueryDeviceStringFunc queryDeviceString = (SysQueryDeviceStringFunc)eglGetProcAddress("eglQueryDeviceStringEXT");
+
+		SysEGLDevice devices[MAX_EGL_DEVICES];
+		EGLint numDevices = 0;
+		if (queryDevices && queryDevices(MAX_EGL_DEVICES, devices, &numDevices))
+		{
+			for (EGLint i = 0; i < numDevices && sysCtx->eglDisplay == EGL_NO_DISPLAY; i++)
+			{
+				const char* deviceExtensions = queryDeviceString ? queryDeviceString(devices[i], EGL_EXTENSIONS) : NULL;
+				if (HasExtension(deviceExtensions, "EGL_MESA_device_software"))
+					continue;
+
+				EGLDisplay display = getPlatformDisplay(SYS_EGL_PLATFORM_DEVICE_EXT, devices[i], NULL);
+				if (InitializeEGLDisplay(display))
+					sysCtx->eglDisplay = display;
+			}
+		}
+		eglGetError(); // Clear error
+	}
+
+	if (sysCtx->eglDisplay == EGL_NO_DISPLAY && getPlatformDisplay && HasExtension(clientExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		EGLDisplay display = getPlatformDisplay(SYS_EGL_PLATFORM_SURFACELESS_MESA, NULL, NULL);
+		if (InitializeEGLDisplay(display))
+			sysCtx->eglDisplay = display;
+	}
+
+	if (sysCtx->eglDisplay == EGL_NO_DISPLAY)
+	{
+		EGLDisplay display = eglGetDisplay((EGLNativeDisplayType)EGL_DEFAULT_DISPLAY);
+		if (InitializeEGLDisplay(display))
+			sysCtx->eglDisplay = display;
+	}
+
+	if (sysCtx->eglDisplay == EGL_NO_DISPLAY)
+	{
+		assert(false && "Failed to get an EGLDisplay");
+	}
+}
+
+#endif
+
 /*!*****************************************************************************************************************************************
 @Function		ChooseEGLConfig
 @Input			eglDisplay                  The EGLDisplay used by the application
+@Input			surfaceType                 EGL_SURFACE_TYPE bits the config must support
 @Output		eglConfig                   The EGLConfig chosen by the function
 @Return		Whether the function succeeded or not.
 @Description	Chooses an appropriate EGLConfig and return it.
 *******************************************************************************************************************************************/
-void ChooseEGLConfig(SysContext* sysCtx)
+bool ChooseEGLConfig(SysContext* sysCtx, EGLint surfaceType)
 {
 	/*	Specify the required configuration attributes.
 	An EGL "configuration" describes the capabilities an application requires and the type of surfaces that can be used for drawing.
@@ -216,7 +404,7 @@ void ChooseEGLConfig(SysContext* sysCtx)
 	of key/value pairs which describe particular capabilities requested. In this application nothing special is required so we can query
 	the minimum of needing it to render to a window, and being OpenGL ES 2.0 capable.
 	*/
-	const EGLint configurationAttributes[] =
+	EGLint configurationAttributes[] =
 	{
 		EGL_SAMPLES, 4,		// 4x Anti-aliasting
 		EGL_RED_SIZE, 8,
@@ -225,7 +413,7 @@ void ChooseEGLConfig(SysContext* sysCtx)
 		EGL_ALPHA_SIZE, 8,
 		EGL_DEPTH_SIZE, 8,
 		EGL_STENCIL_SIZE, 8,
-		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+		EGL_SURFACE_TYPE, surfaceType,
 		EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
 		EGL_NONE
 	};
@@ -240,12 +428,17 @@ void ChooseEGLConfig(SysContext* sysCtx)
 	its needs perfectly, so we limit it to returning a single EGLConfig.
 	*/
 	EGLint configsReturned;
-	if (!eglChooseConfig(sysCtx->eglDisplay, configurationAttributes, &sysCtx->eglConfig, 1, &configsReturned) || (configsReturned != 1))
+	if (eglChooseConfig(sysCtx->eglDisplay, configurationAttributes, &sysCtx->eglConfig, 1, &configsReturned) && (configsReturned == 1))
 	{
-		assert(false && "eglChooseConfig() failed.");		
+		return true;
 	}
+
+	// Software rasterizers often have no multisampled configs
+	configurationAttributes[1] = 0;
+	return eglChooseConfig(sysCtx->eglDisplay, configurationAttributes, &sysCtx->eglConfig, 1, &configsReturned) && (configsReturned == 1);
 }
 
+#if defined(_WIN32)
 
 /*!*****************************************************************************************************************************************
 @Function		CreateEGLSurface
@@ -277,12 +470,87 @@ void CreateEGLSurface(SysContext* sysCtx)
 	}
 
 	// Check for any EGL Errors
-	if (!TestEGLError(sysCtx->nativeWindow, "eglCreateWindowSurface"))
+	if (!TestEGLError(sysCtx, "eglCreateWindowSurface"))
 	{
 		assert(false && "Create EGL Surface FAILED!");
 	}
 }
 
+#else
+
+/*!*****************************************************************************************************************************************
+@Function		CreateEGLSurface
+@Input			eglDisplay                  The EGLDisplay used by the application
+@Input			eglConfig                   An EGLConfig chosen by the application
+@Output			eglSurface					A width x height pbuffer, or EGL_NO_SURFACE to render surfaceless
+@Return			Whether the function succeeds or not.
+@Description	Creates an offscreen EGLSurface
+*******************************************************************************************************************************************/
+void CreateEGLSurface(SysContext* sysCtx)
+{
+	/*	A pbuffer is the offscreen surface EGL provides itself. When the config cannot have one, or the display refuses to
+	create it, the context is made current without a surface (EGL_KHR_surfaceless_context) and renders into a framebuffer
+	object instead, see CreateFramebuffer.
+	*/
+	sysCtx->eglSurface = EGL_NO_SURFACE;
+
+	EGLint surfaceType = 0;
+	eglGetConfigAttrib(sysCtx->eglDisplay, sysCtx->eglConfig, EGL_SURFACE_TYPE, &surfaceType);
+	if (surfaceType & EGL_PBUFFER_BIT)
+	{
+		const EGLint pbufferAttributes[] = { EGL_WIDTH, sysCtx->width, EGL_HEIGHT, sysCtx->height, EGL_NONE };
+		sysCtx->eglSurface = eglCreatePbufferSurface(sysCtx->eglDisplay, sysCtx->eglConfig, pbufferAttributes);
+	}
+
+	if (sysCtx->eglSurface == EGL_NO_SURFACE)
+	{
+		eglGetError(); // Clear error
+		if (!HasExtension(eglQueryString(sysCtx->eglDisplay, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context"))
+		{
+			assert(false && "Create EGL Surface FAILED!");
+		}
+	}
+}
+
+/*!*****************************************************************************************************************************************
+@Function		CreateFramebuffer
+@Output			framebuffer					Framebuffer object with a width x height color texture and depth (and stencil) buffer
+@Description	Creates and binds the render target of a surfaceless context
+*******************************************************************************************************************************************/
+void CreateFramebuffer(SysContext* sysCtx)
+{
+	// A texture rather than a renderbuffer: RGBA8 renderbuffers need GL_OES_rgb8_rgba8
+	glGenTextures(1, &sysCtx->colorBuffer);
+	glBindTexture(GL_TEXTURE_2D, sysCtx->colorBuffer);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, sysCtx->width, sysCtx->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Depth and stencil like the config asks for, depth only when the driver cannot pack them
+	bool packedDepthStencil = HasExtension((const char*)glGetString(GL_EXTENSIONS), "GL_OES_packed_depth_stencil");
+	glGenRenderbuffers(1, &sysCtx->depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, sysCtx->depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, packedDepthStencil ? GL_DEPTH24_STENCIL8_OES : GL_DEPTH_COMPONENT16, sysCtx->width, sysCtx->height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &sysCtx->framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, sysCtx->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sysCtx->colorBuffer, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, sysCtx->depthBuffer);
+	if (packedDepthStencil)
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, sysCtx->depthBuffer);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE || !TestGLError(sysCtx, "CreateFramebuffer"))
+	{
+		assert(false && "Create framebuffer FAILED!");
+	}
+}
+
+#endif
+
 /*!*****************************************************************************************************************************************
 @Function		SetupEGLContext
 @Input			eglDisplay                  The EGLDisplay used by the application
@@ -310,7 +578,7 @@ void SetupEGLContext(SysContext* sysCtx)
 
 	// Create the context with the context attributes supplied
 	sysCtx->eglContext = eglCreateContext(sysCtx->eglDisplay, sysCtx->eglConfig, NULL, contextAttributes);
-	if (!TestEGLError(sysCtx->nativeWindow, "eglCreateContext"))
+	if (!TestEGLError(sysCtx, "eglCreateContext"))
 	{
 		assert(false && "EGL Create Context FAILED");
 	}
@@ -320,7 +588,7 @@ void SetupEGLContext(SysContext* sysCtx)
 	rather than any other API (such as OpenVG).
 	*/
 	eglBindAPI(EGL_OPENGL_ES_API);
-	if (!TestEGLError(sysCtx->nativeWindow, "eglBindAPI"))
+	if (!TestEGLError(sysCtx, "eglBindAPI"))
 	{
 		assert(false && "EGL Bind API FAILED");
 	}
@@ -331,22 +599,58 @@ void SetupEGLContext(SysContext* sysCtx)
 	multiple contexts at the same time, users should use multiple threads and synchronise between them.
 	*/
 	eglMakeCurrent(sysCtx->eglDisplay, sysCtx->eglSurface, sysCtx->eglSurface, sysCtx->eglContext);
-	if (!TestEGLError(sysCtx->nativeWindow, "eglMakeCurrent"))
+	if (!TestEGLError(sysCtx, "eglMakeCurrent"))
 	{
 		assert(false && "EGL Make current FAILED");
 	}
 }
 
-void sysInit(SysContext* sysCtx, int screenW, int screenH)
+const float DEFAULT_UPDATE_STEP = 1.0f / 60.0f;
+const int DEFAULT_MAX_UPDATE_STEPS = 5;
+
+void GetDefaultSysOptions(SysOptions* options)
 {
+	options->swapInterval = 1;
+	options->targetFPS = 0.0f;
+	options->renderOnDemand = false;
+	options->renderThread = false;
+	options->jobThreads = 0;
+}
+
+void sysInit(SysContext* sysCtx, int screenW, int screenH, const SysOptions* options)
+{
+	SysOptions defaults;
+	if (options == NULL)
+	{
+		GetDefaultSysOptions(&defaults);
+		options = &defaults;
+	}
+
+	sysCtx->frameDirty = false;
+	sysCtx->quitRequested = false;
+
+#if defined(_WIN32)
 	// Setup the windowing system, getting a window and a display
 	CreateWindowAndDisplay(sysCtx, screenW, screenH);
+#else
+	// No windowing system, the surface only needs the size
+	sysCtx->width = screenW;
+	sysCtx->height = screenH;
+#endif
 
 	// Create and Initialise an EGLDisplay from the native display
 	CreateEGLDisplay(sysCtx);
 
 	// Choose an EGLConfig for the application, used when setting up the rendering surface and EGLContext
-	ChooseEGLConfig(sysCtx);
+#if defined(_WIN32)
+	if (!ChooseEGLConfig(sysCtx, EGL_WINDOW_BIT))
+#else
+	// Any config does for a surfaceless context
+	if (!ChooseEGLConfig(sysCtx, EGL_PBUFFER_BIT) && !ChooseEGLConfig(sysCtx, 0))
+#endif
+	{
+		assert(false && "eglChooseConfig() failed.");
+	}
 
 	// Create an EGLSurface for rendering from the native window
 	CreateEGLSurface(sysCtx);
@@ -354,10 +658,25 @@ void sysInit(SysContext* sysCtx, int screenW, int screenH)
 	// Setup the EGL Context from the other EGL constructs created so far, so that the application is ready to submit OpenGL ES commands
 	SetupEGLContext(sysCtx);
 
+#if !defined(_WIN32)
+	if (sysCtx->eglSurface == EGL_NO_SURFACE)
+		CreateFramebuffer(sysCtx);
+#endif
+
 	//set viewport
 	glViewport(0, 0, screenW, screenH);
 
 	glClearColor(.0f, .0f, .0f, 1.0f);
+
+	sysSetFixedTimeStep(sysCtx, DEFAULT_UPDATE_STEP, DEFAULT_MAX_UPDATE_STEPS);
+	sysSetFramePacing(sysCtx, options->swapInterval, options->targetFPS);
+	sysSetRenderOnDemand(sysCtx, options->renderOnDemand);
+
+	if (options->renderThread)
+		sysCtx->renderThread = new SysRenderThread();
+
+	sysCtx->jobSystem = new JobSystem();
+	sysCtx->jobSystem->Init(options->jobThreads);
 }
 
 void printSystemSpecs()
@@ -373,47 +692,573 @@ void printSystemSpecs()
 	printf("Extensions: \n%s\n", ext);
 }
 
+unsigned long long sysGetTimeNs()
+{
+	return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void sysSetFixedTimeStep(SysContext* sysCtx, float stepSeconds, int maxStepsPerFrame)
+{
+	sysCtx->updateStepNs = stepSeconds > 0.0f ? (unsigned long long)(stepSeconds * 1e9) : 0;
+	sysCtx->maxUpdateSteps = maxStepsPerFrame > 0 ? maxStepsPerFrame : 1;
+	sysCtx->accumulatedNs = 0;
+	sysCtx->renderAlpha = 1.0f;
+}
+
+// Runs the updates the time since the last frame is due and sets the alpha for the render that follows
+static void UpdateSimulation(SysContext* sysCtx)
+{
+	unsigned long long curTime = sysGetTimeNs();
+	unsigned long long elapsed = curTime - sysCtx->lastTimeNs;
+	sysCtx->lastTimeNs = curTime;
+
+	if (sysCtx->updateStepNs == 0)
+	{
+		if (sysCtx->updateFunc != NULL)
+			sysCtx->updateFunc((float)(elapsed * 1e-9));
+		sysCtx->renderAlpha = 1.0f;
+		return;
+	}
+
+	unsigned long long maxAccumulated = sysCtx->updateStepNs * sysCtx->maxUpdateSteps;
+	sysCtx->accumulatedNs += elapsed;
+	if (sysCtx->accumulatedNs > maxAccumulated)
+		sysCtx->accumulatedNs = maxAccumulated;
+
+	float deltaTime = (float)(sysCtx->updateStepNs * 1e-9);
+	while (sysCtx->accumulatedNs >= sysCtx->updateStepNs)
+	{
+		if (sysCtx->updateFunc != NULL)
+			sysCtx->updateFunc(deltaTime);
+		sysCtx->accumulatedNs -= sysCtx->updateStepNs;
+	}
+
+	sysCtx->renderAlpha = (float)((double)sysCtx->accumulatedNs / (double)sysCtx->updateStepNs);
+}
+
+// Sleeps are cut into slices this long so the last one cannot overshoot by much
+const unsigned long long SLEEP_SLICE_NS = 1000000;
+// Until the first sleeps have been measured
+const unsigned long long INITIAL_SLEEP_OVERSHOOT_NS = 2000000;
+
+void sysSetFramePacing(SysContext* sysCtx, int swapInterval, float targetFPS)
+{
+	eglSwapInterval(sysCtx->eglDisplay, swapInterval);
+
+	sysCtx->framePeriodNs = targetFPS > 0.0f ? (unsigned long long)(1e9 / targetFPS) : 0;
+	sysCtx->nextFrameNs = 0;
+	if (sysCtx->sleepOvershootNs == 0)
+		sysCtx->sleepOvershootNs = INITIAL_SLEEP_OVERSHOOT_NS;
+
+#if defined(_WIN32)
+	// Sleep(1) takes a whole 15.6 ms scheduler tick unless the timer resolution is raised
+	bool raise = sysCtx->framePeriodNs != 0;
+	if (raise && !sysCtx->timerPeriodRaised)
+		timeBeginPeriod(1);
+	else if (!raise && sysCtx->timerPeriodRaised)
+		timeEndPeriod(1);
+	sysCtx->timerPeriodRaised = raise;
+#endif
+}
+
+// Sleeps while more than the expected overshoot of a sleep remains, then spins the rest
+static void WaitUntil(SysContext* sysCtx, unsigned long long deadlineNs)
+{
+	for (;;)
+	{
+		unsigned long long now = sysGetTimeNs();
+		if (now >= deadlineNs)
+			return;
+
+		if (deadlineNs - now > SLEEP_SLICE_NS + sysCtx->sleepOvershootNs)
+		{
+			std::this_thread::sleep_for(std::chrono::nanoseconds(SLEEP_SLICE_NS));
+
+			unsigned long long slept = sysGetTimeNs() - now;
+			unsigned long long overshoot = slept > SLEEP_SLICE_NS ? slept - SLEEP_SLICE_NS : 0;
+			if (overshoot > sysCtx->sleepOvershootNs)
+				sysCtx->sleepOvershootNs = overshoot;
+			else
+				sysCtx->sleepOvershootNs -= (sysCtx->sleepOvershootNs - overshoot) / 16;
+		}
+		else
+			std::this_thread::yield();
+	}
+}
+
+// Waits for the frame limiter, then records the interval since the previous frame
+static void EndFrame(SysContext* sysCtx)
+{
+	unsigned long long now = sysGetTimeNs();
+
+	if (sysCtx->framePeriodNs != 0)
+	{
+		// More than a frame behind: start over rather than rush frames out to catch up
+		if (now > sysCtx->nextFrameNs + sysCtx->framePeriodNs)
+			sysCtx->nextFrameNs = now;
+		else
+		{
+			WaitUntil(sysCtx, sysCtx->nextFrameNs);
+			now = sysGetTimeNs();
+		}
+		sysCtx->nextFrameNs += sysCtx->framePeriodNs;
+	}
+
+	if (sysCtx->lastFrameNs != 0)
+	{
+		unsigned long long intervalNs = now - sysCtx->lastFrameNs;
+		intervalNs -= std::min(sysCtx->idleNs, intervalNs);
+		sysCtx->frameTimesMs[sysCtx->nextFrameTime] = (float)(intervalNs * 1e-6);
+		sysCtx->nextFrameTime = (sysCtx->nextFrameTime + 1) % SYS_FRAME_STATS_FRAMES;
+		if (sysCtx->numFrameTimes < SYS_FRAME_STATS_FRAMES)
+			sysCtx->numFrameTimes++;
+	}
+	sysCtx->lastFrameNs = now;
+	sysCtx->idleNs = 0;
+}
+
+void sysGetFrameStats(const SysContext* sysCtx, SysFrameStats* stats)
+{
+	memset(stats, 0, sizeof(SysFrameStats));
+
+	int count = sysCtx->numFrameTimes;
+	if (count == 0)
+		return;
+
+	float sorted[SYS_FRAME_STATS_FRAMES];
+	memcpy(sorted, sysCtx->frameTimesMs, count * sizeof(float));
+	std::sort(sorted, sorted + count);
+
+	double sum = 0.0, sumSquares = 0.0;
+	for (int i = 0; i < count; i++)
+	{
+		sum += sorted[i];
+		sumSquares += (double)sorted[i] * sorted[i];
+	}
+	double average = sum / count;
+	double variance = sumSquares / count - average * average;
+
+	float median = sorted[count / 2];
+	int lateFrames = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (sorted[i] > 1.5f * median)
+			lateFrames++;
+	}
+
+	stats->frames = count;
+	stats->averageMs = (float)average;
+	stats->minMs = sorted[0];
+	stats->maxMs = sorted[count - 1];
+	stats->percentile99Ms = sorted[(count * 99) / 100];
+	stats->jitterMs = (float)sqrt(variance > 0.0 ? variance : 0.0);
+	stats->lateFrames = lateFrames;
+}
+
+// Without a fixed update step the loop still wakes up this often to update while it waits for an invalidation
+const unsigned long long IDLE_UPDATE_NS = 16666667;
+
+// Guards the dirty rect and wakes the headless loop. There is only ever one loop per process.
+static std::mutex s_invalidateMutex;
+static std::condition_variable s_invalidateCond;
+
+static void SetFullFrame(const SysContext* sysCtx, int* rect)
+{
+	rect[0] = 0;
+	rect[1] = 0;
+	rect[2] = sysCtx->width;
+	rect[3] = sysCtx->height;
+}
+
+static void RenderFrame(SysContext* sysCtx, float alpha)
+{
+	if (sysCtx->renderFunc == NULL)
+		return;
+
+	sysCtx->renderFunc(alpha);
+	if (sysCtx->eglSurface != EGL_NO_SURFACE)
+		eglSwapBuffers(sysCtx->eglDisplay, sysCtx->eglSurface);
+}
+
+void sysSetRenderOnDemand(SysContext* sysCtx, bool enable)
+{
+	sysCtx->renderOnDemand = enable;
+
+#if defined(_WIN32)
+	// Window surfaces usually discard the back buffer on swap. Keeping it costs a copy per frame
+	// on tiled GPUs, so only ask for it when frames can be partial.
+	EGLint swapBehavior = 0;
+	if (enable)
+		eglSurfaceAttrib(sysCtx->eglDisplay, sysCtx->eglSurface, EGL_SWAP_BEHAVIOR, EGL_BUFFER_PRESERVED);
+	else
+		eglSurfaceAttrib(sysCtx->eglDisplay, sysCtx->eglSurface, EGL_SWAP_BEHAVIOR, EGL_BUFFER_DESTROYED);
+	eglGetError(); // Clear error, the config may not support preserving
+	sysCtx->preservesFrame = eglQuerySurface(sysCtx->eglDisplay, sysCtx->eglSurface, EGL_SWAP_BEHAVIOR, &swapBehavior) &&
+		swapBehavior == EGL_BUFFER_PRESERVED;
+#else
+	// A pbuffer is single buffered, and the framebuffer object of a surfaceless context is never swapped
+	sysCtx->preservesFrame = true;
+#endif
+
+	sysInvalidate(sysCtx);
+}
+
+void sysInvalidate(SysContext* sysCtx)
+{
+	sysInvalidateRect(sysCtx, 0, 0, sysCtx->width, sysCtx->height);
+}
+
+void sysInvalidateRect(SysContext* sysCtx, int x, int y, int width, int height)
+{
+	{
+		std::lock_guard<std::mutex> lock(s_invalidateMutex);
+
+		int* dirty = sysCtx->dirtyRect;
+		if (!sysCtx->preservesFrame)
+			SetFullFrame(sysCtx, dirty);
+		else if (dirty[2] == 0)
+		{
+			dirty[0] = x;
+			dirty[1] = y;
+			dirty[2] = width;
+			dirty[3] = height;
+		}
+		else
+		{
+			int right = std::max(dirty[0] + dirty[2], x + width);
+			int top = std::max(dirty[1] + dirty[3], y + height);
+			dirty[0] = std::min(dirty[0], x);
+			dirty[1] = std::min(dirty[1], y);
+			dirty[2] = right - dirty[0];
+			dirty[3] = top - dirty[1];
+		}
+
+		// Clip to the frame
+		int right = std::min(dirty[0] + dirty[2], sysCtx->width);
+		int top = std::min(dirty[1] + dirty[3], sysCtx->height);
+		dirty[0] = std::max(dirty[0], 0);
+		dirty[1] = std::max(dirty[1], 0);
+		dirty[2] = std::max(right - dirty[0], 0);
+		dirty[3] = std::max(top - dirty[1], 0);
+
+		sysCtx->frameDirty = true;
+	}
+
+	if (sysCtx->renderOnDemand)
+	{
+#if defined(_WIN32)
+		PostMessage(sysCtx->nativeWindow, WM_NULL, 0, 0);
+#else
+		s_invalidateCond.notify_one();
+#endif
+	}
+}
+
+void sysGetDirtyRect(const SysContext* sysCtx, int* x, int* y, int* width, int* height)
+{
+	// The update side has already moved on to the next frame's rect in render thread mode
+	const SysRenderThread* renderThread = sysCtx->renderThread;
+	const int* rect = renderThread ? renderThread->rects[renderThread->readSlot] : sysCtx->renderRect;
+	*x = rect[0];
+	*y = rect[1];
+	*width = rect[2];
+	*height = rect[3];
+}
+
+// Moves what was invalidated into renderRect for the coming frame. False when nothing was.
+static bool TakeInvalidation(SysContext* sysCtx)
+{
+	if (!sysCtx->renderOnDemand)
+	{
+		SetFullFrame(sysCtx, sysCtx->renderRect);
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(s_invalidateMutex);
+	if (!sysCtx->frameDirty)
+		return false;
+
+	memcpy(sysCtx->renderRect, sysCtx->dirtyRect, sizeof(sysCtx->renderRect));
+	memset(sysCtx->dirtyRect, 0, sizeof(sysCtx->dirtyRect));
+	sysCtx->frameDirty = false;
+
+	// Clipped away entirely, e.g. a rect outside the frame
+	return sysCtx->renderRect[2] > 0 && sysCtx->renderRect[3] > 0;
+}
+
+// When the next fixed update is due
+static unsigned long long GetNextUpdateTime(const SysContext* sysCtx)
+{
+	if (sysCtx->updateStepNs == 0)
+		return sysCtx->lastTimeNs + IDLE_UPDATE_NS;
+	return sysCtx->lastTimeNs + (sysCtx->updateStepNs - sysCtx->accumulatedNs);
+}
+
+static void RenderThreadMain(SysContext* sysCtx)
+{
+	SysRenderThread* renderThread = sysCtx->renderThread;
+	eglMakeCurrent(sysCtx->eglDisplay, sysCtx->eglSurface, sysCtx->eglSurface, sysCtx->eglContext);
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(renderThread->mutex);
+
+			// Frames only follow invalidations when rendering on demand, so waiting there is idle time
+			unsigned long long waitStart = sysGetTimeNs();
+			while (!renderThread->fresh && !renderThread->stopping)
+				renderThread->cond.wait(lock);
+			if (sysCtx->renderOnDemand)
+				sysCtx->idleNs += sysGetTimeNs() - waitStart;
+			if (renderThread->stopping)
+				break;
+
+			std::swap(renderThread->readSlot, renderThread->readySlot);
+			renderThread->fresh = false;
+		}
+		// The update side may be waiting to start on the next frame
+		renderThread->cond.notify_all();
+
+		RenderFrame(sysCtx, renderThread->alphas[renderThread->readSlot]);
+		EndFrame(sysCtx);
+	}
+
+	eglMakeCurrent(sysCtx->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglReleaseThread();
+}
+
+// Moves the context over to the render thread, if there is one
+static void StartRenderThread(SysContext* sysCtx)
+{
+	SysRenderThread* renderThread = sysCtx->renderThread;
+	if (renderThread == NULL)
+		return;
+
+	for (int i = 0; i < 3; i++)
+	{
+		renderThread->packets[i].assign(sysCtx->framePacketSize, 0);
+		renderThread->alphas[i] = 1.0f;
+		SetFullFrame(sysCtx, renderThread->rects[i]);
+	}
+	renderThread->writeSlot = 0;
+	renderThread->readySlot = 1;
+	renderThread->readSlot = 2;
+	renderThread->fresh = false;
+	renderThread->stopping = false;
+
+	// A context is current on one thread at a time
+	eglMakeCurrent(sysCtx->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	renderThread->thread = std::thread(RenderThreadMain, sysCtx);
+}
+
+// Lets the render thread finish its frame and takes the context back for the clean up
+static void StopRenderThread(SysContext* sysCtx)
+{
+	SysRenderThread* renderThread = sysCtx->renderThread;
+	if (renderThread == NULL)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(renderThread->mutex);
+		renderThread->stopping = true;
+	}
+	renderThread->cond.notify_all();
+	renderThread->thread.join();
+
+	eglMakeCurrent(sysCtx->eglDisplay, sysCtx->eglSurface, sysCtx->eglSurface, sysCtx->eglContext);
+}
+
+// Keeps the update side at most one frame ahead: the packet published last must be taken before the
+// next frame is simulated
+static void WaitForRenderThread(SysContext* sysCtx)
+{
+	SysRenderThread* renderThread = sysCtx->renderThread;
+	if (renderThread == NULL)
+		return;
+
+	std::unique_lock<std::mutex> lock(renderThread->mutex);
+	while (renderThread->fresh)
+		renderThread->cond.wait(lock);
+}
+
+// Draws the frame right away, or fills a packet with it and hands that to the render thread
+static void SubmitFrame(SysContext* sysCtx)
+{
+	SysRenderThread* renderThread = sysCtx->renderThread;
+	if (renderThread == NULL)
+	{
+		RenderFrame(sysCtx, sysCtx->renderAlpha);
+		EndFrame(sysCtx);
+		return;
+	}
+
+	// Only this thread ever changes writeSlot, and the render thread never touches that packet
+	int slot = renderThread->writeSlot;
+	if (sysCtx->frameFunc && sysCtx->framePacketSize > 0)
+		sysCtx->frameFunc(&renderThread->packets[slot][0]);
+	renderThread->alphas[slot] = sysCtx->renderAlpha;
+	memcpy(renderThread->rects[slot], sysCtx->renderRect, sizeof(sysCtx->renderRect));
+
+	{
+		std::lock_guard<std::mutex> lock(renderThread->mutex);
+		std::swap(renderThread->writeSlot, renderThread->readySlot);
+		renderThread->fresh = true;
+	}
+	renderThread->cond.notify_all();
+}
+
+#if defined(_WIN32)
+
+// Sleeps until the next update is due or a message arrives
+static void WaitForInvalidation(SysContext* sysCtx)
+{
+	unsigned long long now = sysGetTimeNs();
+	unsigned long long due = GetNextUpdateTime(sysCtx);
+	if (due > now)
+		MsgWaitForMultipleObjects(0, NULL, FALSE, (DWORD)((due - now + 999999) / 1000000), QS_ALLINPUT);
+
+	// Idle time is not part of a frame interval. The render thread keeps its own frame times.
+	if (sysCtx->renderThread == NULL)
+		sysCtx->idleNs += sysGetTimeNs() - now;
+}
+
 // Start main windows loop
 void sysMainLoop(SysContext *sysCtx)
 {
 	MSG msg = { 0 };
 	int done = 0;
-	DWORD lastTime = GetTickCount();
+	StartRenderThread(sysCtx);
+	sysCtx->lastTimeNs = sysGetTimeNs();
 
-	while (!done)
+	while (!done && !sysCtx->quitRequested)
 	{
-		int gotMsg = (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE) != 0);
-		DWORD curTime = GetTickCount();
-		float deltaTime = (float)(curTime - lastTime) / 1000.0f;
-		lastTime = curTime;
+		WaitForRenderThread(sysCtx);
 
-		if (gotMsg)
+		// Handle everything that is queued, then simulate and draw one frame
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE) != 0)
 		{
 			if (msg.message == WM_QUIT)
 			{
 				done = 1;
+				break;
 			}
-			else
-			{
-				TranslateMessage(&msg);
-				DispatchMessage(&msg);
-			}
+
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
 		}
+
+		if (done)
+			break;
+
+		UpdateSimulation(sysCtx);
+
+		if (TakeInvalidation(sysCtx))
+			SubmitFrame(sysCtx);
 		else
-			SendMessage(sysCtx->nativeWindow, WM_PAINT, 0, 0);
+			WaitForInvalidation(sysCtx);
+	}
 
-		// Call update function if registered
-		if (sysCtx->updateFunc != NULL)
-			sysCtx->updateFunc(deltaTime);
+	StopRenderThread(sysCtx);
+}
+
+void sysRequestQuit(SysContext* sysCtx)
+{
+	sysCtx->quitRequested = true;
+
+	// Wakes the loop up, it may be blocked in the message pump
+	PostMessage(sysCtx->nativeWindow, WM_CLOSE, 0, 0);
+}
+
+#else
+
+static volatile sig_atomic_t s_quitSignal = 0;
+
+static void OnQuitSignal(int)
+{
+	s_quitSignal = 1;
+}
+
+// Sleeps until the next update is due or the frame is invalidated
+static void WaitForInvalidation(SysContext* sysCtx)
+{
+	unsigned long long start = sysGetTimeNs();
+	std::chrono::steady_clock::time_point due((std::chrono::nanoseconds(GetNextUpdateTime(sysCtx))));
+
+	std::unique_lock<std::mutex> lock(s_invalidateMutex);
+	while (!sysCtx->frameDirty && !sysCtx->quitRequested && !s_quitSignal)
+	{
+		if (s_invalidateCond.wait_until(lock, due) == std::cv_status::timeout)
+			break;
+	}
+
+	// Idle time is not part of a frame interval. The render thread keeps its own frame times.
+	if (sysCtx->renderThread == NULL)
+		sysCtx->idleNs += sysGetTimeNs() - start;
+}
+
+// Start main headless loop: like the windows loop, minus the messages
+void sysMainLoop(SysContext *sysCtx)
+{
+	signal(SIGINT, OnQuitSignal);
+	signal(SIGTERM, OnQuitSignal);
+
+	StartRenderThread(sysCtx);
+	sysCtx->lastTimeNs = sysGetTimeNs();
+
+	while (!sysCtx->quitRequested && !s_quitSignal)
+	{
+		WaitForRenderThread(sysCtx);
+		UpdateSimulation(sysCtx);
+
+		if (TakeInvalidation(sysCtx))
+			SubmitFrame(sysCtx);
+		else
+			WaitForInvalidation(sysCtx);
+	}
+
+	StopRenderThread(sysCtx);
+
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+}
+
+void sysRequestQuit(SysContext* sysCtx)
+{
+	// Under the lock, so WaitForInvalidation cannot check the flag just before it is set and then
+	// sleep through the notification
+	{
+		std::lock_guard<std::mutex> lock(s_invalidateMutex);
+		sysCtx->quitRequested = true;
 	}
+	s_invalidateCond.notify_one();
 }
 
-void sysRegisterRenderFunc(SysContext* sysCtx, void(*func)())
+#endif
+
+void sysRegisterRenderFunc(SysContext* sysCtx, void(*func)(float))
 {
 	if (sysCtx)
 		sysCtx->renderFunc = func;
 }
 
+void sysRegisterFrameFunc(SysContext* sysCtx, size_t packetSize, void (*func)(void* packet))
+{
+	if (sysCtx)
+	{
+		sysCtx->frameFunc = func;
+		sysCtx->framePacketSize = func ? packetSize : 0;
+	}
+}
+
+const void* sysGetFramePacket(const SysContext* sysCtx)
+{
+	const SysRenderThread* renderThread = sysCtx->renderThread;
+	if (renderThread == NULL || renderThread->packets[renderThread->readSlot].empty())
+		return NULL;
+	return &renderThread->packets[renderThread->readSlot][0];
+}
+
 void sysRegisterUpdateFunc(SysContext* sysCtx, void(*func)(float))
 {
 	if (sysCtx)
@@ -426,8 +1271,20 @@ void sysRegisterKeyFunc(SysContext* sysCtx, void(*func)(unsigned char, bool))
 		sysCtx->keyFunc = func;
 }
 
+#if defined(_WIN32)
+
 void sysCleanUp(SysContext* sysCtx)
 {
+	delete sysCtx->renderThread;
+	sysCtx->renderThread = NULL;
+
+	// Jobs still queued run before the GL context goes away
+	delete sysCtx->jobSystem;
+	sysCtx->jobSystem = NULL;
+
+	if (sysCtx->timerPeriodRaised)
+		timeEndPeriod(1);
+
 	eglTerminate(sysCtx->eglDisplay);
 
 	// Release the device context.
@@ -443,6 +1300,36 @@ void sysCleanUp(SysContext* sysCtx)
 	}
 }
 
+#else
+
+void sysCleanUp(SysContext* sysCtx)
+{
+	delete sysCtx->renderThread;
+	sysCtx->renderThread = NULL;
+
+	// Jobs still queued run before the GL context goes away
+	delete sysCtx->jobSystem;
+	sysCtx->jobSystem = NULL;
+
+	if (sysCtx->framebuffer)
+	{
+		glDeleteFramebuffers(1, &sysCtx->framebuffer);
+		glDeleteRenderbuffers(1, &sysCtx->depthBuffer);
+		glDeleteTextures(1, &sysCtx->colorBuffer);
+	}
+
+	eglMakeCurrent(sysCtx->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (sysCtx->eglSurface != EGL_NO_SURFACE)
+		eglDestroySurface(sysCtx->eglDisplay, sysCtx->eglSurface);
+	eglDestroyContext(sysCtx->eglDisplay, sysCtx->eglContext);
+	eglTerminate(sysCtx->eglDisplay);
+	eglReleaseThread();
+}
+
+#endif
+
+#if defined(_WIN32)
+
 void Debug(const char *formatStr, ...)
 {
 	va_list params;
@@ -455,4 +1342,17 @@ void Debug(const char *formatStr, ...)
 	OutputDebugString(buf);
 
 	va_end(params);
-}
\ No newline at end of file
+}
+
+#else
+
+void Debug(const char *formatStr, ...)
+{
+	va_list params;
+
+	va_start(params, formatStr);
+	vprintf(formatStr, params);
+	va_end(params);
+}
+
+#endif
\ No newline at end of file
@@ -3,11 +3,81 @@
 #include "EGL/egl.h"
 #include "GLES2/gl2.h"
 
+#include <stddef.h>
+#include <atomic>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+// MSVC CRT names the framework uses
+inline int fopen_s(FILE** ppFile, const char* szFileName, const char* szMode)
+{
+	*ppFile = fopen(szFileName, szMode);
+	return *ppFile ? 0 : errno;
+}
+
+// Only the array form with _TRUNCATE: copies what fits and always terminates
+#define _TRUNCATE ((size_t)-1)
+template <size_t size>
+inline int strncpy_s(char (&dest)[size], const char* src, size_t count)
+{
+	size_t length = strlen(src);
+	if (length > count)
+		length = count;
+	if (length > size - 1)
+		length = size - 1;
+	memcpy(dest, src, length);
+	dest[length] = 0;
+	return 0;
+}
+#define _stricmp strcasecmp
+#endif
+
+// Frames sysGetFrameStats looks back over
+const int SYS_FRAME_STATS_FRAMES = 120;
+
+struct SysOptions
+{
+	int			swapInterval;	// eglSwapInterval: vblanks per swap, 0 presents immediately
+	float		targetFPS;		// frame limiter, 0 = off; frames are then paced by the swap interval alone
+	bool		renderOnDemand;	// see sysSetRenderOnDemand
+	bool		renderThread;	// see sysRegisterFrameFunc
+	int			jobThreads;		// threads of SysContext::jobSystem, the calling thread included; 0 = one per hardware thread
+};
+
+struct SysFrameStats
+{
+	int			frames;			// intervals measured, at most SYS_FRAME_STATS_FRAMES
+	float		averageMs;
+	float		minMs;
+	float		maxMs;
+	float		percentile99Ms;
+	float		jitterMs;		// standard deviation
+	int			lateFrames;		// took more than 1.5x the median
+};
+
+struct SysRenderThread;
+class JobSystem;
+
 struct SysContext
 {
+#if defined(_WIN32)
 	// Windows variables
 	HWND				nativeWindow;
 	HDC					deviceContext;
+#else
+	// Headless variables. Frames go to a pbuffer, or to framebuffer when the display only
+	// supports surfaceless contexts (eglSurface is EGL_NO_SURFACE then).
+	GLuint				framebuffer;
+	GLuint				colorBuffer;
+	GLuint				depthBuffer;
+#endif
+
+	int					width;
+	int					height;
 
 	// EGL variables
 	EGLDisplay			eglDisplay;
@@ -16,22 +86,114 @@ struct SysContext
 	EGLContext			eglContext;
 
 	// Callback funcs
-	void (*renderFunc)	();
+	void (*renderFunc)	(float alpha);
 	void (*keyFunc)		(unsigned char, bool);
 	void (*updateFunc)	(float deltaTime);
+	void (*frameFunc)	(void* packet);
+	size_t				framePacketSize;
+
+	SysRenderThread*	renderThread;		// NULL unless SysOptions::renderThread
+
+	// Created by sysInit with the calling thread as one of its workers, so updateFunc can fan work
+	// out over every core and run jobs itself while it waits for them
+	JobSystem*			jobSystem;
+
+	// Simulation clock, see sysSetFixedTimeStep
+	unsigned long long	updateStepNs;		// 0 = one update per frame with the measured time
+	int					maxUpdateSteps;
+	unsigned long long	lastTimeNs;
+	unsigned long long	accumulatedNs;		// simulation time owed, less than one step after the updates of a frame
+	float				renderAlpha;		// passed to renderFunc
+
+	// Frame pacing, see SysOptions
+	unsigned long long	framePeriodNs;		// 0 = no frame limiter
+	unsigned long long	nextFrameNs;
+	unsigned long long	sleepOvershootNs;	// how late a sleep wakes up, decaying worst case
+	unsigned long long	lastFrameNs;
+	unsigned long long	idleNs;				// waited for an invalidation since lastFrameNs, left out of the interval
+	float				frameTimesMs[SYS_FRAME_STATS_FRAMES];
+	int					numFrameTimes;
+	int					nextFrameTime;
+#if defined(_WIN32)
+	bool				timerPeriodRaised;
+#endif
+
+	// Render on demand, see sysSetRenderOnDemand
+	bool				renderOnDemand;
+	bool				preservesFrame;		// the frame keeps its contents between swaps, so parts can be redrawn
+	std::atomic<bool>	frameDirty;
+	int					dirtyRect[4];		// x, y, width, height still to redraw, width 0 when empty
+	int					renderRect[4];		// what the current renderFunc call redraws
+
+	std::atomic<bool>	quitRequested;
 };
 
-void sysInit(SysContext* sysCtx, int screenW, int screenH);
+// Vsync on, no frame limiter, rendering continuously on the calling thread, one job thread per core
+void GetDefaultSysOptions(SysOptions* options);
+
+// On Windows this opens a screenW x screenH window. Elsewhere it renders headless into an EGL
+// pbuffer or a surfaceless context of that size: on the GPU when EGL finds one, otherwise on
+// Mesa's software rasterizer (set LIBGL_ALWAYS_SOFTWARE=1 to force it).
+void sysInit(SysContext* sysCtx, int screenW, int screenH, const SysOptions* options /*NULL=defaults*/);
+
+// Changes the pacing sysInit set up. The frame limiter sleeps until shortly before each frame is due
+// and spins the rest, so it neither burns a core nor wakes up late. Headless pbuffers ignore the
+// swap interval.
+void sysSetFramePacing(SysContext* sysCtx, int swapInterval, float targetFPS);
+
+// Intervals between the last frames sysMainLoop finished, pacing waits included. Time spent waiting
+// for an invalidation in render-on-demand mode is taken out of them.
+void sysGetFrameStats(const SysContext* sysCtx, SysFrameStats* stats);
 
+// In render-on-demand mode renderFunc only runs once something invalidated the frame: key or mouse
+// input, the window being resized or exposed, or sysInvalidate(Rect) from the update callback or any
+// other thread (an asset finishing to load, say). updateFunc keeps its fixed step so it can poll and
+// invalidate, and the loop sleeps in between. Off by default: every loop iteration renders.
+void sysSetRenderOnDemand(SysContext* sysCtx, bool enable);
+
+// Both are safe to call from any thread and wake the loop up
+void sysInvalidate(SysContext* sysCtx);
+// x, y, width, height in GL window coordinates (origin bottom left). Rects pile up into their
+// bounding box until the next frame. When the frame is not preserved between swaps (most window
+// surfaces), this invalidates the whole frame.
+void sysInvalidateRect(SysContext* sysCtx, int x, int y, int width, int height);
+
+// The part of the frame renderFunc has to redraw, for glScissor. The whole frame when rendering
+// continuously or when the frame is not preserved.
+void sysGetDirtyRect(const SysContext* sysCtx, int* x, int* y, int* width, int* height);
+
+// Returns when the window closes, sysRequestQuit is called or, headless, on SIGINT / SIGTERM
 void sysMainLoop(SysContext* sysCtx);
+void sysRequestQuit(SysContext* sysCtx);
+
+// updateFunc runs in fixed steps of stepSeconds (1/60 by default), as many per frame as the elapsed time
+// covers but at most maxStepsPerFrame (5 by default); time beyond that is dropped so a stall cannot
+// snowball into ever longer frames. renderFunc then gets how far into the next step the frame is, in
+// [0, 1], to interpolate between the last two simulated states. stepSeconds <= 0 goes back to one
+// update per frame with the measured deltaTime and an alpha of 1.
+void sysSetFixedTimeStep(SysContext* sysCtx, float stepSeconds, int maxStepsPerFrame);
 
-void sysRegisterRenderFunc(SysContext* sysCtx, void (*func)());
+// Monotonic clock in nanoseconds
+unsigned long long sysGetTimeNs();
+
+void sysRegisterRenderFunc(SysContext* sysCtx, void (*func)(float));
 void sysRegisterUpdateFunc(SysContext* sysCtx, void (*func)(float));
 void sysRegisterKeyFunc(SysContext* sysCtx, void (*func)(unsigned char, bool));
 
-void sysCleanUp();
+// In render thread mode (SysOptions::renderThread) sysMainLoop hands the EGL context to a thread of
+// its own that runs renderFunc, while the calling thread keeps handling input and running updateFunc.
+// After the updates of a frame func fills a packet of packetSize bytes with everything renderFunc
+// needs. renderFunc reads it back with sysGetFramePacket and must not touch update side state. Three
+// packets rotate between the two threads, so the next frame is simulated while the last one is still
+// being submitted, and the update side never runs more than one frame ahead.
+// Every GL and EGL call, the shader and texture helpers and sysSetFramePacing included, then belongs in renderFunc.
+void sysRegisterFrameFunc(SysContext* sysCtx, size_t packetSize, void (*func)(void* packet));
+
+// The packet of the frame renderFunc is drawing. NULL outside render thread mode or without a frame func.
+const void* sysGetFramePacket(const SysContext* sysCtx);
+
+void sysCleanUp(SysContext* sysCtx);
 
 void printSystemSpecs();
 
 void Debug(const char* formatStr, ...);
-
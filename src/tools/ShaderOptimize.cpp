@@ -0,0 +1,193 @@
+// ShaderOptimize: offline clean-up of a GLSL ES vertex / fragment shader pair.
+//
+//   ShaderOptimize [options] <vertex shader> [fragment shader]
+//
+//   -apply            write the suggested lowp qualifiers instead of only reporting them
+//   -keep-dead        keep unused functions and variables
+//   -pretty           one statement per line instead of minified output
+//   -D NAME[=VALUE]   define NAME while preprocessing, may be repeated
+//   -o DIR            write the optimized shaders to DIR under their own file names, creating DIR
+//
+// Both files are preprocessed first, so the output is self-contained with every #include expanded.
+// The vertex shader is analyzed first so its varying ranges carry over to the fragment shader.
+// Without -o only the report is printed.
+
+#include "../ShaderOptimizer.h"
+#include "../ShaderPreprocessor.h"
+#include "../ogles_sys.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+void Debug(const char* formatStr, ...)
+{
+	va_list args;
+	va_start(args, formatStr);
+	vfprintf(stderr, formatStr, args);
+	va_end(args);
+}
+
+static const char* GetFileName(const char* szPath)
+{
+	const char* slash = strrchr(szPath, '/');
+	const char* backslash = strrchr(szPath, '\\');
+	if (backslash > slash)
+		slash = backslash;
+	return slash ? slash + 1 : szPath;
+}
+
+static ShaderStage GetStage(const char* szPath, int index)
+{
+	const char* dot = strrchr(szPath, '.');
+	if (dot && (strcmp(dot, ".fs") == 0 || strcmp(dot, ".frag") == 0))
+		return SHADER_STAGE_FRAGMENT;
+	if (dot && (strcmp(dot, ".vs") == 0 || strcmp(dot, ".vert") == 0))
+		return SHADER_STAGE_VERTEX;
+	return index == 0 ? SHADER_STAGE_VERTEX : SHADER_STAGE_FRAGMENT;
+}
+
+// Creates path and any missing parents; fine if it already exists
+static void MakeDirectories(const std::string& path)
+{
+	for (size_t i = 1; i <= path.size(); i++)
+	{
+		if (i < path.size() && path[i] != '/' && path[i] != '\\')
+			continue;
+		std::string parent = path.substr(0, i);
+#if defined(_WIN32)
+		_mkdir(parent.c_str());
+#else
+		mkdir(parent.c_str(), 0777);
+#endif
+	}
+}
+
+static bool WriteText(const std::string& path, const std::string& text)
+{
+	FILE* pf;
+	if (fopen_s(&pf, path.c_str(), "wb") != 0)
+		return false;
+	bool ok = fwrite(text.data(), 1, text.size(), pf) == text.size();
+	return fclose(pf) == 0 && ok;
+}
+
+static void PrintReport(const char* szPath, const ShaderSource& source, const ShaderOptimizeReport& report)
+{
+	printf("%s: %u -> %u bytes\n", szPath, (unsigned)report.bytesIn, (unsigned)report.bytesOut);
+
+	for (size_t i = 0; i < report.removedFunctions.size(); i++)
+		printf("  removed function %s\n", report.removedFunctions[i].c_str());
+	for (size_t i = 0; i < report.removedVariables.size(); i++)
+		printf("  removed variable %s\n", report.removedVariables[i].c_str());
+
+	for (size_t i = 0; i < report.precision.size(); i++)
+	{
+		const ShaderPrecisionChange& change = report.precision[i];
+		const char* file = change.file >= 0 && change.file < (int)source.files.size() ? source.files[change.file].c_str() : szPath;
+		printf("  %s lowp %s (%s:%d, range [%g, %g])\n", change.applied ? "applied" : "suggest", change.name.c_str(),
+			file, change.line, change.range.lo, change.range.hi);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ShaderOptimizeOptions options;
+	GetDefaultShaderOptimizeOptions(&options);
+
+	std::vector<std::string> defineText;
+	std::vector<const char*> files;
+	const char* outDir = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-apply") == 0)
+			options.applyPrecision = true;
+		else if (strcmp(argv[i], "-keep-dead") == 0)
+			options.removeDeadCode = false;
+		else if (strcmp(argv[i], "-pretty") == 0)
+			options.minify = false;
+		else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+			outDir = argv[++i];
+		else if (strncmp(argv[i], "-D", 2) == 0)
+		{
+			// "-D NAME=VALUE" and "-DNAME=VALUE" become "NAME VALUE"
+			std::string define = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : "");
+			size_t equals = define.find('=');
+			if (equals != std::string::npos)
+				define[equals] = ' ';
+			defineText.push_back(define);
+		}
+		else if (argv[i][0] != '-' && files.size() < 2)
+			files.push_back(argv[i]);
+		else
+		{
+			fprintf(stderr, "usage: ShaderOptimize [-apply] [-keep-dead] [-pretty] [-D NAME[=VALUE]] [-o DIR] <vertex shader> [fragment shader]\n");
+			return 2;
+		}
+	}
+
+	if (files.empty())
+	{
+		fprintf(stderr, "usage: ShaderOptimize [-apply] [-keep-dead] [-pretty] [-D NAME[=VALUE]] [-o DIR] <vertex shader> [fragment shader]\n");
+		return 2;
+	}
+
+	// Vertex shader first, its varying ranges feed the fragment shader
+	if (files.size() == 2 && GetStage(files[0], 0) == SHADER_STAGE_FRAGMENT && GetStage(files[1], 1) == SHADER_STAGE_VERTEX)
+	{
+		const char* swap = files[0];
+		files[0] = files[1];
+		files[1] = swap;
+	}
+
+	std::vector<const char*> defines;
+	for (size_t i = 0; i < defineText.size(); i++)
+		defines.push_back(defineText[i].c_str());
+
+	if (outDir)
+		MakeDirectories(outDir);
+
+	ShaderVaryingRanges varyings;
+	int result = 0;
+	for (size_t f = 0; f < files.size(); f++)
+	{
+		ShaderSource source;
+		if (!PreprocessShader(files[f], defines.empty() ? NULL : &defines[0], (int)defines.size(), &source))
+		{
+			result = 1;
+			continue;
+		}
+
+		std::string output;
+		ShaderOptimizeReport report;
+		if (!OptimizeShader(source.text.c_str(), GetStage(files[f], (int)f), &options, &varyings, &output, &report))
+		{
+			fprintf(stderr, "%s: unbalanced braces or parentheses, left alone\n", files[f]);
+			result = 1;
+			continue;
+		}
+
+		PrintReport(files[f], source, report);
+
+		if (outDir)
+		{
+			std::string path = std::string(outDir) + "/" + GetFileName(files[f]);
+			if (!WriteText(path, output))
+			{
+				fprintf(stderr, "%s: cannot write\n", path.c_str());
+				result = 1;
+			}
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,109 @@
+// SwizzleBenchmark: throughput of the TGA BGR(A) -> RGB(A) row kernels.
+//
+//   SwizzleBenchmark [-max SIZE]
+//
+//   -max SIZE         largest image edge, 8192 by default; the images go from 256x256 up to SIZExSIZE
+//
+// Every kernel the CPU supports converts synthetic 24 and 32 bit images row by row, the way
+// LoadUncompressedImage calls it. The best of several passes is reported in GB/s of pixel data
+// converted, and every kernel's output is checked against the scalar one.
+
+#include "../TGASwizzle.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// Passes per measurement: at least this many, and more until this much time has gone by
+const int MIN_PASSES = 3;
+const double MIN_SECONDS = 0.25;
+
+static const char* GetLevelName(TGASimdLevel level)
+{
+	switch (level)
+	{
+	case TGA_SIMD_SSSE3:	return "SSSE3";
+	case TGA_SIMD_AVX2:		return "AVX2";
+	default:				return "scalar";
+	}
+}
+
+static void ConvertImage(TGASwizzleRowFunc func, char* pDest, const char* pSrc, int size, int pixelSize)
+{
+	size_t rowSize = (size_t)size * pixelSize;
+	for (int y = 0; y < size; y++)
+		func(pDest + y * rowSize, pSrc + y * rowSize, size);
+}
+
+// Seconds of the fastest pass
+static double TimeKernel(TGASwizzleRowFunc func, char* pDest, const char* pSrc, int size, int pixelSize)
+{
+	double best = 0.0, total = 0.0;
+	for (int pass = 0; pass < MIN_PASSES || total < MIN_SECONDS; pass++)
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		ConvertImage(func, pDest, pSrc, size, pixelSize);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		total += elapsed.count();
+		if (pass == 0 || elapsed.count() < best)
+			best = elapsed.count();
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	int maxSize = 8192;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-max") == 0 && i + 1 < argc)
+			maxSize = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "usage: SwizzleBenchmark [-max SIZE]\n");
+			return 2;
+		}
+	}
+
+	TGASimdLevel cpuLevel = GetTGASimdLevel();
+	printf("CPU supports up to %s\n", GetLevelName(cpuLevel));
+	printf("%-6s %-11s %-7s %10s %10s\n", "bits", "image", "kernel", "ms", "GB/s");
+
+	int result = 0;
+	for (int bits = 24; bits <= 32; bits += 8)
+	{
+		int pixelSize = bits / 8;
+		for (int size = 256; size <= maxSize; size *= 2)
+		{
+			size_t bytes = (size_t)size * size * pixelSize;
+			std::vector<char> src(bytes), reference(bytes), dest(bytes);
+			srand(size + bits);
+			for (size_t i = 0; i < bytes; i++)
+				src[i] = (char)rand();
+
+			ConvertImage(GetTGASwizzleRowFunc(bits, TGA_SIMD_SCALAR), &reference[0], &src[0], size, pixelSize);
+
+			for (int level = TGA_SIMD_SCALAR; level <= cpuLevel; level++)
+			{
+				TGASwizzleRowFunc func = GetTGASwizzleRowFunc(bits, (TGASimdLevel)level);
+				double seconds = TimeKernel(func, &dest[0], &src[0], size, pixelSize);
+
+				char image[32];
+				snprintf(image, sizeof(image), "%dx%d", size, size);
+				printf("%-6d %-11s %-7s %10.3f %10.2f\n", bits, image, GetLevelName((TGASimdLevel)level),
+					seconds * 1000.0, bytes / seconds * 1e-9);
+
+				if (memcmp(&dest[0], &reference[0], bytes) != 0)
+				{
+					printf("  %s output differs from the scalar kernel\n", GetLevelName((TGASimdLevel)level));
+					result = 1;
+				}
+			}
+		}
+	}
+
+	return result;
+}